@@ -0,0 +1,64 @@
+/* DS mailbox automation
+ * * Battery estimator implementation
+ * (c) DNS 2020-2023
+ */
+
+#include "BatteryEstimator.h"
+
+using namespace ds;
+
+// Add Vcc reading (mV). Readings above VCC_SAMPLES are ignored
+//// Vcc ADC has unstable readings, ranging +-20% in normal operation. A reading takes a few dozens of microseconds, so
+//// several of them do not noticeably extend awake time. Readings are kept sorted (insertion sort on the fly)
+void BatteryEstimator::addVcc(const uint16_t vcc) {
+  if (num_samples == VCC_SAMPLES)
+    return;
+  auto j = num_samples++;
+  for (; j && samples[j - 1] > vcc; j--)
+    samples[j] = samples[j - 1];
+  samples[j] = vcc;
+}
+
+// Return filtered Vcc reading (mV)
+uint16_t BatteryEstimator::getVcc() const {
+  return num_samples ? samples[num_samples / 2] : 0;
+}
+
+// Update estimate with the readings taken and start over. Returns battery level (%)
+uint8_t BatteryEstimator::update() {
+  if (num_samples) {
+
+    // Normalize reading
+    auto vcc = getVcc();
+    if (vcc < VCC_REF_000)
+      vcc = VCC_REF_000;
+    else
+      if (vcc > VCC_REF_100)
+        vcc = VCC_REF_100;
+
+    const uint16_t cp_new = 10000UL * (vcc - VCC_REF_000) / (VCC_REF_100 - VCC_REF_000);
+    if (cp != CP_UNKNOWN) {
+
+      // Smooth remaining noise with exponentially weighted moving average. Fixed point in 0.01% keeps small changes from being lost
+      cp += ((int32_t)cp_new - cp) / BATTERY_CHANGE_WEIGHT_COEFF;
+    } else
+      cp = cp_new;   // New baseline
+    num_samples = 0;
+  }
+  return getLevel();
+}
+
+// Return battery level estimate (0.01%)
+uint16_t BatteryEstimator::getCP() const {
+  return cp;
+}
+
+// Set battery level estimate (0.01%)
+void BatteryEstimator::setCP(const uint16_t _cp) {
+  cp = _cp <= 10000 ? _cp : CP_UNKNOWN;
+}
+
+// Return battery level (%)
+uint8_t BatteryEstimator::getLevel() const {
+  return cp == CP_UNKNOWN ? BATTERY_LEVEL_UNKNOWN : (cp + 50) / 100;
+}
@@ -0,0 +1,41 @@
+/* DS mailbox automation
+ * * Battery estimator definition
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_BATTERYESTIMATOR_H_
+#define _DS_BATTERYESTIMATOR_H_
+
+#include <Arduino.h>                   // uint8_t, ...
+#include "MailBoxMessage.h"            // BATTERY_CHANGE_WEIGHT_COEFF
+
+namespace ds {
+
+  // Battery level estimate from Vcc readings
+  //// A median over a few readings rejects single outliers; the rest of the noise is smoothed over wakeups with
+  //// exponentially weighted moving average. The estimate is 2 bytes, so it fits the RTC memory across deep sleep
+  class BatteryEstimator {
+    public:
+      static const uint8_t VCC_SAMPLES = 5;      // Number of Vcc readings per battery update (odd)
+      static const uint16_t VCC_REF_000 = 3625;  // ADC reference reading at 0% battery. These numbers have been measured experimentally and depend on battery type and schematic
+      static const uint16_t VCC_REF_100 = 3925;  // ADC reference reading at 100% battery. Must be higher than VCC_REF_000
+      static const uint16_t CP_UNKNOWN = UINT16_MAX; // Unknown battery estimate
+
+    protected:
+      uint16_t samples[VCC_SAMPLES];             // Vcc readings of this update, sorted (mV)
+      uint8_t num_samples;                       // Number of Vcc readings taken
+      uint16_t cp;                               // Battery level estimate (0.01%)
+
+    public:
+      BatteryEstimator(const uint16_t _cp = CP_UNKNOWN) : num_samples(0), cp(_cp) {}
+      void addVcc(const uint16_t /* vcc */);     // Add Vcc reading (mV). Readings above VCC_SAMPLES are ignored
+      uint16_t getVcc() const;                   // Return filtered Vcc reading (mV)
+      uint8_t update();                          // Update estimate with the readings taken and start over. Returns battery level (%)
+      uint16_t getCP() const;                    // Return battery level estimate (0.01%)
+      void setCP(const uint16_t /* _cp */);      // Set battery level estimate (0.01%)
+      uint8_t getLevel() const;                  // Return battery level (%)
+  };
+
+} // namespace ds
+
+#endif // _DS_BATTERYESTIMATOR_H_
@@ -0,0 +1,142 @@
+/* DS mailbox automation
+ * * Local module
+ * * * Battery history implementation
+ * (c) DNS 2020-2023
+ */
+
+#include "MySystem.h"       // System-level definitions
+
+#ifndef DS_MAILBOX_REMOTE
+
+#include "BatteryHistory.h"
+
+using namespace ds;
+
+// Constructor
+BatteryHistory::BatteryHistory() {
+  reset();
+}
+
+// Clear history
+void BatteryHistory::reset() {
+  t_base = 0;
+  head = 0;
+  len = 0;
+  scale = 0;
+  sum_t = sum_b = 0;
+  sum_tt = sum_tb = 0;
+}
+
+// Put sample into history, pushing out the oldest one if needed
+void BatteryHistory::push(const uint16_t hour, const uint8_t level) {
+  if (len == SIZE) {
+    const auto& s = samples[head];
+    sum_t -= s.hour;
+    sum_b -= s.level;
+    sum_tt -= (int64_t)s.hour * s.hour;
+    sum_tb -= (int32_t)s.hour * s.level;
+    head = (head + 1) % SIZE;
+    len--;
+  }
+  auto& s = samples[(head + len) % SIZE];
+  s.hour = hour;
+  s.level = level;
+  len++;
+  sum_t += hour;
+  sum_b += level;
+  sum_tt += (int64_t)hour * hour;
+  sum_tb += (int32_t)hour * level;
+}
+
+// Drop every other sample and double the sample interval
+//// The oldest sample is kept, so the history keeps its span. This runs at most SCALE_MAX times per battery
+void BatteryHistory::thin() {
+  sample_t kept[SIZE / 2];
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < len; i += 2)
+    kept[n++] = samples[(head + i) % SIZE];
+  const auto _t_base = t_base;
+  const auto _scale = scale;
+  reset();
+  for (uint8_t i = 0; i < n; i++)
+    push(kept[i].hour, kept[i].level);
+  t_base = _t_base;
+  scale = _scale + 1;
+}
+
+// Add battery level sample, if enough time has passed since the previous one
+bool BatteryHistory::add(const time_t t, const uint8_t level) {
+  if (!t || level > 100)
+    return false;
+  if (!t_base)
+    t_base = t;
+  if (t < t_base)
+    return false;   // Clock went backwards; wait for it to catch up
+  auto hour = (t - t_base) / 3600;
+  if (hour > UINT16_MAX) {
+    reset();        // Years without a battery change; start over rather than overflow
+    t_base = t;
+    hour = 0;
+  }
+  if (len && hour - samples[(head + len - 1) % SIZE].hour < (SAMPLE_INTERVAL << scale))
+    return false;
+  if (len == SIZE && scale < SCALE_MAX)
+    thin();
+  push(hour, level);
+  return true;
+}
+
+// Return predicted time until battery gets empty (d)
+//// Discharge rate is the slope of least squares line fitted through the samples
+uint16_t BatteryHistory::getDaysLeft(const uint8_t level) const {
+  if (len < SAMPLES_MIN || level > 100)
+    return DAYS_LEFT_UNKNOWN;
+  const int64_t num = (int64_t)len * sum_tb - (int64_t)sum_t * sum_b;   // Slope numerator (%/h)
+  const int64_t den = (int64_t)len * sum_tt - (int64_t)sum_t * sum_t;   // Slope denominator
+  if (den <= 0 || num >= 0)
+    return DAYS_LEFT_UNKNOWN;   // No time spread or not discharging
+  const int64_t days = (int64_t)level * den / -num / 24;
+  return days > DAYS_LEFT_MAX ? DAYS_LEFT_MAX : days;
+}
+
+// Save history into a record
+void BatteryHistory::save(record_t& rec) const {
+  memset(&rec, 0, sizeof(rec));
+  rec.t_base = t_base;
+  rec.len = len;
+  rec.scale = scale;
+  for (uint8_t i = 0; i < len; i++)
+    rec.samples[i] = samples[(head + i) % SIZE];
+}
+
+// Load history from a record
+void BatteryHistory::load(const record_t& rec) {
+  reset();
+  for (uint8_t i = 0; i < rec.len && i < SIZE; i++)
+    push(rec.samples[i].hour, rec.samples[i].level);
+  if (len) {
+    t_base = rec.t_base;
+    scale = rec.scale <= SCALE_MAX ? rec.scale : SCALE_MAX;
+  }
+}
+
+// Load history in legacy text format
+//// Baseline files carry no history. parseInt() waits out the stream timeout on end of input, so the input is checked first
+void BatteryHistory::loadText(Stream& in) {
+  reset();
+  while (isspace(in.peek()))
+    in.read();
+  if (!in.available())
+    return;
+  const time_t t = (unsigned long)in.parseInt();
+  const uint8_t n = in.parseInt();
+  for (uint8_t i = 0; i < n && in.available(); i++) {
+    const uint16_t hour = in.parseInt();
+    const uint8_t level = in.parseInt();
+    push(hour, level);
+  }
+  if (len)
+    t_base = t;
+}
+
+#endif // !DS_MAILBOX_REMOTE
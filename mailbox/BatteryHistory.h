@@ -0,0 +1,69 @@
+/* DS mailbox automation
+ * * Local module
+ * * * Battery history definition
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_BATTERYHISTORY_H_
+#define _DS_BATTERYHISTORY_H_
+
+#include <Arduino.h>                 // uint8_t, ...
+#include <time.h>                    // time_t
+
+namespace ds {
+
+  // History of battery levels with discharge rate estimation
+  //// Samples are kept in a ring buffer, together with running sums for linear regression, so adding a sample is O(1).
+  //// Levels come in whole percent, so a slow discharge needs a long history to be measured. When the buffer is full,
+  //// every other sample is dropped and the sample interval is doubled; this way, the history spans the whole battery life
+  class BatteryHistory {
+      static const uint8_t SIZE = 24;            // Max number of samples in history (even)
+      static const uint8_t SAMPLES_MIN = 3;      // Min number of samples to make a prediction
+      static const unsigned int SAMPLE_INTERVAL = 24; // Min interval between samples at the start of history (h)
+      static const uint8_t SCALE_MAX = 5;        // Max number of sample interval doublings (the history then spans ~2 years)
+
+    public:
+      // History sample
+      typedef struct {
+        uint16_t hour;                           // Time of sample (h from base time)
+        uint8_t level;                           // Battery level (%)
+      } __attribute__ ((packed)) sample_t;
+
+      // Persistent history record (fixed size)
+      typedef struct {
+        uint32_t t_base;                         // Base time
+        uint8_t len;                             // Number of samples
+        uint8_t scale;                           // Number of sample interval doublings
+        sample_t samples[SIZE];                  // Samples, oldest first
+      } __attribute__ ((packed)) record_t;
+
+    private:
+      time_t t_base;                             // Base time (0 means history is empty)
+      sample_t samples[SIZE];                    // Samples (ring buffer)
+      uint8_t head;                              // Position of the oldest sample
+      uint8_t len;                               // Number of samples
+      uint8_t scale;                             // Number of sample interval doublings
+      int32_t sum_t;                             // Sum of sample times
+      int32_t sum_b;                             // Sum of sample levels
+      int64_t sum_tt;                            // Sum of squared sample times
+      int64_t sum_tb;                            // Sum of sample times multiplied by levels
+
+      void push(const uint16_t /* hour */, const uint8_t /* level */); // Put sample into history, pushing out the oldest one if needed
+      void thin();                               // Drop every other sample and double the sample interval
+
+    public:
+      static const uint16_t DAYS_LEFT_UNKNOWN = UINT16_MAX; // Unknown time to empty
+      static const uint16_t DAYS_LEFT_MAX = 9999;           // Max time to empty reported (d)
+
+      BatteryHistory();                          // Constructor
+      void reset();                              // Clear history
+      bool add(const time_t /* t */, const uint8_t /* level */); // Add battery level sample, if enough time has passed since the previous one
+      uint16_t getDaysLeft(const uint8_t /* level */) const; // Return predicted time until battery gets empty (d)
+      void save(record_t& /* rec */) const;      // Save history into a record
+      void load(const record_t& /* rec */);      // Load history from a record
+      void loadText(Stream& /* in */);           // Load history in legacy text format
+  };
+
+} // namespace ds
+
+#endif // _DS_BATTERYHISTORY_H_
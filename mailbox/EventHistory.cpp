@@ -0,0 +1,160 @@
+/* DS mailbox automation
+ * * Local module
+ * * * Event history implementation
+ * (c) DNS 2020-2023
+ */
+
+#include "MySystem.h"       // System-level definitions
+
+#ifndef DS_MAILBOX_REMOTE
+
+#include "EventHistory.h"
+
+using namespace ds;
+
+static const char *FILE_PREFIX PROGMEM = "/events";      // History file prefix
+static const char *FILE_EXT PROGMEM = ".dat";            // Current history file extension
+static const char *FILE_EXT_ROTATED PROGMEM = ".old";    // Rotated history file extension
+
+// Return history file name
+String EventHistory::getFileName(const uint8_t id, const bool rotated) {
+  String file_name = FILE_PREFIX;
+  file_name += id;
+  file_name += rotated ? FILE_EXT_ROTATED : FILE_EXT;
+  return file_name;
+}
+
+// Add event
+//// Events are collected in RAM and written in batches, so there is no flash access on the receiving path most of the time
+void EventHistory::add(const mailbox_event_type type, const time_t t, const uint8_t battery, const unsigned int lost, const unsigned int duration) {
+  if (!t || System::getTimeSyncStatus() == TIME_SYNC_NONE)
+    return;        // Time unknown; event cannot be placed in history
+  if (num_pending == PENDING_MAX && !flush()) {
+
+    // Disk problem; sacrifice the oldest pending event
+    memmove(pending, pending + 1, sizeof(pending) - sizeof(pending[0]));
+    num_pending--;
+  }
+  auto& event = pending[num_pending];
+
+  //// Keep events in time order even if the clock goes back
+  event.t = num_pending && (uint32_t)t < pending[num_pending - 1].t ? pending[num_pending - 1].t : t;
+  event.type = type;
+  event.battery = battery;
+  event.lost = lost < UINT8_MAX ? lost : UINT8_MAX;
+  event.duration = duration < UINT8_MAX ? duration : UINT8_MAX;
+  num_pending++;
+}
+
+// Write pending events to disk
+bool EventHistory::flush() {
+  if (!num_pending)
+    return true;
+  const auto file_name = getFileName(id);
+  auto f = System::fs.open(file_name, "a+");
+  if (!f) {
+    System::log->printf(TIMED("Error opening %s\n"), file_name.c_str());
+    return false;
+  }
+
+  //// Incomplete trailing record (e.g., after power loss) would break record alignment; drop it
+  auto len = f.size() / sizeof(event_t);
+  if (f.size() % sizeof(event_t))
+    f.truncate(len * sizeof(event_t));
+
+  // Rotate the file when full. This is the only time flash is freed, so the number of writes per event stays constant
+  if (len + num_pending > SEGMENT_SIZE) {
+    f.close();
+    const auto file_name_rotated = getFileName(id, true);
+    System::fs.remove(file_name_rotated);
+    System::fs.rename(file_name, file_name_rotated);
+    f = System::fs.open(file_name, "a+");
+    if (!f) {
+      System::log->printf(TIMED("Error opening %s\n"), file_name.c_str());
+      return false;
+    }
+    len = 0;
+  }
+
+  // Keep events in time order across batches
+  uint32_t t_last = 0;
+  if (len) {
+    event_t event_last;
+    if (f.seek((len - 1) * sizeof(event_t)) && f.read((uint8_t *)&event_last, sizeof(event_last)) == sizeof(event_last))
+      t_last = event_last.t;
+  }
+  for (uint8_t i = 0; i < num_pending; i++)
+    if (pending[i].t < t_last)
+      pending[i].t = t_last;
+
+  const auto written = f.write((const uint8_t *)pending, num_pending * sizeof(event_t));
+  f.close();
+  if (written != num_pending * sizeof(event_t)) {
+    System::log->printf(TIMED("Error writing %s\n"), file_name.c_str());
+    return false;
+  }
+  num_pending = 0;
+  return true;
+}
+
+// Query events in a single file
+//// The first event in range is found with binary search; the rest are read sequentially
+size_t EventHistory::query(File& file, const time_t from, const time_t to, const std::function<void(const event_t&)>& callback) {
+  event_t event;
+  size_t lo = 0, hi = file.size() / sizeof(event_t);
+  while (lo < hi) {
+    const auto mid = lo + (hi - lo) / 2;
+    if (!file.seek(mid * sizeof(event_t)) || file.read((uint8_t *)&event, sizeof(event)) != sizeof(event))
+      return 0;
+    if ((time_t)event.t < from)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  size_t n = 0;
+  if (!file.seek(lo * sizeof(event_t)))
+    return 0;
+  while (file.read((uint8_t *)&event, sizeof(event)) == sizeof(event) && (time_t)event.t <= to) {
+    callback(event);
+    n++;
+  }
+  return n;
+}
+
+// Call back for events in time range, oldest first. Returns number of events
+size_t EventHistory::query(const time_t from, const time_t to, const std::function<void(const event_t&)>& callback) {
+  size_t n = 0;
+  for (const auto rotated : {true, false}) {
+    auto f = System::fs.open(getFileName(id, rotated), "r");
+    if (f) {
+      n += query(f, from, to, callback);
+      f.close();
+    }
+  }
+  for (uint8_t i = 0; i < num_pending; i++)
+    if ((time_t)pending[i].t >= from && (time_t)pending[i].t <= to) {
+      callback(pending[i]);
+      n++;
+    }
+  return n;
+}
+
+// Remove history from disk
+void EventHistory::forget(const uint8_t id) {
+  System::fs.remove(getFileName(id));
+  System::fs.remove(getFileName(id, true));
+}
+
+// Return event type as string
+String EventHistory::getTypeStr(const uint8_t type) {
+  switch (type) {
+    case EVENT_BOOT:    return F("Rebooted");
+    case EVENT_OPEN:    return F("Door opened");
+    case EVENT_CLOSE:   return F("Door closed");
+    case EVENT_TIMEOUT: return F("Closure timed out");
+    default:            return F("Unknown");
+  }
+}
+
+#endif // !DS_MAILBOX_REMOTE
@@ -0,0 +1,65 @@
+/* DS mailbox automation
+ * * Local module
+ * * * Event history definition
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_EVENTHISTORY_H_
+#define _DS_EVENTHISTORY_H_
+
+#include <Arduino.h>                 // uint8_t, ...
+#include <time.h>                    // time_t
+#include <FS.h>                      // File
+#include <functional>                // std::function
+
+namespace ds {
+
+  // Mailbox event types
+  typedef enum : uint8_t {
+    EVENT_NONE,                                  // Unused record
+    EVENT_BOOT,                                  // Mailbox rebooted
+    EVENT_OPEN,                                  // Door opened
+    EVENT_CLOSE,                                 // Door closed
+    EVENT_TIMEOUT                                // Door closure message timed out
+  } mailbox_event_type;
+
+  // Persistent history of mailbox events
+  //// Events are appended to a file in fixed-size binary records. When the file is full, it is rotated, so history keeps
+  //// between one and two segments of events. Records are in time order, so time range lookup is a binary search
+  class EventHistory {
+    public:
+      // Event record (fixed size)
+      typedef struct {
+        uint32_t t;                              // Event time
+        uint8_t type;                            // Event type (mailbox_event_type)
+        uint8_t battery;                         // Battery level (%)
+        uint8_t lost;                            // Number of messages lost before the event (saturated)
+        uint8_t duration;                        // Door open duration (s, saturated; closing only)
+      } __attribute__ ((packed)) event_t;
+
+      static const uint16_t SEGMENT_SIZE = 256;  // Max number of events in one file
+      static const uint8_t PENDING_MAX = 4;      // Max number of events kept in RAM before writing to disk
+
+    private:
+      uint8_t id;                                // Mailbox ID
+      event_t pending[PENDING_MAX];              // Events not yet written to disk
+      uint8_t num_pending;                       // Number of events not yet written to disk
+
+      static String getFileName(const uint8_t /* id */, const bool rotated = false); // Return history file name
+      static size_t query(File& /* file */, const time_t /* from */, const time_t /* to */,
+        const std::function<void(const event_t&)>& /* callback */); // Query events in a single file
+
+    public:
+      EventHistory(const uint8_t _id) : id(_id), num_pending(0) {}
+      void add(const mailbox_event_type /* type */, const time_t /* t */, const uint8_t /* battery */,
+        const unsigned int lost = 0, const unsigned int duration = 0); // Add event
+      bool flush();                              // Write pending events to disk
+      size_t query(const time_t /* from */, const time_t /* to */,
+        const std::function<void(const event_t&)>& /* callback */); // Call back for events in time range, oldest first. Returns number of events
+      static void forget(const uint8_t /* id */); // Remove history from disk
+      static String getTypeStr(const uint8_t /* type */); // Return event type as string
+  };
+
+} // namespace ds
+
+#endif // _DS_EVENTHISTORY_H_
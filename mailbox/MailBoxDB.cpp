@@ -0,0 +1,139 @@
+/* DS mailbox automation
+ * * Local module
+ * * * Mailbox database implementation
+ * (c) DNS 2020-2023
+ */
+
+#include "MySystem.h"         // System-level definitions
+
+#ifndef DS_MAILBOX_REMOTE
+
+#include "MailBoxDB.h"
+#include <coredecls.h>        // crc32()
+
+using namespace ds;
+
+const char *MailBoxDB::FILE_NAME PROGMEM = "/mailboxes.db";
+
+// Constructor
+MailBoxDB::MailBoxDB() : offsets(), free_slots(), free_slots_num(0), file_end(0) {}
+
+// Create empty database
+bool MailBoxDB::create() {
+  header_t header;
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.reserved = 0;
+  header.record_size = sizeof(mailbox_record_t);
+  header.crc = crc32(&header, offsetof(header_t, crc));
+
+  auto f = System::fs.open(FILE_NAME, "w");
+  if (!f || f.write((const uint8_t *)&header, sizeof(header)) != sizeof(header)) {
+    System::log->printf(TIMED("Error creating %s\n"), FILE_NAME);
+    return false;
+  }
+  f.close();
+  file_end = sizeof(header);
+  return true;
+}
+
+// Open database for loading. Returns false if database has been created anew
+bool MailBoxDB::begin() {
+  memset(offsets, 0, sizeof(offsets));
+  free_slots_num = 0;
+  file_end = 0;
+
+  file = System::fs.open(FILE_NAME, "r");
+  if (file) {
+    header_t header;
+    if (file.read((uint8_t *)&header, sizeof(header)) == sizeof(header) && header.magic == MAGIC
+        && header.crc == crc32(&header, offsetof(header_t, crc))
+        && header.version == VERSION && header.record_size == sizeof(mailbox_record_t)) {
+      file_end = sizeof(header);
+      return true;
+    }
+
+    // Keep whatever is there for analysis and start over
+    file.close();
+    System::log->printf(TIMED("%s is incompatible or corrupted; starting a new one\n"), FILE_NAME);
+    String bak_name = FILE_NAME;
+    bak_name += F(".bak");
+    System::fs.remove(bak_name);
+    System::fs.rename(FILE_NAME, bak_name);
+  }
+  create();
+  return false;
+}
+
+// Read the next mailbox record. Returns false when there are no more records
+//// All records are read in one sequential pass over the file
+bool MailBoxDB::next(mailbox_record_t& rec) {
+  while (file) {
+    if (file.read((uint8_t *)&rec, sizeof(rec)) != sizeof(rec)) {
+      file.close();   // End of file. Incomplete trailing record, if any, will be overwritten by the next append
+      return false;
+    }
+    const auto offset = file_end;
+    file_end += sizeof(rec);
+    if (rec.id >= MAILBOX_ID_MIN && !offsets[rec.id] && rec.crc == crc32(&rec, offsetof(mailbox_record_t, crc))) {
+      offsets[rec.id] = offset;
+      return true;
+    }
+
+    // Free, corrupted or duplicate record; make the slot available for reuse
+    if (rec.id)
+      System::log->printf(TIMED("Invalid record for mailbox=%hhu in %s; ignoring\n"), rec.id, FILE_NAME);
+    if (free_slots_num < FREE_SLOTS_MAX)
+      free_slots[free_slots_num++] = offset;
+  }
+  return false;
+}
+
+// Write record at given position
+bool MailBoxDB::write(const uint32_t offset, mailbox_record_t& rec) {
+  rec.crc = crc32(&rec, offsetof(mailbox_record_t, crc));
+  auto f = System::fs.open(FILE_NAME, "r+");
+  if (!f || !f.seek(offset) || f.write((const uint8_t *)&rec, sizeof(rec)) != sizeof(rec)) {
+    System::log->printf(TIMED("Error writing %s\n"), FILE_NAME);
+    return false;
+  }
+  f.close();
+  return true;
+}
+
+// Save mailbox record
+bool MailBoxDB::save(mailbox_record_t& rec) {
+  if (rec.id < MAILBOX_ID_MIN || !file_end)
+    return false;
+  auto offset = offsets[rec.id];
+  if (!offset) {
+
+    // New mailbox; reuse a freed slot or append
+    offset = free_slots_num ? free_slots[free_slots_num - 1] : file_end;
+    if (!write(offset, rec))
+      return false;
+    if (free_slots_num)
+      free_slots_num--;
+    else
+      file_end += sizeof(rec);
+    offsets[rec.id] = offset;
+    return true;
+  }
+  return write(offset, rec);
+}
+
+// Remove mailbox record
+bool MailBoxDB::erase(const uint8_t id) {
+  if (id < MAILBOX_ID_MIN || !offsets[id])
+    return false;
+  mailbox_record_t rec;
+  memset(&rec, 0, sizeof(rec));
+  if (!write(offsets[id], rec))
+    return false;
+  if (free_slots_num < FREE_SLOTS_MAX)
+    free_slots[free_slots_num++] = offsets[id];
+  offsets[id] = 0;
+  return true;
+}
+
+#endif // !DS_MAILBOX_REMOTE
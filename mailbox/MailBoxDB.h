@@ -0,0 +1,64 @@
+/* DS mailbox automation
+ * * Local module
+ * * * Mailbox database definition
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_MAILBOXDB_H_
+#define _DS_MAILBOXDB_H_
+
+#include <FS.h>                        // File
+#include "VirtualMailBox.h"            // Mailbox definition
+#include "BatteryHistory.h"            // Battery history
+
+namespace ds {
+
+  // Mailbox database record (fixed size)
+  typedef struct _mailbox_record {
+    uint8_t id;                        // Mailbox ID (0 means free slot)
+    uint8_t battery;                   // Battery level (%)
+    char label[VirtualMailBox::LABEL_LENGTH_MAX + 1]; // Label (null-terminated)
+    uint32_t last_seen;                // Last report time
+    uint32_t last_boot;                // Last boot time
+    BatteryHistory::record_t battery_history; // Battery level history
+    uint32_t crc;                      // Checksum of the fields above
+  } __attribute__ ((packed)) mailbox_record_t;
+
+  // Database of mailboxes, kept in a single file
+  //// File is a header followed by fixed size records. Records are updated in place; new records are appended or reuse freed slots
+  class MailBoxDB {
+      static const uint32_t MAGIC = 0x444d5344;  // "DSMD"
+      static const uint8_t VERSION = 2;          // File format version
+      static const uint8_t FREE_SLOTS_MAX = 8;   // Max number of freed slots tracked for reuse
+
+      // File header
+      typedef struct {
+        uint32_t magic;                          // Magic number
+        uint8_t version;                         // File format version
+        uint8_t reserved;                        // Reserved (0)
+        uint16_t record_size;                    // Record size (B)
+        uint32_t crc;                            // Checksum of the fields above
+      } __attribute__ ((packed)) header_t;
+
+      File file;                                 // Database file (open during loading only)
+      uint32_t offsets[MAILBOX_ID_MAX + 1];      // Record positions by mailbox ID (0 means not stored)
+      uint32_t free_slots[FREE_SLOTS_MAX];       // Positions of freed records
+      uint8_t free_slots_num;                    // Number of freed records tracked
+      uint32_t file_end;                         // Position of the end of file
+
+      bool create();                             // Create empty database
+      bool write(const uint32_t /* offset */, mailbox_record_t& /* rec */); // Write record at given position
+
+    public:
+      static const char *FILE_NAME;              // Database file name
+
+      MailBoxDB();                               // Constructor
+      bool begin();                              // Open database for loading. Returns false if database has been created anew
+      bool next(mailbox_record_t& /* rec */);    // Read the next mailbox record. Returns false when there are no more records
+      bool save(mailbox_record_t& /* rec */);    // Save mailbox record
+      bool erase(const uint8_t /* id */);        // Remove mailbox record
+  };
+
+} // namespace ds
+
+#endif // _DS_MAILBOXDB_H_
@@ -9,76 +9,167 @@
 #ifndef DS_MAILBOX_REMOTE
 
 #include "MailBoxManager.h"
+#include <new>                // Placement new, std::nothrow
+#include "MailBoxDB.h"        // Mailbox database
+#include "WebEvents.h"        // Web events
 
 using namespace ds;
 
-// A helper function to compare mailboxes
-static bool cmp_vmb(const VirtualMailBox *mb1, const VirtualMailBox *mb2) {
-  if (!mb1 || !mb2)
-    return false;
-  return *mb1 < *mb2;
-}
+extern MailBoxDB mailbox_db;                // Mailbox database
+extern WebEvents web_events;                // Web events
 
 // Constructor
-MailBoxManager::MailBoxManager(): alarm(ALARM_NONE) {}
+MailBoxManager::MailBoxManager(): slot_ids(), mailbox_ids(), slot_blocks(), num_mailboxes(0), alarm(ALARM_NONE), alarm_counts(), recent_messages(), recent_messages_pos(0),
+    state_nonce(0), state_version(0) {
+  memset(slot_index, SLOT_NONE, sizeof(slot_index));
+}
 
 // Collection destructor (normally never called)
+//// Only releases memory. Pending updates are flushed with save() ahead of a planned restart instead
 MailBoxManager::~MailBoxManager() {
-  for (auto mb : mailboxes)
-    delete mb;
+  for (uint8_t n = 0; n < MAILBOXES_MAX; n++)
+    if (slot_ids[n])
+      slot(slot_ids[n])->~VirtualMailBox();
+  for (uint8_t b = 0; b < BLOCKS_MAX; b++)
+    delete[] slot_blocks[b];
+}
+
+// Return mailbox in its slot (nullptr == not registered)
+VirtualMailBox *MailBoxManager::slot(const uint8_t mb_id) const {
+  const auto n = slot_index[mb_id];
+  return n == SLOT_NONE ? nullptr : (VirtualMailBox *)slot_blocks[n / SLOTS_PER_BLOCK][n % SLOTS_PER_BLOCK].storage;
+}
+
+// Construct mailbox in a free slot
+//// Mailboxes live in slot blocks which are allocated when the slots in use are exhausted, so there is no heap allocation
+//// for most registrations and no memory is reserved for mailboxes which do not exist. Slots are looked up via index
+VirtualMailBox *MailBoxManager::createMailBox(const uint8_t mb_id) {
+  if (mb_id < MAILBOX_ID_MIN || slot(mb_id))
+    return nullptr;
+
+  // Prefer free slots in allocated blocks
+  unsigned int n = 0;
+  while (n < MAILBOXES_MAX && (slot_ids[n] || !slot_blocks[n / SLOTS_PER_BLOCK]))
+    n++;
+  if (n == MAILBOXES_MAX) {
+    n = 0;
+    while (n < MAILBOXES_MAX && slot_blocks[n / SLOTS_PER_BLOCK])
+      n += SLOTS_PER_BLOCK;
+    if (n >= MAILBOXES_MAX) {
+      System::log->printf(TIMED("Cannot register mailbox %hhu: all %hhu slots are in use\n"), mb_id, MAILBOXES_MAX);
+      return nullptr;
+    }
+    slot_blocks[n / SLOTS_PER_BLOCK] = new (std::nothrow) slot_t[SLOTS_PER_BLOCK];
+    if (!slot_blocks[n / SLOTS_PER_BLOCK]) {
+      System::log->printf(TIMED("Cannot register mailbox %hhu: out of memory\n"), mb_id);
+      return nullptr;
+    }
+  }
+  const auto mailbox = new(slot_blocks[n / SLOTS_PER_BLOCK][n % SLOTS_PER_BLOCK].storage) VirtualMailBox(mb_id);
+  slot_ids[n] = mb_id;
+  slot_index[mb_id] = n;
+
+  // Keep the list of registered IDs sorted, so that printouts come in ID order
+  auto i = num_mailboxes++;
+  for (; i && mailbox_ids[i - 1] > mb_id; i--)
+    mailbox_ids[i] = mailbox_ids[i - 1];
+  mailbox_ids[i] = mb_id;
+  alarm_counts[mailbox->getAlarm()]++;
+  markChanged();
+  return mailbox;
+}
+
+// Destruct mailbox in its slot
+void MailBoxManager::destroyMailBox(const uint8_t mb_id) {
+  const auto mailbox = slot(mb_id);
+  if (!mailbox)
+    return;
+  alarm_counts[mailbox->getAlarm()]--;
+  web_events.publish(*mailbox);
+  mailbox->~VirtualMailBox();
+  const auto n = slot_index[mb_id];
+  slot_ids[n] = 0;
+  slot_index[mb_id] = SLOT_NONE;
+  uint8_t i = 0;
+  while (mailbox_ids[i] != mb_id)
+    i++;
+  num_mailboxes--;
+  for (; i < num_mailboxes; i++)
+    mailbox_ids[i] = mailbox_ids[i + 1];
+
+  // Release the block if it is not used anymore
+  const uint8_t first = n - n % SLOTS_PER_BLOCK;
+  bool used = false;
+  for (uint8_t i = first; i < first + SLOTS_PER_BLOCK && i < MAILBOXES_MAX; i++)
+    used = used || slot_ids[i];
+  if (!used) {
+    delete[] slot_blocks[n / SLOTS_PER_BLOCK];
+    slot_blocks[n / SLOTS_PER_BLOCK] = nullptr;
+  }
+  updateAlarm();
+  markChanged();
 }
 
 // Initialize mailboxes
 void MailBoxManager::begin() {
   System::log->printf(TIMED("Initializing mailboxes... "));
-  for (uint8_t i = MAILBOX_ID_MIN; i <= MAILBOX_ID_MAX; i++) {
-    auto mailbox = VirtualMailBox::load(i);
-    if (mailbox)
-      mailboxes.push_front(mailbox);
-    yield();
+  const auto t0 = millis();
+  state_nonce = ESP.random();
+  if (mailbox_db.begin()) {
+    mailbox_record_t rec;
+    while (mailbox_db.next(rec)) {
+      auto mailbox = createMailBox(rec.id);
+      if (mailbox)
+        mailbox->load(rec);
+    }
+  } else {
+
+    // New database; migrate mailboxes from legacy per-mailbox files, if any. Legacy files were only used with basic protocol
+    for (unsigned int i = MAILBOX_ID_MIN; i <= MAILBOX_ID_MAX_BASIC; i++) {
+      auto mailbox = createMailBox(i);
+      if (mailbox && mailbox->loadLegacy()) {
+        mailbox->save();
+        VirtualMailBox::forgetLegacy(i);
+      } else
+        destroyMailBox(i);
+      yield();
+    }
   }
-  mailboxes.sort(cmp_vmb);
-  if (mailboxes.empty())
+  if (!num_mailboxes)
     System::log->println("none found");
   else
-    System::log->printf("%d loaded\n", std::distance(mailboxes.begin(), mailboxes.end()));
+    System::log->printf("%hhu loaded in %lu ms (%lu ms since boot, free heap %u B, max free block %u B)\n",
+      num_mailboxes, millis() - t0, millis(), ESP.getFreeHeap(), ESP.getMaxFreeBlockSize());
 }
 
-// Regular check of mailboxes' status
+// Regular check of mailboxes' status; saving of pending updates
 void MailBoxManager::update(const bool force) {
-  if ((System::getTimeSyncStatus() != TIME_SYNC_NONE && System::newHour()) || force) {
-    auto nok = false;
+  for (uint8_t n = 0; n < num_mailboxes; n++)
+    slot(mailbox_ids[n])->saveIfDue();
 
-    for (auto mb : mailboxes)
-      if(!mb->isOK())
-        nok = true;
+  if ((System::getTimeSyncStatus() != TIME_SYNC_NONE && System::newHour()) || force) {
+    markChanged();   // Time windows of radio statistics have moved
 
-    if(nok)
-      updateAlarm();
+    // Degraded mailboxes raise their alarms, which propagates to global alarm via the change hook
+    for (uint8_t n = 0; n < num_mailboxes; n++) {
+      const auto mailbox = slot(mailbox_ids[n]);
+      mailbox->isOK();
+      web_events.publish(*mailbox);     // Radio reliability and uptime have changed anyway
+    }
   }
 }
 
 // Find mailbox by ID. If not found, allow registering a new one
 VirtualMailBox *MailBoxManager::getMailBox(const uint8_t mb_id, bool create) {
-  VirtualMailBox *mailbox = nullptr;
-
-  if (!mb_id)
-    return mailbox;
-
-  for (auto mb : mailboxes) {
-    if (*mb == mb_id) {
-      mailbox = mb;    // Found
-      break;
-    }
-  }
+  if (mb_id < MAILBOX_ID_MIN)
+    return nullptr;
 
+  auto mailbox = slot(mb_id);
   if (!mailbox && create) {
 
     // Register a new one
-    mailbox = new VirtualMailBox(mb_id);
+    mailbox = createMailBox(mb_id);
     if (mailbox) {
-      mailboxes.push_front(mailbox);
-      mailboxes.sort(cmp_vmb);
       String lmsg = F("Registered new mailbox, id=");
       lmsg += mb_id;
       System::appLogWriteLn(lmsg, true);
@@ -93,8 +184,37 @@ VirtualMailBox *MailBoxManager::operator[](const uint8_t mb_id) {
   return getMailBox(mb_id);
 }
 
+// Return number of registered mailboxes
+uint8_t MailBoxManager::getNumMailBoxes() const {
+  return num_mailboxes;
+}
+
+// Return n-th registered mailbox in ID order (nullptr == out of range)
+VirtualMailBox *MailBoxManager::getMailBoxAt(const uint8_t n) const {
+  return n < num_mailboxes ? slot(mailbox_ids[n]) : nullptr;
+}
+
+// Check if message has already been processed. Remember it otherwise
+//// Remote module may send every message several times; copies carry the same mailbox ID and message number
+bool MailBoxManager::isDuplicate(const MailBoxMessage &msg) {
+  const auto mb_id = msg.getMailBoxID();
+  const auto msg_num = msg.getMessageNumber();
+  const auto now = millis();
+  for (const auto& rm : recent_messages)
+    if (rm.mb_id == mb_id && rm.msg_num == msg_num && now - rm.t < DUPLICATE_TIME)
+      return true;
+  recent_messages[recent_messages_pos] = {mb_id, msg_num, now};
+  recent_messages_pos = (recent_messages_pos + 1) % RECENT_MESSAGES_SIZE;
+  return false;
+}
+
 // Update mailbox from received message; create if not found
 bool MailBoxManager::process(const MailBoxMessage &msg) {
+  if (isDuplicate(msg)) {
+    System::log->printf(TIMED("Duplicate message (%hu) from mailbox %hhu; ignoring\n"), msg.getMessageNumber(), msg.getMailBoxID());
+    return true;
+  }
+
   const auto mailbox = getMailBox(msg.getMailBoxID(), true);
 
   if (!mailbox) {
@@ -102,36 +222,35 @@ bool MailBoxManager::process(const MailBoxMessage &msg) {
     return false;
   }
 
-  // Update mailbox
+  // Update mailbox. Global alarm, its display and state version follow via the change hooks
+  const auto t0 = micros();
   *mailbox = msg;
-
-  // Update global alarm and its display
-  updateAlarm();
+  System::log->printf(TIMED("Message processed in %lu us\n"), micros() - t0);
 
   return true;
 }
 
+// Save all pending mailbox updates to disk immediately
+void MailBoxManager::save() {
+  for (uint8_t n = 0; n < num_mailboxes; n++)
+    slot(mailbox_ids[n])->saveIfDue(true);
+}
+
 // Delete mailbox with a given ID
 bool MailBoxManager::deleteMailBox(const uint8_t mb_id) {
-  for (auto mb : mailboxes) {
-    if (*mb == mb_id) {
-      delete mb;
-      mailboxes.remove(mb);
-      return VirtualMailBox::forget(mb_id);
-    }
-  }
-  return false; // Not found
+  if (!getMailBox(mb_id))
+    return false; // Not found
+  destroyMailBox(mb_id);
+  return VirtualMailBox::forget(mb_id);
 }
 
 // Update global alarm and its display with the latest status from mailboxes
+//// Global alarm is the highest level having mailboxes in it, so this does not depend on number of mailboxes
 void MailBoxManager::updateAlarm() {
   const auto alarm_prev = alarm;
-  alarm = ALARM_NONE;
-  for (auto mb : mailboxes) {
-    auto a = mb->getAlarm();
-    if (a > alarm)
-      alarm = a;
-  }
+  alarm = ALARM_DOOR_OPEN;
+  while (alarm != ALARM_NONE && !alarm_counts[alarm])
+    alarm = (mailbox_alarm)(alarm - 1);
   if (alarm != alarm_prev) {
 
     // Signal the highest severity with LED
@@ -144,10 +263,26 @@ void MailBoxManager::updateAlarm() {
       case ALARM_DOOR_LEFTOPEN: System::led.Breathe(3000).Forever();            break;
       case ALARM_DOOR_OPEN:     System::led.Blink(250, 250).Forever();          break;
     }
+    web_events.publishAlarm();
   }
 }
 
+// Return global alarm
+mailbox_alarm MailBoxManager::getAlarm() const {
+  return alarm;
+}
+
+// Mailbox alarm change hook
+void MailBoxManager::onAlarmChange(const VirtualMailBox& mailbox, const mailbox_alarm old_alarm, const mailbox_alarm new_alarm) {
+  alarm_counts[old_alarm]--;
+  alarm_counts[new_alarm]++;
+  updateAlarm();
+  markChanged();
+  web_events.publish(mailbox);
+}
+
 // Acknowledge alarm. Returns the alarm acknowledged
+//// Web pages are updated via the change hook, that is, only for mailboxes whose alarm has actually changed
 mailbox_alarm MailBoxManager::acknowledgeAlarm(const String &via, const uint8_t mb_id) {
   auto mailbox = getMailBox(mb_id);
   const auto alarm_ack = mailbox ? mailbox->getAlarm() : alarm;
@@ -155,9 +290,9 @@ mailbox_alarm MailBoxManager::acknowledgeAlarm(const String &via, const uint8_t
     if (mailbox)
       mailbox->resetAlarm();
     else
-      for (auto mb : mailboxes)
-        mb->resetAlarm();
-    updateAlarm();
+      for (uint8_t n = 0; n < num_mailboxes; n++)
+        slot(mailbox_ids[n])->resetAlarm();
+    web_events.send();
     String msg = F("Alarm \"");
     msg += VirtualMailBox::getAlarmStr(alarm_ack);
     msg += F("\"");
@@ -173,44 +308,71 @@ mailbox_alarm MailBoxManager::acknowledgeAlarm(const String &via, const uint8_t
 }
 
 // Print mailboxes table in HTML
-void MailBoxManager::printHTML(String& buf) const {
+void MailBoxManager::printHTML(WebPage& buf) const {
   buf += F("<form action=\"/ack\">\n"
-           "<span style=\"font-size: 3cm;\">");
+           "<span id=\"g_icon\" style=\"font-size: 3cm;\">");
   buf += VirtualMailBox::getAlarmIcon(alarm);
-  buf += F("</span>\n<p>Global status:&nbsp;&nbsp;");
+  buf += F("</span>\n<p>Global status:&nbsp;&nbsp;<span id=\"g_status\">");
   buf += VirtualMailBox::getAlarmStr(alarm, true);
-  buf += F("&nbsp;&nbsp;<input type=\"submit\" value=\"Acknowledge All\"");
+  buf += F("</span>&nbsp;&nbsp;<input id=\"g_ack\" type=\"submit\" value=\"Acknowledge All\"");
   if (alarm == ALARM_NONE)
     buf += F(" disabled=\"true\"");
   buf += F("/></p>\n</form>\n"
     "<table border=\"1\" cellpadding=\"3\" cellspacing=\"0\" style=\"font-family: monospace; border-collapse: collapse;\">\n"
     "<tr><th title=\"ID\">&#x1f4ec;</th><th title=\"Label\">&#x1f3f7;</th><th title=\"Status\">&#x1f6a9;</th>"
-    "<th title=\"Battery\">&#x1f50b;</th><th title=\"Radio Reliability\">&#x1f4f6;</th><th title=\"Last Contact\">&#x1f557;</th><th>&#x1f199;</th><th>&#x2705;</th></tr>\n");
-  if (mailboxes.empty())
-    buf += F("<tr><td colspan=\"8\" style=\"text-align: center\">- No mailboxes have reported so far -</tr>\n");
+    "<th title=\"Battery\">&#x1f50b;</th><th title=\"Battery Time Left\">&#x23f3;</th><th title=\"Radio Reliability (last 100 messages / 24 h / 7 d)\">&#x1f4f6;</th><th title=\"Last Contact\">&#x1f557;</th><th>&#x1f199;</th><th>&#x2705;</th></tr>\n");
+  if (!num_mailboxes)
+    buf += F("<tr><td colspan=\"9\" style=\"text-align: center\">- No mailboxes have reported so far -</tr>\n");
   else
-    for (auto mb : mailboxes)
-      buf << *mb;
+    for (uint8_t n = 0; n < num_mailboxes; n++)
+      buf << *slot(mailbox_ids[n]);
   buf += F("</table>\n");
 }
 
 // Print mailboxes table in text
 void MailBoxManager::printText(String& buf, const uint8_t mb_id) const {
-  if (mailboxes.empty())
+  if (!num_mailboxes)
     buf += F("No mailboxes have reported so far\n");
   else
-    for (auto mb : mailboxes)
-      if (!mb_id || *mb == mb_id)
-        mb->printText(buf);
+    for (uint8_t n = 0; n < num_mailboxes; n++)
+      if (!mb_id || mailbox_ids[n] == mb_id)
+        slot(mailbox_ids[n])->printText(buf);
   buf += F("\xe2\x80\xa2 Receiver: \xf0\x9f\x86\x99 "); // UTF-8 'BULLET', UTF-8 'SQUARED UP WITH EXCLAMATION MARK'
   buf += System::getUptimeStr();
   buf += F("\n");
 }
 
+// Print mailboxes in JSON
+void MailBoxManager::printJSON(Print& out) const {
+  out.print(F("{\"version\":"));
+  out.print((unsigned long)state_version);
+  out.print(F(",\"alarm\":"));
+  out.print((int)alarm);
+  out.print(F(",\"mailboxes\":["));
+  for (uint8_t n = 0; n < num_mailboxes; n++) {
+    if (n)
+      out.print(',');
+    slot(mailbox_ids[n])->printJSON(out);
+  }
+  out.print(F("]}"));
+}
+
+// Mark mailboxes' state as changed (invalidates API responses cached by clients)
+void MailBoxManager::markChanged() {
+  state_version++;
+}
+
+// Return entity tag of the current state
+String MailBoxManager::getETag() const {
+  char etag[20];
+  snprintf(etag, sizeof(etag), "\"%08x-%x\"", (unsigned int)state_nonce, (unsigned int)state_version);
+  return etag;
+}
+
 // HTML printout helper
-String& operator<<(String& html_buf, MailBoxManager& mbm) {
-  mbm.printHTML(html_buf);
-  return html_buf;
+WebPage& operator<<(WebPage& page, MailBoxManager& mbm) {
+  mbm.printHTML(page);
+  return page;
 }
 
 #ifdef DS_SUPPORT_TELEGRAM
@@ -218,7 +380,8 @@ String& operator<<(String& html_buf, MailBoxManager& mbm) {
 void MailBoxManager::printTelegramKeyboard(String& buf) const {
   const uint8_t NUM_MAILBOXES_IN_ROW = 3;     // Max number of mailboxes in a row
   uint8_t n = 0;
-  for (auto mb : mailboxes) {
+  for (uint8_t i = 0; i < num_mailboxes; i++) {
+    const auto mb = slot(mailbox_ids[i]);
     if (n % NUM_MAILBOXES_IN_ROW)
       buf += F(",");                          // Column separator
     else {
@@ -1,13 +1,12 @@
 /* DS mailbox automation
  * * Local module
  * * * Mailbox Manager definition
- * (c) DNS 2020-2021
+ * (c) DNS 2020-2023
  */
 
 #ifndef _DS_MAILBOXMANAGER_H_
 #define _DS_MAILBOXMANAGER_H_
 
-#include <forward_list>       // Linked list
 #include <Arduino.h>          // uint8_t, ...
 #include "VirtualMailBox.h"   // Mailbox definition
 #include "MailBoxMessage.h"   // Mailbox message
@@ -16,22 +15,67 @@ namespace ds {
   
   // Collection of mailboxes
   class MailBoxManager {
-      std::forward_list<VirtualMailBox *> mailboxes;  // List of mailboxes served by this module
+    public:
+      static const uint8_t MAILBOXES_MAX = 32;        // Max number of mailboxes served simultaneously. IDs go up to MAILBOX_ID_MAX, but a mailbox
+                                                      // takes about 0.5 KiB of heap, and TLS for Telegram needs some 20 KiB of the ~40 KiB free
+
+    private:
+      static const uint8_t RECENT_MESSAGES_SIZE = 8;  // Number of recently processed messages remembered for duplicate detection
+      static const unsigned long DUPLICATE_TIME = 30000; // Interval during which a repeated message is considered a duplicate (ms)
+      static const uint8_t SLOT_NONE = 0xff;          // Index value for a mailbox not registered
+      static const uint8_t SLOTS_PER_BLOCK = 4;       // Number of mailbox slots allocated at once
+      static const uint8_t BLOCKS_MAX = (MAILBOXES_MAX + SLOTS_PER_BLOCK - 1) / SLOTS_PER_BLOCK; // Max number of slot blocks
+
+      // Storage for one mailbox
+      struct slot_t {
+        alignas(VirtualMailBox) uint8_t storage[sizeof(VirtualMailBox)];
+      };
+
+      // Recently processed message record
+      struct recent_message_t {
+        uint8_t mb_id;                                // Mailbox ID (0 means unused)
+        uint16_t msg_num;                             // Message number
+        unsigned long t;                              // Time of processing (ms from boot)
+      };
+
+      uint8_t slot_index[MAILBOX_ID_MAX + 1];         // Storage slots of mailboxes served by this module, indexed by ID (SLOT_NONE == not registered)
+      uint8_t slot_ids[MAILBOXES_MAX];                // Mailbox IDs occupying storage slots (0 == free)
+      uint8_t mailbox_ids[MAILBOXES_MAX];             // IDs of registered mailboxes in ascending order (num_mailboxes of them)
+      slot_t *slot_blocks[BLOCKS_MAX];                // Storage for mailboxes, allocated in blocks on demand (nullptr == not allocated)
+      uint8_t num_mailboxes;                          // Number of registered mailboxes
       mailbox_alarm alarm;                            // Global alarm level
+      uint8_t alarm_counts[ALARM_DOOR_OPEN + 1];      // Number of mailboxes per alarm level
+      recent_message_t recent_messages[RECENT_MESSAGES_SIZE]; // Recently processed messages (ring buffer)
+      uint8_t recent_messages_pos;                    // Position of the next record to overwrite
+      uint32_t state_nonce;                           // Random value identifying this boot (makes ETags unique across reboots)
+      uint32_t state_version;                         // Version of mailboxes' state; incremented on every change
+
+      bool isDuplicate(const MailBoxMessage& /* msg */); // Check if message has already been processed. Remember it otherwise
+      VirtualMailBox *slot(const uint8_t /* mb_id */) const; // Return mailbox in its slot (nullptr == not registered)
+      VirtualMailBox *createMailBox(const uint8_t /* mb_id */); // Construct mailbox in its slot
+      void destroyMailBox(const uint8_t /* mb_id */); // Destruct mailbox in its slot
 
     public:
       MailBoxManager();                               // Constructor
       ~MailBoxManager();                              // Collection destructor (normally never called)
       void begin();                                   // Initialize mailboxes
-      void update(const bool force = false);          // Regular check of mailboxes' status
+      void update(const bool force = false);          // Regular check of mailboxes' status; saving of pending updates
       VirtualMailBox *getMailBox(const uint8_t /* mb_id */, bool create = false); // Find mailbox by ID. If not found, allow registering a new one
       VirtualMailBox *operator[](const uint8_t /* mb_id */); // Find existing mailbox by ID
+      uint8_t getNumMailBoxes() const;                // Return number of registered mailboxes
+      VirtualMailBox *getMailBoxAt(const uint8_t /* n */) const; // Return n-th registered mailbox in ID order (nullptr == out of range)
       bool process(const MailBoxMessage& /* msg */);  // Update mailbox from received message; create if not found
       bool deleteMailBox(const uint8_t /* mb_id */);  // Delete mailbox with a given ID
+      mailbox_alarm getAlarm() const;                 // Return global alarm
       void updateAlarm();                             // Update global alarm and its display with the latest status from mailboxes
+      void onAlarmChange(const VirtualMailBox& /* mailbox */, const mailbox_alarm /* old_alarm */, const mailbox_alarm /* new_alarm */); // Mailbox alarm change hook
+      void save();                                    // Save all pending mailbox updates to disk immediately
       mailbox_alarm acknowledgeAlarm(const String& /* via */, const uint8_t mb_id = 0); // Acknowledge alarm. Returns the alarm acknowledged
-      void printHTML(String& /* buf */) const;        // Print mailboxes table in HTML
+      void printHTML(WebPage& /* page */) const;      // Print mailboxes table in HTML
       void printText(String& /* buf */, const uint8_t mb_id = 0) const; // Print mailboxes table in text
+      void printJSON(Print& /* out */) const;         // Print mailboxes in JSON
+      void markChanged();                             // Mark mailboxes' state as changed (invalidates API responses cached by clients)
+      String getETag() const;                         // Return entity tag of the current state
 #ifdef DS_SUPPORT_TELEGRAM
       void printTelegramKeyboard(String& /* buf */) const; // Print Telegram keyboard for mailboxes
 #endif // DS_SUPPORT_TELEGRAM
@@ -39,6 +83,6 @@ namespace ds {
 
 } // namespace ds
 
-String& operator<<(String& /* html_buf */, ds::MailBoxManager& /* mbm */);  // HTML printout helper
+ds::WebPage& operator<<(ds::WebPage& /* page */, ds::MailBoxManager& /* mbm */);  // HTML printout helper
 
 #endif // _DS_MAILBOXMANAGER_H_
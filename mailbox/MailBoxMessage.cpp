@@ -8,39 +8,110 @@
 
 using namespace ds;
 
+// CRC-8 lookup table, computed at compile time
+static const uint8_t CRC8_POLY = 0x07;      // x^8 + x^2 + x + 1 (x^8 implied)
+struct crc8_table_t {
+  uint8_t v[256];
+  constexpr crc8_table_t() : v() {
+    for (unsigned int i = 0; i < sizeof(v); i++) {
+      uint8_t crc = i;
+      for (uint8_t b = 0; b < 8; b++)
+        crc = crc & 0x80 ? (crc << 1) ^ CRC8_POLY : crc << 1;
+      v[i] = crc;
+    }
+  }
+};
+static constexpr crc8_table_t CRC8_TABLE PROGMEM;
+
+// Extended Hamming(8,4) code. Codeword layout: bits 0-3 - data, bits 4-6 - Hamming parity, bit 7 - overall parity
+//// Minimal distance between codewords is 4, so a single bit error can be corrected and a double one detected
+static constexpr uint8_t fecEncode(const uint8_t nibble) {
+  const uint8_t d0 = nibble & 1, d1 = nibble >> 1 & 1, d2 = nibble >> 2 & 1, d3 = nibble >> 3 & 1;
+  const uint8_t cw = (nibble & 0x0f) | (d0 ^ d1 ^ d3) << 4 | (d0 ^ d2 ^ d3) << 5 | (d1 ^ d2 ^ d3) << 6;
+  uint8_t parity = 0;
+  for (uint8_t b = 0; b < 7; b++)
+    parity ^= cw >> b & 1;
+  return cw | parity << 7;
+}
+
+//// Decoding table: received codeword -> data nibble. Bit 4 is set if a bit error has been corrected
+static const uint8_t FEC_CORRECTED = 0x10;       // Flag of corrected codeword
+static const uint8_t FEC_ERROR = 0xff;           // Marker of uncorrectable codeword
+struct fec_table_t {
+  uint8_t v[256];
+  constexpr fec_table_t() : v() {
+    for (unsigned int i = 0; i < sizeof(v); i++) {
+      v[i] = FEC_ERROR;
+      for (uint8_t nibble = 0; nibble < 16; nibble++) {
+        uint8_t diff = i ^ fecEncode(nibble), dist = 0;
+        for (; diff; diff >>= 1)
+          dist += diff & 1;
+        if (dist <= 1) {
+          v[i] = nibble | (dist ? FEC_CORRECTED : 0);
+          break;
+        }
+      }
+    }
+  }
+};
+static constexpr fec_table_t FEC_TABLE PROGMEM;
+
 // Calculate checksum
+//// XOR misses any even number of flipped bits in the same bit position; CRC-8 catches all 1-3 bit errors in a message
 uint8_t MailBoxMessage::checksum() const {
+  const auto len = getSize() - 1;
   uint8_t sum = 0;
-  for (uint8_t i = 0; i < sizeof(msg_buf) - 1; i++)
-    sum ^= msg_buf[i];
+  if (msg.version == PROTO_VERSION_CRC8 || msg.version == PROTO_VERSION_EXT)
+    for (uint8_t i = 0; i < len; i++)
+      sum = pgm_read_byte(&CRC8_TABLE.v[sum ^ msg_buf[i]]);
+  else
+    for (uint8_t i = 0; i < len; i++)
+      sum ^= msg_buf[i];
   return sum;
 }
 
+// Return true if message uses extended protocol
+bool MailBoxMessage::isExtended() const {
+  return msg.version == PROTO_VERSION_EXT;
+}
+
 // Initialize the message
 void MailBoxMessage::init(const uint8_t rx_id) {
   memset(msg_buf, 0, sizeof(msg_buf));
   msg.version = PROTO_VERSION;
-  msg.recv_id = rx_id;
+  if (isExtended())
+    msg_ext.recv_id = rx_id;
+  else
+    msg.recv_id = rx_id;
 }
 
 // Finalize the message
 void MailBoxMessage::terminate() {
-  msg.checksum = checksum();
+  msg_buf[getSize() - 1] = checksum();
 }
 
-// Check protocol version
+// Check protocol version (any supported)
 bool MailBoxMessage::protocolVersionOK() const {
-  return msg.version == PROTO_VERSION;
+  return msg.version == PROTO_VERSION_XOR || msg.version == PROTO_VERSION_CRC8 || msg.version == PROTO_VERSION_EXT;
 }
 
 // Verify checksum
 bool MailBoxMessage::checksumOK() const {
-  return msg.checksum == checksum();
+  return msg_buf[getSize() - 1] == checksum();
 }
 
-// Return message size (B)
+// Return message size (B). Depends on protocol version
+//// Unknown versions are assumed to have basic layout
 size_t MailBoxMessage::getSize() const {
-  return sizeof(msg_buf);
+  return isExtended() ? sizeof(msg_ext) : sizeof(msg);
+}
+
+// Load message from buffer. Returns false if length does not match protocol version
+bool MailBoxMessage::load(const byte* buf, const size_t len) {
+  if (!len || len > sizeof(msg_buf))
+    return false;
+  memcpy(msg_buf, buf, len);
+  return getSize() == len;
 }
 
 // Set individual byte in the message buffer
@@ -58,7 +129,7 @@ byte& MailBoxMessage::operator[](const uint8_t pos) {
 
 // Return receiver ID
 uint8_t MailBoxMessage::getReceiverID() const {
-  return msg.recv_id;
+  return isExtended() ? msg_ext.recv_id : msg.recv_id;
 }
 
 // Return protocol version
@@ -68,12 +139,15 @@ uint8_t MailBoxMessage::getProtocolVersion() const {
 
 // Return through message number
 uint16_t MailBoxMessage::getMessageNumber() const {
-  return ntohs(msg.msg_num);
+  return ntohs(isExtended() ? msg_ext.msg_num : msg.msg_num);
 }
 
 // Set through message number
 void MailBoxMessage::setMessageNumber(const uint16_t num) {
-  msg.msg_num = htons(num);
+  if (isExtended())
+    msg_ext.msg_num = htons(num);
+  else
+    msg.msg_num = htons(num);
 }
 
 // Get next message number (overflow-safe)
@@ -85,62 +159,80 @@ uint16_t MailBoxMessage::getNextMessageNumber(uint16_t& num) {
 
 // Return time (ms since boot)
 uint16_t MailBoxMessage::getTime() const {
-  return ntohs(msg.time);
+  return ntohs(isExtended() ? msg_ext.time : msg.time);
 }
 
 // Set time (ms since boot)
 void MailBoxMessage::setTime(const unsigned long ms) {
-  msg.time = htons(ms);
+  if (isExtended())
+    msg_ext.time = htons(ms);
+  else
+    msg.time = htons(ms);
 }
 
 // Return battery level (%)
 uint8_t MailBoxMessage::getBattery() const {
-  return msg.battery;
+  return isExtended() ? msg_ext.battery : msg.battery;
 }
 
 // Set battery level (%)
 void MailBoxMessage::setBattery(const uint8_t level) {
-  msg.battery = level;
+  if (isExtended())
+    msg_ext.battery = level;
+  else
+    msg.battery = level;
 }
 
 // Return mailbox ID
 uint8_t MailBoxMessage::getMailBoxID() const {
-  return msg.mb_id;
+  return isExtended() ? msg_ext.mb_id : msg.mb_id;
 }
 
 // Set mailbox ID
 void MailBoxMessage::setMailBoxID(const uint8_t id) {
-  msg.mb_id = id;
+  if (isExtended())
+    msg_ext.mb_id = id;
+  else
+    msg.mb_id = id;
 }
 
 // Return boot status (false/true == deep sleep/other)
 bool MailBoxMessage::getBoot() const {
-  return msg.boot;
+  return isExtended() ? msg_ext.boot : msg.boot;
 }
 
 // Set boot status (false/true == deep sleep/other)
 void MailBoxMessage::setBoot(const bool status) {
-  msg.boot = status;
+  if (isExtended())
+    msg_ext.boot = status;
+  else
+    msg.boot = status;
 }
 
 // Return online status (false/true == offline/online)
 bool MailBoxMessage::getOnline() const {
-  return msg.online;
+  return isExtended() ? msg_ext.online : msg.online;
 }
 
 // Set online status (false/true == offline/online)
 void MailBoxMessage::setOnline(const bool status) {
-  msg.online = status;
+  if (isExtended())
+    msg_ext.online = status;
+  else
+    msg.online = status;
 }
 
 // Return door status (false/true == closed/open)
 bool MailBoxMessage::getDoor() const {
-  return msg.door;
+  return isExtended() ? msg_ext.door : msg.door;
 }
 
 // Set door status (false/true == closed/open)
 void MailBoxMessage::setDoor(const bool status) {
-  msg.door = status;
+  if (isExtended())
+    msg_ext.door = status;
+  else
+    msg.door = status;
 }
 
 // Switch printing preference to default (parsed)
@@ -159,9 +251,9 @@ const MailBoxMessage& MailBoxMessage::asRaw() {
 size_t MailBoxMessage::printTo(Print& log) const {
   size_t printed = 0;
   if (print_raw)
-    for (size_t i = 0; i < sizeof(msg_buf); i++) {
+    for (size_t i = 0; i < getSize(); i++) {
       printed += log.printf("%02x", msg_buf[i]);
-      if (i < sizeof(msg_buf) - 1)
+      if (i < getSize() - 1)
         printed += log.print(".");
     }
   else
@@ -172,5 +264,47 @@ size_t MailBoxMessage::printTo(Print& log) const {
 
 // Send message
 size_t MailBoxMessage::send(Stream& tx) const {
-  return tx.write(msg_buf, sizeof(msg_buf));
+  return tx.write(msg_buf, getSize());
+}
+
+// Send message with forward error correction
+size_t MailBoxMessage::sendFEC(Stream& tx) const {
+  const auto len = getSize();
+  byte buf[2 * sizeof(msg_buf)];
+  for (uint8_t i = 0; i < len; i++) {
+    buf[2 * i]     = fecEncode(msg_buf[i] & 0x0f);
+    buf[2 * i + 1] = fecEncode(msg_buf[i] >> 4);
+  }
+  return tx.write(buf, 2 * len);
+}
+
+// Return true if buffer consists of valid FEC codewords only
+//// Such buffer is almost certainly a part of an FEC-encoded message: only 16 of 256 byte values are codewords
+bool MailBoxMessage::isFECEncoded(const byte* buf, const size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    const uint8_t v = pgm_read_byte(&FEC_TABLE.v[buf[i]]);
+    if (v == FEC_ERROR || v & FEC_CORRECTED)
+      return false;
+  }
+  return true;
+}
+
+// Load message of given length from FEC-encoded buffer. Returns number of bits corrected or -1 if uncorrectable
+//// Note that the message is partially overwritten even if decoding fails
+int8_t MailBoxMessage::decodeFEC(const byte* buf, const size_t len) {
+  if (!len || len > sizeof(msg_buf))
+    return -1;
+  int8_t corrected = 0;
+  for (uint8_t i = 0; i < len; i++) {
+    const uint8_t lo = pgm_read_byte(&FEC_TABLE.v[buf[2 * i]]);
+    const uint8_t hi = pgm_read_byte(&FEC_TABLE.v[buf[2 * i + 1]]);
+    if (lo == FEC_ERROR || hi == FEC_ERROR)
+      return -1;
+    if (lo & FEC_CORRECTED)
+      corrected++;
+    if (hi & FEC_CORRECTED)
+      corrected++;
+    msg_buf[i] = (lo & 0x0f) | (hi & 0x0f) << 4;
+  }
+  return getSize() == len ? corrected : -1;
 }
@@ -11,8 +11,8 @@
 
 /* Addressing scheme: <Communication Channel>.<Receiver ID>.<Mailbox ID>
  * * Communication Channel is pre-programmed into transmitter and receiver RF modules
- * * Receiver ID (1-15) - identifies receiver working on a given channel. 0 means message addressed to any receiver listening
- * * Mailbox ID (1-15) - identifies mailbox reporting to a given receiver. 0 is reserved for the receiver itself
+ * * Receiver ID (1-15; 1-255 in extended protocol) - identifies receiver working on a given channel. 0 means message addressed to any receiver listening
+ * * Mailbox ID (1-15; 1-255 in extended protocol) - identifies mailbox reporting to a given receiver. 0 is reserved for the receiver itself
  * E.g.: 07.01.02 - mailbox #2 reporting to receiver #1 on communication channel #7 (435.8 MHz)
  * * * * 15.03.00 - receiver #3 working on communication channel #15
  * Both receiver and transmitter RF modules must be pre-configured to use the same channel (see "rfconf" sketch)
@@ -21,15 +21,33 @@
  * Each message carries a version of a protocol and a checksum; messages with mismatch in protocol or checksum must be discarded (but may be logged)
  * Protocol version 0 is reserved for development purposes. Applications may accept it at their own risk. Systems in production must use a non-zero version
  * Protocol version must be incremented every time an incompatible change is made
+ * Protocol versions:
+ * * 2 - checksum is XOR of all preceding bytes
+ * * 3 - checksum is CRC-8 (polynomial x^8 + x^2 + x + 1, initial value 0) of all preceding bytes. Message layout is the same as in v2
+ * * 4 - extended protocol: receiver and mailbox IDs are 8 bits wide, so message is 10 bytes long. Checksum is CRC-8 as in v3
+ * Receiver accepts all versions; transmitter sends v2 unless DS_MAILBOX_PROTO_CRC8 (v3) or DS_MAILBOX_PROTO_EXT (v4) is defined
+ * Forward error correction (FEC) is optional and independent of protocol version. With FEC, each byte of the message is sent
+ * as two extended Hamming(8,4) codewords (low nibble first), which allows correcting a single bit error in each codeword.
+ * Receiver accepts both plain and FEC-protected messages; transmitter uses FEC if DS_MAILBOX_FEC is defined
 */
 namespace ds {
 
   // Protocol configuration
-  const uint8_t PROTO_VERSION = 2;           // Protocol version (0-15)
+  const uint8_t PROTO_VERSION_XOR = 2;       // Protocol version with XOR checksum
+  const uint8_t PROTO_VERSION_CRC8 = 3;      // Protocol version with CRC-8 checksum
+  const uint8_t PROTO_VERSION_EXT = 4;       // Protocol version with extended addressing
+#if defined(DS_MAILBOX_PROTO_EXT)
+  const uint8_t PROTO_VERSION = PROTO_VERSION_EXT;  // Protocol version used for sending (0-15)
+#elif defined(DS_MAILBOX_PROTO_CRC8)
+  const uint8_t PROTO_VERSION = PROTO_VERSION_CRC8; // Protocol version used for sending (0-15)
+#else
+  const uint8_t PROTO_VERSION = PROTO_VERSION_XOR;  // Protocol version used for sending (0-15)
+#endif // DS_MAILBOX_PROTO_EXT
   const uint8_t RECEIVER_ID_ANY = 0;         // Broadcast receiver address
   const uint8_t MESSAGE_NUMBER_UNKNOWN = 0;  // Unknown message number
   const uint8_t MAILBOX_ID_MIN = 1;          // Minimal mailbox ID (for use in probing)
-  const uint8_t MAILBOX_ID_MAX = 15;         // Maximum mailbox ID (for use in probing)
+  const uint8_t MAILBOX_ID_MAX_BASIC = 15;   // Maximum mailbox ID in basic protocol
+  const uint8_t MAILBOX_ID_MAX = 255;        // Maximum mailbox ID in extended protocol
   const uint8_t BATTERY_CHANGE_WEIGHT_COEFF = 10; // Weight coefficient for battery level change (> 0)
 
   // Various battery levels (%)
@@ -68,22 +86,62 @@ namespace ds {
     uint8_t checksum;
   } __attribute__ ((packed)) mailbox_message;
 
+  // Transmission message in extended protocol (byte.bit). Byte order is network byte order
+  typedef struct _mailbox_message_ext {
+
+    // 0: header
+    uint8_t version : 4;    // 0.0-3 protocol version (0-15). Must be at the same place as in basic protocol
+    uint8_t _reserved : 4;  // 0.4-7 reserved
+
+    // 1: receiver ID (0-255)
+    uint8_t recv_id;
+
+    // 2: mailbox ID (1-255)
+    uint8_t mb_id;
+
+    // 3: mailbox status
+    uint8_t boot : 1;       // 3.0: boot status (0-wake up from deep sleep, 1-boot for other reason)
+    uint8_t online : 1;     // 3.1: online status (0-offline (going to sleep), 1-online (staying awake))
+    uint8_t door : 1;       // 3.2: door status (0-closed, 1-open)
+    uint8_t _reserved2 : 5; // 3.3-7: reserved
+
+    // 4-5: through message number (1-65535; restarts at 1 on cold start. 0 is reserved as 'unknown')
+    uint16_t msg_num;
+
+    // 6-7: local time (ms from boot) (0-65535)
+    uint16_t time;
+
+    // 8: battery status
+    uint8_t battery : 7;    // 8.0-6: 0-100%. 127 is reserved for 'unknown'
+    uint8_t _reserved3 : 1; // 8.7: reserved
+
+    // 9: checksum (always the last)
+    uint8_t checksum;
+  } __attribute__ ((packed)) mailbox_message_ext;
+
+  const size_t MESSAGE_SIZE = sizeof(mailbox_message);        // Message size (B)
+  const size_t MESSAGE_EXT_SIZE = sizeof(mailbox_message_ext); // Message size in extended protocol (B)
+  const size_t MESSAGE_FEC_SIZE = 2 * MESSAGE_EXT_SIZE;       // Max message size with forward error correction (B)
+
   class MailBoxMessage : public Printable {
       union {
         mailbox_message msg;                         // Message as structure
-        byte msg_buf[sizeof(msg)];                   // Message as buffer
+        mailbox_message_ext msg_ext;                 // Message as structure (extended protocol)
+        byte msg_buf[sizeof(msg_ext)];               // Message as buffer
       };
       bool print_raw;                                // True if messages should be printed as raw buffer instead of human-readable string
 
     protected:
       uint8_t checksum() const;                      // Calculate checksum
+      bool isExtended() const;                       // Return true if message uses extended protocol
 
     public:
       void init(const uint8_t /* rx_id */);          // Initialize the message
       void terminate();                              // Finalize the message
-      bool protocolVersionOK() const;                // Check protocol version
+      bool protocolVersionOK() const;                // Check protocol version (any supported)
       bool checksumOK() const;                       // Verify checksum
-      size_t getSize() const;                        // Return message size (B)
+      size_t getSize() const;                        // Return message size (B). Depends on protocol version
+      bool load(const byte* /* buf */, const size_t /* len */); // Load message from buffer. Returns false if length does not match protocol version
       void setByte(const uint8_t /* pos */, const byte /* value */); // Set individual byte in the message buffer
       byte& operator[](const uint8_t /* pos */);     // Set individual byte in the message buffer
       uint8_t getReceiverID() const;                 // Return receiver ID
@@ -107,6 +165,9 @@ namespace ds {
       const MailBoxMessage& asRaw();                 // Switch printing preference to raw
       size_t printTo(Print& /* log */) const;        // Print message into a log
       size_t send(Stream& /* tx */) const;           // Send message
+      size_t sendFEC(Stream& /* tx */) const;        // Send message with forward error correction
+      int8_t decodeFEC(const byte* /* buf */, const size_t /* len */); // Load message of given length from FEC-encoded buffer. Returns number of bits corrected or -1 if uncorrectable
+      static bool isFECEncoded(const byte* /* buf */, const size_t /* len */); // Return true if buffer consists of valid FEC codewords only
   };
 
 } // namespace ds
@@ -17,6 +17,15 @@
 //// Uncomment if you need Telegram interface
 //#define DS_SUPPORT_TELEGRAM
 
+//// For remote module, uncomment the line below to protect messages with CRC-8 instead of XOR checksum (protocol v3). Local module accepts both
+//#define DS_MAILBOX_PROTO_CRC8
+
+//// For remote module, uncomment the line below to use extended addressing with mailbox IDs up to 255 (protocol v4, CRC-8). Local module accepts all versions
+//#define DS_MAILBOX_PROTO_EXT
+
+//// For remote module, uncomment the line below to send messages with forward error correction (doubles message size). Local module accepts both
+//#define DS_MAILBOX_FEC
+
 #ifdef DS_MAILBOX_REMOTE
 
 // Remote module
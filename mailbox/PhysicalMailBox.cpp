@@ -9,12 +9,23 @@
 #ifdef DS_MAILBOX_REMOTE
 
 #include "PhysicalMailBox.h"
+#include <inttypes.h>           // PRIu32
 
 using namespace ds;
 
 static const uint8_t REED_OPEN = LOW;       // See schematic
-static const uint16_t VCC_REF_000 = 3625;   // ADC reference reading at 0% battery. These numbers have been measured experimentally and depend on battery type and schematic
-static const uint16_t VCC_REF_100 = 3925;   // ADC reference reading at 100% battery. Must be higher than VCC_REF_000
+
+// RTC memory layout (4 bytes slots). Memory survives firmware updates, so data are only trusted if the layout marker matches
+static const uint32_t RTC_LAYOUT = 0x444d5302;  // Layout marker ("DMS" + layout version). Change on any layout change
+enum {
+  RTC_LAYOUT_MARK,                          // Layout marker
+  RTC_MSG_NUM,                              // Last message number
+  RTC_BATTERY,                              // Battery level estimate (0.01%)
+  RTC_AWAKE_TIME_LAST,                      // Duration of the last wakeup (ms)
+  RTC_AWAKE_COUNT,                          // Number of wakeups since cold boot
+  RTC_AWAKE_TIME_TOTAL,                     // Total time spent awake since cold boot (ms)
+  RTC_SIZE
+};
 
 // Initialize mailbox
 void PhysicalMailBox::begin() {
@@ -23,18 +34,27 @@ void PhysicalMailBox::begin() {
   online = true;
 
   // On return from deep sleep, load data from persistent memory
+  uint32_t awake_time_last = 0;
   if (!boot) {
-    uint32_t rtc[2];
-    if (System::getRTCMem(rtc, 0, sizeof(rtc) / sizeof(uint32_t))) {
-      msg_num = rtc[0];
-      battery = rtc[1];
-    }
+    uint32_t rtc[RTC_SIZE];
+    if (System::getRTCMem(rtc, 0, RTC_SIZE) && rtc[RTC_LAYOUT_MARK] == RTC_LAYOUT) {
+      msg_num = rtc[RTC_MSG_NUM];
+      battery_estimator.setCP(rtc[RTC_BATTERY]);
+      battery = battery_estimator.getLevel();
+      awake_time_last = rtc[RTC_AWAKE_TIME_LAST];
+      awake_count = rtc[RTC_AWAKE_COUNT];
+      awake_time_total = rtc[RTC_AWAKE_TIME_TOTAL];
+    } else
+      System::log->printf("RTC memory layout mismatch; reinitializing... ");
   }
 
   pinMode(pin_door, INPUT);
   update();
   updateBattery();
   System::log->println("OK");
+  if (awake_count)
+    System::log->printf(TIMED("Previous wakeup lasted %" PRIu32 " ms; average %" PRIu32 " ms over %" PRIu32 " wakeup(s)\n"),
+      awake_time_last, awake_time_total / awake_count, awake_count);
 }
 
 // Update mailbox status
@@ -49,30 +69,9 @@ uint8_t PhysicalMailBox::updateBattery() {
 
   // Ignore readings during cold start, as there ESP starts with RF module on + cap charging, so measurements are very different
   if (!boot) {
-    auto vcc = ESP.getVcc();
-
-    // Normalize reading
-    if (vcc < VCC_REF_000)
-      vcc = VCC_REF_000;
-    else
-      if (vcc > VCC_REF_100)
-        vcc = VCC_REF_100;
-
-    const uint8_t battery_new = 100 * (vcc - VCC_REF_000) / (VCC_REF_100 - VCC_REF_000);
-    if (battery != BATTERY_LEVEL_UNKNOWN) {
-
-      // Vcc ADC has unstable readings, ranging +-20% in normal operation
-      // Mitigate this with simple averaging by giving new value some predefined weight
-      const int8_t diff = (battery_new - battery) / BATTERY_CHANGE_WEIGHT_COEFF;
-      if (battery + diff < 0)
-        battery = 0;
-      else
-        if (battery + diff > 100)
-          battery = 100;
-        else
-          battery += diff;
-    } else
-      battery = battery_new;   // New baseline
+    for (uint8_t i = 0; i < BatteryEstimator::VCC_SAMPLES; i++)
+      battery_estimator.addVcc(ESP.getVcc());
+    battery = battery_estimator.update();
   }
   return battery;
 }
@@ -80,10 +79,15 @@ uint8_t PhysicalMailBox::updateBattery() {
 // Put mailbox to sleep
 void PhysicalMailBox::sleep() const {
   System::log->printf(TIMED("Putting mailbox to sleep... "));
-  uint32_t rtc[2];
-  rtc[0] = msg_num;
-  rtc[1] = battery;
-  System::setRTCMem(rtc, 0, sizeof(rtc) / sizeof(uint32_t));
+  const uint32_t awake_time = millis();
+  uint32_t rtc[RTC_SIZE];
+  rtc[RTC_LAYOUT_MARK] = RTC_LAYOUT;
+  rtc[RTC_MSG_NUM] = msg_num;
+  rtc[RTC_BATTERY] = battery_estimator.getCP();
+  rtc[RTC_AWAKE_TIME_LAST] = awake_time;
+  rtc[RTC_AWAKE_COUNT] = awake_count + 1;
+  rtc[RTC_AWAKE_TIME_TOTAL] = awake_time_total + awake_time;
+  System::setRTCMem(rtc, 0, RTC_SIZE);
   System::log->println("OK");
 }
 
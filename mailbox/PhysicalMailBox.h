@@ -9,6 +9,7 @@
 
 #include "MailBox.h"               // Base class
 #include "MailBoxMessage.h"        // Mailbox message
+#include "BatteryEstimator.h"      // Battery level estimate
 
 namespace ds {
 
@@ -17,10 +18,13 @@ namespace ds {
 
     protected:
       const int pin_door;          // Door sensor pin
-    
+      BatteryEstimator battery_estimator; // Battery level estimate
+      uint32_t awake_count;        // Number of wakeups since cold boot
+      uint32_t awake_time_total;   // Total time spent awake since cold boot (ms)
+
     public:
       PhysicalMailBox(const uint8_t _id, const int _pin_door) :
-        MailBox(_id), pin_door(_pin_door) {}
+        MailBox(_id), pin_door(_pin_door), awake_count(0), awake_time_total(0) {}
       void begin();                // Initialize mailbox
       void update();               // Update mailbox status
       uint8_t updateBattery();     // Update and return battery level (%)
@@ -0,0 +1,126 @@
+/* DS mailbox automation
+ * * Local module
+ * * * Radio statistics implementation
+ * (c) DNS 2020-2023
+ */
+
+#include "MySystem.h"       // System-level definitions
+
+#ifndef DS_MAILBOX_REMOTE
+
+#include "RadioStats.h"
+
+using namespace ds;
+
+// Constructor
+RadioStats::RadioStats() {
+  reset();
+}
+
+// Clear statistics
+void RadioStats::reset() {
+  memset(frames, 0, sizeof(frames));
+  frames_pos = 0;
+  frames_len = 0;
+  memset(hours, 0, sizeof(hours));
+  hour_last = 0;
+  memset(days, 0, sizeof(days));
+  day_last = 0;
+}
+
+// Roll buckets forward to a given period
+//// Buckets of the periods passed without messages are cleared. If clock goes back, the newest bucket keeps accumulating
+void RadioStats::advance(bucket_t* buckets, const uint8_t size, uint32_t& last, const uint32_t now) {
+  if (now <= last)
+    return;
+  if (now - last >= size)
+    memset(buckets, 0, size * sizeof(bucket_t));
+  else
+    for (auto p = last + 1; p <= now; p++)
+      buckets[p % size] = {0, 0};
+  last = now;
+}
+
+// Account for messages in a bucket
+//// On saturation, both counters are halved, which keeps their ratio
+void RadioStats::count(bucket_t& bucket, const bool received, const uint16_t n) {
+  auto& counter = received ? bucket.recv : bucket.lost;
+  auto c = (uint16_t)counter + n;
+  while (c > UINT8_MAX) {
+    c /= 2;
+    if (received)
+      bucket.lost /= 2;
+    else
+      bucket.recv /= 2;
+  }
+  counter = c;
+}
+
+// Account for received or lost messages. Time windows are skipped if time is unknown (0)
+void RadioStats::add(const time_t t, const bool received, const uint16_t n) {
+  for (uint16_t i = 0; i < n && i < FRAMES; i++) {
+    if (received)
+      frames[frames_pos / 8] |= 1 << frames_pos % 8;
+    else
+      frames[frames_pos / 8] &= ~(1 << frames_pos % 8);
+    frames_pos = (frames_pos + 1) % FRAMES;
+    if (frames_len < FRAMES)
+      frames_len++;
+  }
+
+  if (t <= 0)
+    return;
+  const uint32_t hour = t / 3600;
+  advance(hours, HOURS, hour_last, hour);
+  count(hours[hour_last % HOURS], received, n);
+  const uint32_t day = t / 86400;
+  advance(days, DAYS, day_last, day);
+  count(days[day_last % DAYS], received, n);
+}
+
+// Return reliability over buckets (%)
+//// Only buckets falling into the window ending at the current period are counted, so old buckets expire even without messages
+int8_t RadioStats::getReliability(const bucket_t* buckets, const uint8_t size, const uint32_t last, const uint32_t now) {
+  if (!last)
+    return -1;
+  const auto newest = now > last ? now : last;
+  const auto hi = now < last ? now : last;
+  uint32_t recv = 0, total = 0;
+  for (uint8_t i = 0; i < size; i++) {
+    const auto p = newest - i;
+    if (p > hi)
+      continue;
+    recv += buckets[p % size].recv;
+    total += buckets[p % size].recv + buckets[p % size].lost;
+  }
+  return total ? 100 * recv / total : -1;
+}
+
+// Return reliability over a window (%). -1 == unknown
+int8_t RadioStats::getReliability(const window_t window, const time_t now) const {
+  switch (window) {
+    case WINDOW_FRAMES: {
+      if (!frames_len)
+        return -1;
+      uint8_t recv = 0;
+      for (const auto b : frames)
+        recv += __builtin_popcount(b);
+      return 100 * recv / frames_len;
+    }
+    case WINDOW_DAY:  return now > 0 ? getReliability(hours, HOURS, hour_last, now / 3600) : -1;
+    case WINDOW_WEEK: return now > 0 ? getReliability(days, DAYS, day_last, now / 86400) : -1;
+    default:          return -1;
+  }
+}
+
+// Return window name
+const char *RadioStats::getWindowStr(const window_t window) {
+  switch (window) {
+    case WINDOW_FRAMES: return PSTR("100 msg");
+    case WINDOW_DAY:    return PSTR("24 h");
+    case WINDOW_WEEK:   return PSTR("7 d");
+    default:            return PSTR("");
+  }
+}
+
+#endif // !DS_MAILBOX_REMOTE
@@ -0,0 +1,60 @@
+/* DS mailbox automation
+ * * Local module
+ * * * Radio statistics definition
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_RADIOSTATS_H_
+#define _DS_RADIOSTATS_H_
+
+#include <Arduino.h>                 // uint8_t, ...
+#include <time.h>                    // time_t
+
+namespace ds {
+
+  // Radio link reliability over sliding windows
+  //// Time windows are kept in buckets which are rolled forward as time passes; frame window is a bitmap. Memory is constant
+  class RadioStats {
+    public:
+      // Reliability windows
+      typedef enum {
+        WINDOW_FRAMES,                           // Last FRAMES messages
+        WINDOW_DAY,                              // Last HOURS hours
+        WINDOW_WEEK,                             // Last DAYS days
+        WINDOW_MAX                               // Number of windows
+      } window_t;
+
+      static const uint8_t FRAMES = 100;         // Size of frame window (messages)
+      static const uint8_t HOURS = 24;           // Size of day window (h)
+      static const uint8_t DAYS = 7;             // Size of week window (d)
+
+    private:
+      // Time bucket
+      typedef struct {
+        uint8_t recv;                            // Number of messages received
+        uint8_t lost;                            // Number of messages lost
+      } bucket_t;
+
+      uint8_t frames[(FRAMES + 7) / 8];          // Recent messages, 1 == received (ring buffer)
+      uint8_t frames_pos;                        // Position of the next message in the ring
+      uint8_t frames_len;                        // Number of messages in the ring
+      bucket_t hours[HOURS];                     // Hourly buckets, indexed by hour modulo HOURS
+      uint32_t hour_last;                        // Hour of the newest hourly bucket (h since epoch)
+      bucket_t days[DAYS];                       // Daily buckets, indexed by day modulo DAYS
+      uint32_t day_last;                         // Day of the newest daily bucket (d since epoch)
+
+      static void advance(bucket_t* /* buckets */, const uint8_t /* size */, uint32_t& /* last */, const uint32_t /* now */); // Roll buckets forward to a given period
+      static void count(bucket_t& /* bucket */, const bool /* received */, const uint16_t /* n */); // Account for messages in a bucket
+      static int8_t getReliability(const bucket_t* /* buckets */, const uint8_t /* size */, const uint32_t /* last */, const uint32_t /* now */); // Return reliability over buckets (%)
+
+    public:
+      RadioStats();                              // Constructor
+      void reset();                              // Clear statistics
+      void add(const time_t /* t */, const bool /* received */, const uint16_t n = 1); // Account for received or lost messages. Time windows are skipped if time is unknown (0)
+      int8_t getReliability(const window_t /* window */, const time_t /* now */) const; // Return reliability over a window (%). -1 == unknown
+      static const char *getWindowStr(const window_t /* window */); // Return window name
+  };
+
+} // namespace ds
+
+#endif // _DS_RADIOSTATS_H_
@@ -1,7 +1,7 @@
 /* DS mailbox automation
  * * Local module
  * * * Receiver implementation
- * (c) DNS 2020-2022
+ * (c) DNS 2020-2023
  */
 
 #include "MySystem.h"       // System log
@@ -40,11 +40,134 @@ void Receiver::reset() {
   t0 = millis();
   recv_in_progress = false;
   bytes_received = 0;
+  bytes_skipped = 0;
+  bytes_ignored = 0;
+}
+
+// Log the amount of input discarded while searching for a message
+void Receiver::logSkipped() const {
+  if (bytes_skipped) {
+    String lmsg = F("Invalid input: skipped ");
+    lmsg += bytes_skipped;
+    lmsg += F(" byte(s)");
+    System::appLogWriteLn(lmsg, true);
+  }
+}
+
+// Log the message for another receiver, if any, and forget it
+//// Such message is only logged once it is clear that it was not a part of a longer message for us
+void Receiver::logIgnored() {
+  if (bytes_ignored) {
+    String lmsg = F("Invalid message: wrong receiver: ");
+    lmsg += ignored_rx_id;
+    lmsg += F(" (expected ");
+    lmsg += RECEIVER_ID;
+    lmsg += F("), ignoring");
+    System::appLogWriteLn(lmsg, true);
+    bytes_ignored = 0;
+  }
+}
+
+// Put received message into the queue
+void Receiver::enqueue() {
+  if (queue_len == QUEUE_SIZE) {
+
+    // Client is not keeping up; sacrifice the oldest message, as the newest one carries the most recent status
+    StreamString lmsg;
+    lmsg = F("Receive queue overflow; dropping message: ");
+    lmsg.print(queue[queue_head].asIs());
+    System::appLogWriteLn(lmsg, true);
+    queue_head = (queue_head + 1) % QUEUE_SIZE;
+    queue_len--;
+  }
+  queue[(queue_head + queue_len) % QUEUE_SIZE] = msg;
+  queue_len++;
+}
+
+// Account for input bytes discarded while searching for a message
+void Receiver::skip(const uint8_t n) {
+  bytes_skipped = (uint32_t)bytes_skipped + n < UINT16_MAX ? bytes_skipped + n : UINT16_MAX;
+}
+
+// Try decoding a message of given length at the end of the window. Returns number of bits corrected or -1 if not found
+//// FEC-encoded message is tried first, as a plain message would be found in the tail of it. Frames of unsupported protocol
+//// versions are treated as noise; otherwise, runs of zeros (all-zero nibbles in FEC encoding) would pass as XOR-checksummed frames.
+//// Plain frame made of FEC codewords only is a piece of an FEC-encoded message in progress (e.g., the head of a v3 one may pass
+//// as a v4 frame), so it is not taken. "size" receives the number of window bytes taken by the message
+int8_t Receiver::tryMessage(const uint8_t len, uint8_t& size) {
+  if (bytes_received >= 2 * len) {
+    const auto bits_corrected = msg.decodeFEC(rx_window + bytes_received - 2 * len, len);
+    if (bits_corrected >= 0 && msg.protocolVersionOK() && msg.checksumOK()) {
+      size = 2 * len;
+      return bits_corrected;
+    }
+  }
+  if (bytes_received >= len && msg.load(rx_window + bytes_received - len, len) && msg.protocolVersionOK() && msg.checksumOK() &&
+    !MailBoxMessage::isFECEncoded(rx_window + bytes_received - len, len)) {
+    size = len;
+    return 0;
+  }
+  return -1;
+}
+
+// Process one incoming byte
+//// Input is kept in a sliding window, which is checked after every byte. This way, after corruption or loss of alignment,
+//// receiver locks onto the very next valid message instead of waiting for the timeout. The window is large enough to hold
+//// the longest FEC-encoded message; messages of all supported lengths are looked for at the end of the window
+void Receiver::receive(const byte b) {
+  t0 = millis();
+  recv_in_progress = true;
+  if (bytes_received == sizeof(rx_window)) {
+    memmove(rx_window, rx_window + 1, sizeof(rx_window) - 1);
+    bytes_received--;
+    if (bytes_ignored) {
+      if (bytes_ignored == 1)
+        logIgnored();
+      else
+        bytes_ignored--;
+    } else
+      skip(1);
+  }
+  rx_window[bytes_received++] = b;
+
+  uint8_t size;
+  auto bits_corrected = tryMessage(MESSAGE_SIZE, size);
+  if (bits_corrected < 0)
+    bits_corrected = tryMessage(MESSAGE_EXT_SIZE, size);
+  if (bits_corrected < 0)
+    return;        // Not aligned on a message (yet)
+
+  // Message for another receiver is not a reason to drop the window: a short message can show up inside a longer one in
+  // progress (e.g., inside an FEC-encoded one). So keep sliding, and do not count its bytes as noise
+  const uint8_t bytes_before = bytes_received - size;
+  const uint8_t bytes_noise = bytes_before > bytes_ignored ? bytes_before - bytes_ignored : 0;
+  if (bytes_before >= bytes_ignored)
+    logIgnored();            // Ignored message is not a part of this one
+  if (!receiverIDOK()) {
+    bytes_ignored = bytes_received;
+    ignored_rx_id = msg.getReceiverID();
+    return;
+  }
+
+  // Checksum matches; consider the window to be a message
+  skip(bytes_noise);
+  logSkipped();
+  StreamString lmsg;
+  lmsg = F("Received message: ");
+  lmsg.print(msg.asIs());
+  if (bits_corrected > 0) {
+    lmsg.print(F(" (FEC corrected "));
+    lmsg.print(bits_corrected);
+    lmsg.print(F(" bit(s))"));
+  }
+  System::log->printf(TIMED("%s\n"), lmsg.c_str());
+  enqueue();
+  reset();
 }
 
 // Handle incoming traffic
+//// This runs on every loop() pass, so the path with no input must stay cheap (no heap allocation)
 void Receiver::update() {
-  StreamString lmsg;
 
 #ifdef DS_DEVBOARD
   if (recv_message_emulated) {
@@ -59,72 +182,36 @@ void Receiver::update() {
     msg_emulated.setOnline(msg_emulated.getDoor());                   // Set online on open, offline on close
     msg_emulated.terminate();
     msg = msg_emulated;
-    recv_in_progress = false;
-    bytes_received = msg.getSize();
+    enqueue();
 
+    StreamString lmsg;
     lmsg = F("Received message: ");
     lmsg.print(msg.asIs());
     System::log->printf(TIMED("%s\n"), lmsg.c_str());
   }
 #else
-  while (serial.available() > 0 && bytes_received < msg.getSize()) {
 
-    if (!recv_in_progress) {
-      reset();
-      recv_in_progress = true;
-    }
-    const auto b = serial.read();      // Read 1 byte
-    if (b != -1)
-      msg[bytes_received++] = b;
-    else {
-      lmsg = F("Error reading input message after ");
-      lmsg += bytes_received;
-      lmsg += F(" byte(s)");
-      System::appLogWriteLn(lmsg, true);
-      break;
-    }
-
-    // Check integrity
-    if (bytes_received == 1 && (!msg.protocolVersionOK() || !receiverIDOK())) {
-      if (!msg.protocolVersionOK()) {
-        lmsg = F("Invalid message: wrong protocol version: ");
-        lmsg += msg.getProtocolVersion();
-        lmsg += F(" (expected ");
-        lmsg += PROTO_VERSION;
-        lmsg += F("), ignoring");
-      } else {
-        lmsg = F("Invalid message: wrong receiver: ");
-        lmsg += msg.getReceiverID();
-        lmsg += F(" (expected ");
-        lmsg += RECEIVER_ID;
-        lmsg += F("), ignoring");
-      }
-      System::appLogWriteLn(lmsg, true);
-      reset();
-    }
+  // Keep decoding as long as there is input, so that back-to-back messages do not pile up in UART buffer
+  int available;
+  while ((available = serial.available()) > 0) {
+    const auto len = serial.read(rx_buf, (size_t)available < sizeof(rx_buf) ? available : sizeof(rx_buf));
+    if (!len)
+      break;       // Should not happen as we read no more than available
+    for (size_t i = 0; i < len; i++)
+      receive(rx_buf[i]);
   }
 
-  if (recv_in_progress && bytes_received == msg.getSize()) {
-    recv_in_progress = false;
-    if (msg.checksumOK()) {
-      lmsg = F("Received message: ");
-      lmsg.print(msg.asIs());
-      System::log->printf(TIMED("%s\n"), lmsg.c_str());
-    } else {
-      lmsg = F("Invalid message: checksum mismatch; raw=");
-      lmsg.print(msg.asRaw());
-      reset();
+  // Line went silent with a partial message in the window; it will never complete
+  if (recv_in_progress && millis() - t0 > RF_TIMEOUT) {
+    const uint8_t bytes_incomplete = bytes_received - bytes_ignored;
+    logIgnored();
+    if (bytes_incomplete) {
+      String lmsg = F("Message timeout with ");
+      lmsg += bytes_incomplete;
+      lmsg += F(" byte(s) of incomplete input");
       System::appLogWriteLn(lmsg, true);
     }
-  }
-
-  if (recv_in_progress && millis() - t0 > RF_TIMEOUT) {
-    lmsg = F("Message timeout after receiving ");
-    lmsg += bytes_received;
-    lmsg += F("/");
-    lmsg += msg.getSize();
-    lmsg += F(" bytes");
-    System::appLogWriteLn(lmsg, true);
+    logSkipped();
     reset();
   }
 #endif // DS_DEVBOARD
@@ -132,14 +219,17 @@ void Receiver::update() {
 
 // Check if message is available for the client
 bool Receiver::messageAvailable() const {
-  return !recv_in_progress && bytes_received == msg.getSize();
+  return queue_len;
 }
 
-// Fetch the message, optionally deferring rearm for listening for a new message
-MailBoxMessage Receiver::getMessage(const bool and_reset) {
-  if (and_reset)
-    reset();
-  return msg;
+// Fetch the oldest message from the queue
+MailBoxMessage Receiver::getMessage() {
+  if (!queue_len)
+    return msg;       // Should not happen if client checks messageAvailable() first
+  const auto pos = queue_head;
+  queue_head = (queue_head + 1) % QUEUE_SIZE;
+  queue_len--;
+  return queue[pos];
 }
 
 #endif // !DS_MAILBOX_REMOTE
@@ -13,18 +13,36 @@
 namespace ds {
 
   class Receiver : public Transceiver {
-      unsigned long t0;              // Time of first byte retrieval (ms from boot)
+      static const uint8_t QUEUE_SIZE = 4;   // Max number of received messages waiting for the client
+      static const uint8_t RX_BUFFER_SIZE = 32; // Input chunk size (B)
+
+      unsigned long t0;              // Time of last byte retrieval (ms from boot)
       bool recv_in_progress;         // Flag indicating that receiving is in progress
-      uint8_t bytes_received;        // Number of bytes received
+      byte rx_window[MESSAGE_FEC_SIZE]; // Sliding window over the input stream
+      uint8_t bytes_received;        // Number of bytes in the window
+      uint16_t bytes_skipped;        // Number of bytes discarded while searching for a valid message
+      uint8_t bytes_ignored;         // Number of bytes at the window start taken by a message for another receiver
+      uint8_t ignored_rx_id;         // Receiver ID of the ignored message
+      MailBoxMessage queue[QUEUE_SIZE]; // Received messages waiting for the client (ring buffer)
+      uint8_t queue_head;            // Position of the oldest message in the queue
+      uint8_t queue_len;             // Number of messages in the queue
+      byte rx_buf[RX_BUFFER_SIZE];   // Input buffer for bulk reading
+
+      void receive(const byte /* b */); // Process one incoming byte
+      int8_t tryMessage(const uint8_t /* len */, uint8_t& /* size */); // Try decoding a message of given length at the end of the window. Returns number of bits corrected or -1 if not found
+      void skip(const uint8_t /* n */); // Account for input bytes discarded while searching for a message
+      void logSkipped() const;       // Log the amount of input discarded while searching for a message
+      void logIgnored();             // Log the message for another receiver, if any, and forget it
+      void enqueue();                // Put received message into the queue
 
     public:
       Receiver(HardwareSerial &_serial = Serial, const uint8_t _tx_id = 0) :
-        Transceiver(_serial, _tx_id), t0(0), recv_in_progress(false), bytes_received(0) {}
+        Transceiver(_serial, _tx_id), t0(0), recv_in_progress(false), bytes_received(0), bytes_skipped(0), bytes_ignored(0), ignored_rx_id(0), queue_head(0), queue_len(0) {}
       void begin();                  // Receiver initialization
       void reset();                  // Reset pending transfer, if any
       void update();                 // Handle incoming traffic
       bool messageAvailable() const; // Check if message is available for the client
-      MailBoxMessage getMessage(const bool and_reset = true); // Fetch the message, optionally deferring rearm for listening for a new message
+      MailBoxMessage getMessage();   // Fetch the oldest message from the queue
   };
 
 } // namespace ds
@@ -30,16 +30,15 @@ Telegram::Telegram(): bot(token, client), timer("poll TG", POLL_INTERVAL),
     active(false), boot_reported(false), bounce_reported(false) {
   client.setInsecure();    // See https://github.com/witnessmenow/Universal-Arduino-Telegram-Bot/issues/118
   timer.disarm();          // Default is armed
-  System::timers.push_front(&timer);  // Register the timer
+  timer.setCallback([](const Timer*, void *tg) { static_cast<Telegram *>(tg)->update(); }, this);
+  System::addTimer(&timer);  // Register the timer
 
 }
 
 // Destructor
 Telegram::~Telegram() {
 
-  // Unregister the timer. Should be reviewed after fix https://github.com/denis-stepanov/esp-ds-system/issues/62
-  const auto tref = &timer;
-  System::timers.remove_if([tref](TimerAbsolute *t) {return t == tref;});
+  System::removeTimer(&timer); // Unregister the timer
 }
 
 // Return bot token
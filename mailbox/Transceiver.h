@@ -18,6 +18,7 @@ namespace ds {
       const uint8_t RECEIVER_ID = 1;             // Receiver ID
       const unsigned int RF_SPEED = 1200;        // RF comminucation speed (bod). Depends on communication mode selected in "rfconf" sketch
       const unsigned int RF_TIMEOUT = 2000;      // Message receiving timeout (ms). Depends on communication mode chosen in "rfconf" sketch
+      const unsigned int RF_PACKET_INTERVAL = 2000; // Minimal interval between packets (ms). Depends on communication mode chosen in "rfconf" sketch
 
       HardwareSerial &serial;                    // Communication interface
       const uint8_t tx_id;                       // Transmitter ID (0 for any)
@@ -1,7 +1,7 @@
 /* DS mailbox automation
  * * Remote module
  * * * Transmitter implementation
- * * * Hardcoded delays largely depend on communication mode selected in "rfconf" sketch
+ * * * Delays largely depend on communication mode selected in "rfconf" sketch
  * (c) DNS 2020
  */
 
@@ -26,29 +26,51 @@ void Transmitter::begin() {
   System::log->println("OK");
 }
 
+// Return time for a packet to leave the module once on serial line (ms)
+unsigned int Transmitter::getTransmitTime(const size_t len) const {
+  return RF_LATENCY + (len * 8 * 1000 + RF_AIR_SPEED - 1) / RF_AIR_SPEED;
+}
+
 // Put transmitter to sleep mode
+//// Module falls asleep upon leaving command mode; no need to wait for that, as it does not depend on us anymore
 void Transmitter::sleep() const {
   System::log->printf(TIMED("Putting transmitter to sleep\n"));
   digitalWrite(pin_set, LOW);
-  delay(250);
+  delay(RF_CMD_ENTER_DELAY);
   serial.println("AT+SLEEP");
-  delay(250);
+  serial.flush();
+  delay(RF_CMD_EXEC_DELAY);
   digitalWrite(pin_set, HIGH);
 }
 
-// Wake the transmitter up
-void Transmitter::wakeup() const {
+// Start waking the transmitter up. Returns immediately; module settles in background
+//// Pulsing SET makes the module leave sleep through command mode. Settling takes a while, which the caller can use for other work
+void Transmitter::wakeup() {
   System::log->printf(TIMED("Waking transmitter up\n"));
   digitalWrite(pin_set, LOW);
-  delay(10);
+  delay(RF_WAKEUP_PULSE);
   digitalWrite(pin_set, HIGH);
-  delay(400);
+  t_wakeup = millis();
+  waking_up = true;
+}
+
+// Wait until transmitter is ready after wakeup
+void Transmitter::waitReady() {
+  if (!waking_up)
+    return;
+  const auto elapsed = millis() - t_wakeup;
+  const unsigned long wait = elapsed < RF_CMD_EXIT_DELAY ? RF_CMD_EXIT_DELAY - elapsed : 0;
+  delay(wait);
+  waking_up = false;
+  System::log->printf(TIMED("Transmitter ready; %lu ms of settling time used for other tasks, %lu ms waited\n"),
+    elapsed < RF_CMD_EXIT_DELAY ? elapsed : RF_CMD_EXIT_DELAY, wait);
 }
 
 // Send mailbox status
 void Transmitter::send(MailBox &mb) {
 
   // Prepare
+  waitReady();
   auto msg_num = mb.getMessageNumber();
   mb.setMessageNumber(msg.getNextMessageNumber(msg_num));
   mb.incrementMessageCount();
@@ -58,14 +80,30 @@ void Transmitter::send(MailBox &mb) {
   msg.terminate();
 
   // Send
-  msg.send(serial);
+  //// Link is one-way, so the only way to fight losses is to send several copies. Receiver drops duplicates by message number.
+  //// Copies are spread in time with random gaps to avoid systematic collisions with other transmitters or interference
+  size_t len = 0;
+  for (uint8_t i = 0; i < repeats; i++) {
+    if (i)
+      delay(RF_PACKET_INTERVAL + random(RF_PACKET_JITTER));
+#ifdef DS_MAILBOX_FEC
+    len = msg.sendFEC(serial);
+#else
+    len = msg.send(serial);
+#endif // DS_MAILBOX_FEC
+  }
   System::log->printf(TIMED("Sending "));
+  if (repeats > 1)
+    System::log->printf("%hhu copies of ", repeats);
   System::log->print("message: ");
   System::log->print(msg.asIs());
   System::log->print("; raw=");
   System::log->print(msg.asRaw());
   System::log->println();
-  delay(1500);   // Make sure this is fully transmitted, before doing anything else
+
+  // Make sure this is fully transmitted, before doing anything else
+  serial.flush();             // Wait for UART to drain
+  delay(getTransmitTime(len));
 }
 
 // Operator to send maibox status
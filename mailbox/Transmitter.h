@@ -13,14 +13,34 @@
 namespace ds {
   
   class Transmitter : public Transceiver {
+      const unsigned int RF_PACKET_JITTER = 500; // Maximal random addition to interval between message copies (ms)
+
+      // HC-12 timings (ms). Link figures are taken from HC-12 datasheet for the communication mode selected in "rfconf" sketch (FU4).
+      // Command mode delays are the values proven in the field; datasheet figures (40/40/80 ms) have not been verified on hardware
+      const unsigned int RF_AIR_SPEED = 500;     // Over-the-air data rate (bps)
+      const unsigned int RF_LATENCY = 1000;      // Delay between packet reception on serial line and the end of its emission, excluding air time
+      const unsigned int RF_WAKEUP_PULSE = 10;   // Duration of SET pulse to wake module up
+      const unsigned int RF_CMD_ENTER_DELAY = 250; // Time to enter command mode after SET goes low
+      const unsigned int RF_CMD_EXEC_DELAY = 250;  // Time to execute a command once it has been received
+      const unsigned int RF_CMD_EXIT_DELAY = 400;  // Time to return to transparent mode after SET goes high
+
+      unsigned int getTransmitTime(const size_t /* len */) const; // Return time for a packet to leave the module once on serial line (ms)
+
       const int pin_set;                   // Transmitter control pin
+      const uint8_t repeats;               // Number of times each message is sent
+      unsigned long t_wakeup;              // Time when wakeup was initiated (ms from boot)
+      bool waking_up;                      // True if module has been woken up but not yet confirmed ready
 
     public:
-      Transmitter(HardwareSerial &_serial = Serial, const uint8_t _tx_id = 1, const int _pin_set = 0) :
-        Transceiver(_serial, _tx_id), pin_set(_pin_set) {}
+      static const uint8_t REPEATS_MAX = 4;  // Maximal number of times each message can be sent
+
+      Transmitter(HardwareSerial &_serial = Serial, const uint8_t _tx_id = 1, const int _pin_set = 0, const uint8_t _repeats = 1) :
+        Transceiver(_serial, _tx_id), pin_set(_pin_set), repeats(_repeats < 1 ? 1 : _repeats > REPEATS_MAX ? REPEATS_MAX : _repeats),
+        t_wakeup(0), waking_up(false) {}
       void begin();                        // Initialize transmitter
       void sleep() const;                  // Put transmitter to sleep mode
-      void wakeup() const;                 // Wake the transmitter up
+      void wakeup();                       // Start waking the transmitter up. Returns immediately; module settles in background
+      void waitReady();                    // Wait until transmitter is ready after wakeup
       void send(MailBox& /* mb */);        // Send mailbox status
   }; 
 
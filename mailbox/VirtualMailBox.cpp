@@ -11,38 +11,57 @@
 #include "VirtualMailBox.h"
 #include "MailBoxManager.h"   // Mailbox manager
 #include "GoogleAssistant.h"  // Google interface
+#include "MailBoxDB.h"        // Mailbox database
 #ifdef DS_SUPPORT_TELEGRAM
 #include "Telegram.h"         // Telegram interface
 #endif // DS_SUPPORT_TELEGRAM
+#include "WebEvents.h"        // Web events
 
 using namespace ds;
 
 extern MailBoxManager mailbox_manager;      // Mailbox manager instance
+extern MailBoxDB mailbox_db;                // Mailbox database
 extern GoogleAssistant google_assistant;    // Google interface
 #ifdef DS_SUPPORT_TELEGRAM
 extern Telegram telegram;                   // Telegram interface
 #endif // DS_SUPPORT_TELEGRAM
+extern WebEvents web_events;                // Web events
 
-static const char *FILE_PREFIX PROGMEM = "/mailbox"; // Configuration file prefix
-static const char *FILE_EXT PROGMEM = ".cfg";        // Configuration file extension
+static const char *FILE_PREFIX PROGMEM = "/mailbox"; // Legacy configuration file prefix
+static const char *FILE_EXT PROGMEM = ".cfg";        // Legacy configuration file extension
 
 // Constructor
 VirtualMailBox::VirtualMailBox(const uint8_t _id, const String _label, const uint8_t _battery, const time_t _last_seen, const time_t _last_boot) :
-  MailBox(_id, _label, _battery), last_seen(_last_seen), last_boot(_last_boot), msg_recv(0), alarm(ALARM_NONE),
-  timer(String("signal absent msg for mb_id=") + _id, (AWAKE_TIME + 5000 /* slack 5s */) / 1000.0),
-  g_opening_reported(false), low_battery_reported(false) {
+  MailBox(_id, _label, _battery), last_seen(_last_seen), last_boot(_last_boot), alarm(ALARM_NONE),
+  timer("mb absent", (AWAKE_TIME + 5000 /* slack 5s */) / 1000.0),
+  g_opening_reported(false), low_battery_reported(false), event_history(_id), updates_pending(0), t_dirty(0) {
 
   timer.disarm();          // Default is armed
   timer.repeatOnce();      // Default is recurrent
-  System::timers.push_front(&timer); // Register the timer
+  timer.setCallback([](const Timer*, void *mb) { static_cast<VirtualMailBox *>(mb)->timeout(); }, this);
+  System::addTimer(&timer); // Register the timer
 }
 
 // Destructor
 VirtualMailBox::~VirtualMailBox() {
 
-  // Unregister the timer. Should be reviewed after fix https://github.com/denis-stepanov/esp-ds-system/issues/62
-  const auto tref = &timer;
-  System::timers.remove_if([tref](TimerAbsolute *t) {return t == tref;});
+  System::removeTimer(&timer); // Unregister the timer
+}
+
+// Set mailbox label (truncated to LABEL_LENGTH_MAX)
+void VirtualMailBox::setLabel(const String& new_label) {
+  if (new_label.length() <= LABEL_LENGTH_MAX)
+    MailBox::setLabel(new_label);
+  else {
+
+    // Do not cut UTF-8 character in the middle
+    auto len = LABEL_LENGTH_MAX;
+    while (len && (new_label[len] & 0xc0) == 0x80)
+      len--;
+    MailBox::setLabel(new_label.substring(0, len));
+  }
+  mailbox_manager.markChanged();
+  web_events.publish(*this);
 }
 
 // Return the last report time
@@ -96,9 +115,48 @@ String VirtualMailBox::getUptimeStr() const {
   return up_str;
 }
 
-// Return radio link reliability (%). -1 == unknown
-int8_t VirtualMailBox::getRadioReliability() const {
-  return msg_count ? 100 * msg_recv / msg_count : -1;
+// Return radio link reliability over a window (%). -1 == unknown
+int8_t VirtualMailBox::getRadioReliability(const RadioStats::window_t window) const {
+  return radio_stats.getReliability(window, System::getTimeSyncStatus() != TIME_SYNC_NONE ? System::getTime() : 0);
+}
+
+// Print radio link reliability over all windows
+//// Unknown values are printed as dashes, so that the columns stay recognizable
+void VirtualMailBox::printRadioReliability(String& buf, const bool html) const {
+  for (uint8_t w = 0; w < RadioStats::WINDOW_MAX; w++) {
+    const auto rr = getRadioReliability((RadioStats::window_t)w);
+    if (w)
+      buf += F(" / ");
+    if (rr == -1) {
+      buf += F("-");
+      continue;
+    }
+    if (rr <= RADIO_RELIABILITY_BAD)
+      buf += html ? F("<span class=\"alarm\">") : F("*");   // * = markdown 'bold'
+    buf += rr;
+    buf += F("%");
+    if (rr <= RADIO_RELIABILITY_BAD)
+      buf += html ? F("</span>") : F("*");
+  }
+  if (!html) {
+    buf += F(" (");
+    for (uint8_t w = 0; w < RadioStats::WINDOW_MAX; w++) {
+      if (w)
+        buf += F(" / ");
+      buf += FPSTR(RadioStats::getWindowStr((RadioStats::window_t)w));
+    }
+    buf += F(")");
+  }
+}
+
+// Return predicted battery time to empty (d). BatteryHistory::DAYS_LEFT_UNKNOWN == unknown
+uint16_t VirtualMailBox::getBatteryDaysLeft() const {
+  return battery == BATTERY_LEVEL_UNKNOWN ? BatteryHistory::DAYS_LEFT_UNKNOWN : battery_history.getDaysLeft(battery);
+}
+
+// Return event history
+EventHistory& VirtualMailBox::getEventHistory() {
+  return event_history;
 }
 
 // Return mailbox alarm
@@ -154,14 +212,23 @@ String VirtualMailBox::getAlarmIcon(const mailbox_alarm a) {
   return icon;
 }
 
+// Set mailbox alarm, notifying mailbox manager on change
+void VirtualMailBox::setAlarm(const mailbox_alarm new_alarm) {
+  if (new_alarm == alarm)
+    return;
+  const auto old_alarm = alarm;
+  alarm = new_alarm;
+  mailbox_manager.onAlarmChange(*this, old_alarm, new_alarm);
+}
+
 // Update mailbox alarm
 void VirtualMailBox::updateAlarm() {
-  alarm = boot ? ALARM_BOOTED : (door ? (alarm == ALARM_DOOR_OPEN ? ALARM_DOOR_LEFTOPEN : ALARM_DOOR_OPEN) : ALARM_DOOR_FLIPPED);
+  setAlarm(boot ? ALARM_BOOTED : (door ? (alarm == ALARM_DOOR_OPEN ? ALARM_DOOR_LEFTOPEN : ALARM_DOOR_OPEN) : ALARM_DOOR_FLIPPED));
 }
 
 // Reset mailbox alarm
 void VirtualMailBox::resetAlarm() {
-  alarm = ALARM_NONE;
+  setAlarm(ALARM_NONE);
   low_battery_reported = false;
 }
 
@@ -173,7 +240,7 @@ bool VirtualMailBox::isOK() {
   if (last_seen && alarm != ALARM_ABSENT && System::getTimeSyncStatus() != TIME_SYNC_NONE &&
        (unsigned long)(System::getTime() - last_seen) >= ABSENCE_TIME) {
     is_ok = false;
-    alarm = ALARM_ABSENT;    // Override possible stale higher level alarm
+    setAlarm(ALARM_ABSENT);  // Override possible stale higher level alarm
     String lmsg = F("Marking mailbox ");
     lmsg += getName();
     lmsg += F(" as absent");
@@ -186,7 +253,7 @@ bool VirtualMailBox::isOK() {
   // Check is mailbox is low on battery
   if (alarm < ALARM_BATTERY && getBattery() <= BATTERY_LEVEL_LOW) {
     is_ok = false;
-    alarm = ALARM_BATTERY;
+    setAlarm(ALARM_BATTERY);
   }
 
   if (getBattery() <= BATTERY_LEVEL_LOW && !low_battery_reported) {
@@ -204,55 +271,129 @@ bool VirtualMailBox::isOK() {
 }
 
 // Print mailbox status in HTML
-void VirtualMailBox::printHTML(String& buf) const {
-  buf += F("<tr><td><a href=\"/mailbox?id=");
-  buf += id;
-  buf += F("\">");
-  buf += id;
-  buf += F("</a></td><td>");
-  buf += label;
-  buf += F("</td><td>");
-  buf += getAlarmIcon();
-  buf += F(" ");
-  buf += getAlarmStr(true);
-  buf += F("</td><td>");
+void VirtualMailBox::printHTML(Print& buf) const {
+  buf.print(F("<tr id=\"mb"));
+  buf.print(id);
+  buf.print(F("\"><td><a href=\"/mailbox?id="));
+  buf.print(id);
+  buf.print(F("\">"));
+  buf.print(id);
+  buf.print(F("</a></td><td>"));
+  buf.print(label);
+  buf.print(F("</td><td>"));
+  buf.print(getAlarmIcon());
+  buf.print(F(" "));
+  buf.print(getAlarmStr(true));
+  buf.print(F("</td><td>"));
   const auto bl = getBattery();
   if (bl != BATTERY_LEVEL_UNKNOWN) {
     if (bl <= BATTERY_LEVEL_LOW)
-      buf += F("<span class=\"alarm\">");
-    buf += bl;
-    buf += F("%");
+      buf.print(F("<span class=\"alarm\">"));
+    buf.print(bl);
+    buf.print(F("%"));
     if (bl <= BATTERY_LEVEL_LOW)
-      buf += F("</span>");
+      buf.print(F("</span>"));
   }
-  buf += F("</td><td>");
-  const auto rr = getRadioReliability();
-  if (rr != -1) {
-    if (rr <= RADIO_RELIABILITY_BAD)
-      buf += F("<span class=\"alarm\">");
-    buf += rr;
-    buf += F("%");
-    if (rr <= RADIO_RELIABILITY_BAD)
-      buf += F("</span>");
+  buf.print(F("</td><td>"));
+  const auto dl = getBatteryDaysLeft();
+  if (dl != BatteryHistory::DAYS_LEFT_UNKNOWN) {
+    buf.print(dl);
+    buf.print(F(" d"));
+  }
+  buf.print(F("</td><td>"));
+  if (getRadioReliability() != -1) {
+    String rr;
+    printRadioReliability(rr, true);
+    buf.print(rr);
   }
-  buf += F("</td><td>");
+  buf.print(F("</td><td>"));
   char time_str[19];
   strftime(time_str, sizeof(time_str), "%a %d-%b %H:%M", localtime(&last_seen));
   auto t = System::getTime();
   if (t && last_seen && (unsigned long)(t - last_seen) >= ABSENCE_TIME)
-    buf += F("<span class=\"alarm\">");
-  buf += time_str;
+    buf.print(F("<span class=\"alarm\">"));
+  buf.print(time_str);
   if (t && last_seen && (unsigned long)(t - last_seen) >= ABSENCE_TIME)
-    buf += F("</span>");
-  buf += F("</td><td>");
+    buf.print(F("</span>"));
+  buf.print(F("</td><td>"));
   if (t && last_boot)
-    buf += getUptimeStr();
-  buf += F("</td><td><form action=\"/ack\"><input type=\"hidden\" name=\"id\" value=\"");
-  buf += id;
-  buf += F("\"/><input type=\"submit\" value=\"Ack\"");
+    buf.print(getUptimeStr());
+  buf.print(F("</td><td><form action=\"/ack\"><input type=\"hidden\" name=\"id\" value=\""));
+  buf.print(id);
+  buf.print(F("\"/><input type=\"submit\" value=\"Ack\""));
   if (alarm == ALARM_NONE)
-    buf += F(" disabled=\"true\"");
-  buf += F("/></form></td></tr>\n");
+    buf.print(F(" disabled=\"true\""));
+  buf.print(F("/></form></td></tr>\n"));
+}
+
+// Print string as JSON string literal
+void VirtualMailBox::printJSONString(Print& out, const String& str) {
+  out.print('"');
+  for (unsigned int i = 0; i < str.length(); i++) {
+    const char c = str[i];
+    if (c == '"' || c == '\\') {
+      out.print('\\');
+      out.print(c);
+    } else
+    if ((uint8_t)c < 0x20) {
+      char esc[7];
+      snprintf(esc, sizeof(esc), "\\u%04x", c);
+      out.print(esc);
+    } else
+      out.print(c);
+  }
+  out.print('"');
+}
+
+// Print mailbox status in JSON
+//// Unknown values are printed as null
+void VirtualMailBox::printJSON(Print& out) const {
+  out.print(F("{\"id\":"));
+  out.print(id);
+  out.print(F(",\"label\":"));
+  printJSONString(out, label);
+  out.print(F(",\"alarm\":"));
+  out.print((int)alarm);
+  out.print(F(",\"alarm_str\":"));
+  printJSONString(out, getAlarmStr());
+  out.print(F(",\"alarm_icon\":\""));
+  out.print(getAlarmIcon());
+  out.print('"');
+  out.print(F(",\"door\":"));
+  out.print(door ? F("\"open\"") : F("\"closed\""));
+  out.print(F(",\"battery\":"));
+  const auto bl = getBattery();
+  if (bl != BATTERY_LEVEL_UNKNOWN)
+    out.print(bl);
+  else
+    out.print(F("null"));
+  out.print(F(",\"battery_days_left\":"));
+  const auto dl = getBatteryDaysLeft();
+  if (dl != BatteryHistory::DAYS_LEFT_UNKNOWN)
+    out.print((unsigned int)dl);
+  else
+    out.print(F("null"));
+  out.print(F(",\"radio_reliability\":["));
+  for (uint8_t w = 0; w < RadioStats::WINDOW_MAX; w++) {
+    if (w)
+      out.print(',');
+    const auto rr = getRadioReliability((RadioStats::window_t)w);
+    if (rr != -1)
+      out.print((int)rr);
+    else
+      out.print(F("null"));
+  }
+  out.print(F("],\"last_seen\":"));
+  if (last_seen)
+    out.print((long)last_seen);
+  else
+    out.print(F("null"));
+  out.print(F(",\"last_boot\":"));
+  if (last_boot)
+    out.print((long)last_boot);
+  else
+    out.print(F("null"));
+  out.print('}');
 }
 
 // Print mailbox status in text
@@ -272,16 +413,16 @@ void VirtualMailBox::printText(String& buf) const {
     buf += F("%");
     if (bl <= BATTERY_LEVEL_LOW)
       buf += F("*");
+    const auto dl = getBatteryDaysLeft();
+    if (dl != BatteryHistory::DAYS_LEFT_UNKNOWN) {
+      buf += F(" (\xe2\x8f\xb3 ");  // UTF-8 'HOURGLASS WITH FLOWING SAND'
+      buf += dl;
+      buf += F(" d)");
+    }
   }
-  const auto rr = getRadioReliability();
-  if (rr != -1) {
+  if (getRadioReliability() != -1) {
     buf += F(", \xf0\x9f\x93\xb6 ");   // UTF-8 'ANTENNA WITH BARS'
-    if (rr <= RADIO_RELIABILITY_BAD)
-      buf += F("*");
-    buf += rr;
-    buf += F("%");
-    if (rr <= RADIO_RELIABILITY_BAD)
-      buf += F("*");
+    printRadioReliability(buf, false);
   }
   buf += F(", \xf0\x9f\x95\x97 ");     // UTF-8 'CLOCK FACE EIGHT OCLOCK'
   char time_str[19];
@@ -308,50 +449,87 @@ void VirtualMailBox::printTelegramKeyboard(String& buf) const {
 }
 #endif // DS_SUPPORT_TELEGRAM
 
-// Return configuration file name (static version)
-String VirtualMailBox::getConfFileName(const uint8_t id) {
+// Return legacy configuration file name
+String VirtualMailBox::getLegacyFileName(const uint8_t id) {
   String file_name = FILE_PREFIX;
   file_name += id;
   file_name += FILE_EXT;
   return file_name;
 }
 
-// Return configuration file name
-String VirtualMailBox::getConfFileName() const {
-  return getConfFileName(id);
+// Mark mailbox as having unsaved updates
+//// Every update is also a change of state visible via API, even if it does not change the alarm
+void VirtualMailBox::markDirty() {
+  if (!updates_pending)
+    t_dirty = millis();
+  if (updates_pending < UINT16_MAX)
+    updates_pending++;
+  mailbox_manager.markChanged();
 }
 
 // Save mailbox information to disk
-void VirtualMailBox::save() const {
-  auto file = System::fs.open(getConfFileName(), "w");
-  if (!file) {
+void VirtualMailBox::save() {
+  mailbox_record_t rec;
+  memset(&rec, 0, sizeof(rec));
+  rec.id = id;
+  rec.battery = battery;
+  strncpy(rec.label, label.c_str(), LABEL_LENGTH_MAX);
+  rec.last_seen = last_seen;
+  rec.last_boot = last_boot;
+  battery_history.save(rec.battery_history);
+  event_history.flush();
+  if (!mailbox_db.save(rec)) {
     System::log->printf(TIMED("Error saving configuration for mailbox=%hhu\n"), id);
     return;
   }
-  file.println(label);
-  file.println(last_seen);
-  file.println(battery);
-  file.println(last_boot);
-  file.close();
+  updates_pending = 0;
+}
+
+// Save mailbox information to disk if there are updates pending long enough
+//// Saving on every message would put a flash write on the receiving path and wear the flash, so updates are coalesced
+bool VirtualMailBox::saveIfDue(const bool force) {
+  if (!updates_pending || (!force && millis() - t_dirty < SAVE_DELAY))
+    return false;
+  System::log->printf(TIMED("Saving mailbox %hhu (%hu update(s) coalesced)\n"), id, updates_pending);
+  save();
+  return true;
+}
+
+// Initialize mailbox with database record
+void VirtualMailBox::load(mailbox_record_t& rec) {
+  rec.label[LABEL_LENGTH_MAX] = '\0';
+  label = rec.label;
+  battery = rec.battery;
+  last_seen = rec.last_seen;
+  last_boot = rec.last_boot;
+  battery_history.load(rec.battery_history);
 }
 
-// Initialize mailbox with information on disk
-VirtualMailBox *VirtualMailBox::load(const uint8_t id) {
-  auto file = System::fs.open(getConfFileName(id), "r");
+// Initialize mailbox with information in legacy per-mailbox file. Returns false if not found
+bool VirtualMailBox::loadLegacy() {
+  auto file = System::fs.open(getLegacyFileName(id), "r");
   if (!file)
-    return nullptr;
-  auto label = file.readStringUntil('\n');
-  label.trim();
-  time_t last_seen = file.parseInt();
-  uint8_t battery = file.parseInt();
-  time_t last_boot = file.parseInt();
+    return false;
+  auto new_label = file.readStringUntil('\n');
+  new_label.trim();
+  setLabel(new_label);
+  last_seen = file.parseInt();
+  battery = file.parseInt();
+  last_boot = file.parseInt();
+  battery_history.loadText(file);
   file.close();
-  return new VirtualMailBox(id, label, battery, last_seen, last_boot);
+  return true;
+}
+
+// Remove mailbox information in legacy per-mailbox file
+void VirtualMailBox::forgetLegacy(const uint8_t id) {
+  System::fs.remove(getLegacyFileName(id));
 }
 
 // Remove mailbox information from disk
 bool VirtualMailBox::forget(const uint8_t id) {
-  return System::fs.remove(getConfFileName(id));
+  EventHistory::forget(id);
+  return mailbox_db.erase(id);
 }
 
 // Update mailbox from message data
@@ -365,12 +543,14 @@ VirtualMailBox& VirtualMailBox::operator=(const MailBoxMessage& msg) {
   auto counter_desync = false;
   const auto remote_time = msg.getTime();
   const auto msg_num_new = msg.getMessageNumber();
+  const auto t = System::getTimeSyncStatus() != TIME_SYNC_NONE ? System::getTime() : 0;
   if (msg_num_cur != MESSAGE_NUMBER_UNKNOWN && !msg.getBoot()) {
     MailBoxMessage::getNextMessageNumber(msg_num_cur);
     msg_lost = msg_num_new - msg_num_cur;   // Overflow-safe
     if (msg_lost <= LOST_MESSAGE_MAX) {
       msg_count += msg_lost;
       if (msg_lost) {
+        radio_stats.add(t, false, msg_lost);
         lmsg = F("Lost ");
         lmsg += msg_lost;
         lmsg += F(" message(s)!");
@@ -385,7 +565,7 @@ VirtualMailBox& VirtualMailBox::operator=(const MailBoxMessage& msg) {
 
   // Update mailbox fields
   msg_count++;
-  msg_recv++;
+  radio_stats.add(t, true);
   setLastSeen();
   msg_num = msg_num_new;
   online = msg.getOnline();
@@ -405,10 +585,18 @@ VirtualMailBox& VirtualMailBox::operator=(const MailBoxMessage& msg) {
     ) {
     setLastBoot(System::time - remote_time / 1000);
   }
-  if (battery_new != BATTERY_LEVEL_UNKNOWN)
+  if (battery_new != BATTERY_LEVEL_UNKNOWN) {
+
+    //// Battery replacement invalidates discharge history
+    if (battery != BATTERY_LEVEL_UNKNOWN && battery_new - battery >= 100 / BATTERY_CHANGE_WEIGHT_COEFF)
+      battery_history.reset();
     battery = battery_new;
+    if (System::getTimeSyncStatus() != TIME_SYNC_NONE)
+      battery_history.add(System::getTime(), battery);
+  }
   updateAlarm();
-  save();
+  event_history.add(boot ? EVENT_BOOT : (door ? EVENT_OPEN : EVENT_CLOSE), System::getTime(), battery, msg_lost, door ? 0 : remote_time / 1000);
+  markDirty();
 
   // Report in the log
   lmsg = F("(");
@@ -446,6 +634,10 @@ VirtualMailBox& VirtualMailBox::operator=(const MailBoxMessage& msg) {
   lmsg += F("%");
   System::appLogWriteLn(lmsg);
 
+  // Update web pages first, as cloud notifications take time
+  web_events.publish(*this);
+  web_events.send();
+
 #ifdef DS_SUPPORT_TELEGRAM
   // Send event notification to cloud
   telegram.sendEvent(*this, remote_time);
@@ -491,26 +683,29 @@ void VirtualMailBox::timeout() {
   // Assume the message has been sent but did not arrive
   MailBoxMessage::getNextMessageNumber(msg_num);
   msg_count++;
+  radio_stats.add(System::getTimeSyncStatus() != TIME_SYNC_NONE ? System::getTime() : 0, false);
 
   String lmsg = F("Mailbox ");
   lmsg += getName();
   lmsg += F(" door closure event timed out; potentially lost 1 message");
   System::appLogWriteLn(lmsg, true);
+  event_history.add(EVENT_TIMEOUT, System::getTime(), battery, 1);
+  markDirty();
 
   // In the case alarm has been acknowledged before timeout, do not reinstate it
-  if (alarm != ALARM_NONE) {
+  if (alarm != ALARM_NONE)
     updateAlarm();
-    mailbox_manager.updateAlarm();
-  }
+  web_events.publish(*this);
+  web_events.send();
 
   // Prepare for the next event
   g_opening_reported = false;
 }
 
 // HTML printout helper
-String& operator<<(String& html_buf, VirtualMailBox& mb) {
-  mb.printHTML(html_buf);
-  return html_buf;
+WebPage& operator<<(WebPage& page, VirtualMailBox& mb) {
+  mb.printHTML(page);
+  return page;
 }
 
 #endif // !DS_MAILBOX_REMOTE
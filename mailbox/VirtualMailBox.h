@@ -9,9 +9,14 @@
 
 #include "MailBox.h"         // Base class
 #include "MySystem.h"        // Timers
+#include "BatteryHistory.h"  // Battery history
+#include "EventHistory.h"    // Event history
+#include "RadioStats.h"      // Radio statistics
 
 namespace ds {
 
+  typedef struct _mailbox_record mailbox_record_t; // Mailbox database record (see MailBoxDB.h)
+
   // Mailbox alarms, in order from lower to higher severity
   // Note that lower level alarms may override higher level under certain circumstances
   typedef enum {
@@ -30,28 +35,39 @@ namespace ds {
     protected:
       time_t last_seen;                      // Last time the mailbox reported (0 means unknown)
       time_t last_boot;                      // Last time the mailbox booted (0 means unknown)
-      uint32_t msg_recv;                     // Number of received messages
+      RadioStats radio_stats;                // Radio link statistics
       mailbox_alarm alarm;                   // Alarm status
       TimerCountdownAbs timer;               // Timer to check for absent second message
       bool g_opening_reported;               // True if opening has already been reported to Google
       bool low_battery_reported;             // True if low battery status has been recently reported
+      BatteryHistory battery_history;        // Battery level history
+      EventHistory event_history;            // Event history
+      uint16_t updates_pending;              // Number of updates not yet saved to disk (0 means state is saved)
+      unsigned long t_dirty;                 // Time of the first unsaved update (ms from boot)
 
-      static String getConfFileName(const uint8_t /* id */); // Return configuration file name (static version)
-      String getConfFileName() const;        // Return configuration file name
+      void setAlarm(const mailbox_alarm /* new_alarm */); // Set mailbox alarm, notifying mailbox manager on change
+      static String getLegacyFileName(const uint8_t /* id */); // Return legacy configuration file name
+      void markDirty();                      // Mark mailbox as having unsaved updates (also marks mailboxes' state as changed)
+      void printRadioReliability(String& /* buf */, const bool /* html */) const; // Print radio link reliability over all windows
 
     public:
       static const uint8_t RADIO_RELIABILITY_BAD = 89;     // (%)
       static const unsigned int ABSENCE_TIME = 3 * 24 * 60 * 60; // Interval after which mailbox is considered absent (s). Expected to be at least 1 day
+      static const uint8_t LABEL_LENGTH_MAX = 31;          // Max label length stored on disk (B)
+      static const unsigned long SAVE_DELAY = 60000;       // Delay for coalescing updates before saving to disk (ms)
 
       VirtualMailBox(const uint8_t _id = 1, const String _label = (char *)nullptr, const uint8_t _battery = BATTERY_LEVEL_UNKNOWN,
         const time_t _last_seen = 0, const time_t _last_boot = 0); // Constructor
       ~VirtualMailBox();                     // Destructor
+      void setLabel(const String& /* new_label */); // Set mailbox label (truncated to LABEL_LENGTH_MAX)
       time_t getLastSeen() const;            // Return the last report time
       void setLastSeen(const time_t t = 0);  // Set the last report time. 0 means current time
       time_t getLastBoot() const;            // Return the last boot time
       void setLastBoot(const time_t t = 0);  // Set the last boot time. 0 means current time
       String getUptimeStr() const;           // Return uptime as string
-      int8_t getRadioReliability() const;    // Return radio link reliability (%). -1 == unknown
+      int8_t getRadioReliability(const RadioStats::window_t window = RadioStats::WINDOW_FRAMES) const; // Return radio link reliability over a window (%). -1 == unknown
+      uint16_t getBatteryDaysLeft() const;   // Return predicted battery time to empty (d). BatteryHistory::DAYS_LEFT_UNKNOWN == unknown
+      EventHistory& getEventHistory();       // Return event history
       mailbox_alarm getAlarm() const;        // Return mailbox alarm
       String getAlarmStr(const bool html = false) const; // Return mailbox alarm as string (possibly, HTMLized)
       static String getAlarmStr(const mailbox_alarm /* a */, const bool html = false); // Return mailbox alarm as string (static version)
@@ -61,19 +77,24 @@ namespace ds {
       void resetAlarm();                     // Reset mailbox alarm
       bool isOK();                           // Return false in degraded conditions (battery low or mailbox absent)
       void timeout();                        // Message timeout handler
-      void printHTML(String& /* buf */) const; // Print mailbox status in HTML
+      void printHTML(Print& /* buf */) const; // Print mailbox status in HTML (table row)
       void printText(String& /* buf */) const; // Print mailbox status in text
+      void printJSON(Print& /* out */) const;  // Print mailbox status in JSON
+      static void printJSONString(Print& /* out */, const String& /* str */); // Print string as JSON string literal
 #ifdef DS_SUPPORT_TELEGRAM
       void printTelegramKeyboard(String& /* buf */) const; // Print Telegram keyboard for a mailbox
 #endif // DS_SUPPORT_TELEGRAM
-      void save() const;                     // Save mailbox information to disk
-      static VirtualMailBox *load(const uint8_t /* id */); // Initialize mailbox with information on disk
+      void save();                           // Save mailbox information to disk
+      bool saveIfDue(const bool force = false); // Save mailbox information to disk if there are updates pending long enough
+      void load(mailbox_record_t& /* rec */); // Initialize mailbox with database record
+      bool loadLegacy();                     // Initialize mailbox with information in legacy per-mailbox file. Returns false if not found
+      static void forgetLegacy(const uint8_t /* id */); // Remove mailbox information in legacy per-mailbox file
       static bool forget(const uint8_t /* id */); // Remove mailbox information from disk
       VirtualMailBox& operator=(const MailBoxMessage& /* msg */); // Update mailbox from message data
   };
 
 } // namespace ds
 
-String& operator<<(String& /* html_buf */, ds::VirtualMailBox& /* mb */);  // HTML printout helper
+ds::WebPage& operator<<(ds::WebPage& /* page */, ds::VirtualMailBox& /* mb */);  // HTML printout helper
 
 #endif // _DS_VIRTUALMAILBOX_H_
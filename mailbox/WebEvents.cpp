@@ -0,0 +1,180 @@
+/* DS mailbox automation
+ * * Local module
+ * * * Web events implementation
+ * (c) DNS 2020-2023
+ */
+
+#include "MySystem.h"       // System-level definitions
+
+#ifndef DS_MAILBOX_REMOTE
+
+#include "WebEvents.h"
+#include "MailBoxManager.h"         // Mailbox manager
+#include <StreamString.h>           // Event buffer
+#include <ESP8266HTTPClient.h>      // HTTP_CODE_*
+
+using namespace ds;
+
+extern MailBoxManager mailbox_manager;     // Mailbox manager instance
+
+// Serve subscription request
+//// Response headers are written directly, and the client connection is kept after the web server is done with the request.
+//// A new subscriber gets the whole state, so nothing published while it was (re)connecting is lost
+void WebEvents::subscribe() {
+  auto& server = System::web_server;
+  for (auto& subscriber : subscribers)
+    if (!subscriber.client.connected()) {
+      subscriber.client = server.client();
+      subscriber.client.setNoDelay(true);   // Events are small; do not let them wait for more data
+      subscriber.client.print(F(
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n"
+        "retry: 5000\n\n"));
+      subscriber.t_progress = millis();
+      subscriber.alarm_pending = true;
+      memset(subscriber.mailboxes_pending, 0, sizeof(subscriber.mailboxes_pending));
+      for (uint8_t n = 0; n < mailbox_manager.getNumMailBoxes(); n++) {
+        const auto id = mailbox_manager.getMailBoxAt(n)->getID();
+        subscriber.mailboxes_pending[id / 8] |= 1 << id % 8;
+      }
+      System::log->printf(TIMED("Web events subscriber %s connected\n"), subscriber.client.remoteIP().toString().c_str());
+      send();
+      return;
+    }
+  server.send(HTTP_CODE_SERVICE_UNAVAILABLE, "text/plain", F("Too many subscribers"));
+}
+
+// Return true if anybody listens
+bool WebEvents::isSubscribed() {
+  for (auto& subscriber : subscribers)
+    if (subscriber.client.connected())
+      return true;
+  return false;
+}
+
+// Send event to a subscriber if it fits. Returns false otherwise
+bool WebEvents::write(subscriber_t& subscriber, const String& event) {
+  if ((size_t)subscriber.client.availableForWrite() < event.length())
+    return false;
+  subscriber.client.write((const uint8_t *)event.c_str(), event.length());
+  subscriber.t_progress = millis();
+  return true;
+}
+
+// Publish mailbox state change
+void WebEvents::publish(const VirtualMailBox& mailbox) {
+  const auto id = mailbox.getID();
+  for (auto& subscriber : subscribers)
+    if (subscriber.client.connected())
+      subscriber.mailboxes_pending[id / 8] |= 1 << id % 8;
+}
+
+// Publish global alarm change
+void WebEvents::publishAlarm() {
+  for (auto& subscriber : subscribers)
+    if (subscriber.client.connected())
+      subscriber.alarm_pending = true;
+}
+
+// Send pending events as far as the network allows
+//// Every event is rendered once for all subscribers waiting for it. A subscriber whose socket is full is skipped till the next call
+void WebEvents::send() {
+  if (!isSubscribed())
+    return;        // Nobody listens; do not render
+  bool ready[SUBSCRIBERS_MAX];     // True if subscriber can take events in this call
+  bool blocked[SUBSCRIBERS_MAX];   // True if subscriber socket is full
+  for (uint8_t n = 0; n < SUBSCRIBERS_MAX; n++) {
+    ready[n] = subscribers[n].client.connected();
+    blocked[n] = false;
+  }
+
+  // Global alarm
+  bool pending = false;
+  for (uint8_t n = 0; n < SUBSCRIBERS_MAX; n++)
+    pending = pending || (ready[n] && subscribers[n].alarm_pending);
+  if (pending) {
+    const auto alarm = mailbox_manager.getAlarm();
+    StreamString event;
+    event.print(F("event: alarm\ndata: {\"alarm\":"));
+    event.print((int)alarm);
+    event.print(F(",\"alarm_str\":"));
+    VirtualMailBox::printJSONString(event, VirtualMailBox::getAlarmStr(alarm));
+    event.print(F(",\"alarm_icon\":\""));
+    event.print(VirtualMailBox::getAlarmIcon(alarm));
+    event.print(F("\"}\n\n"));
+    for (uint8_t n = 0; n < SUBSCRIBERS_MAX; n++)
+      if (ready[n] && subscribers[n].alarm_pending) {
+        if (write(subscribers[n], event))
+          subscribers[n].alarm_pending = false;
+        else
+          ready[n] = false, blocked[n] = true;
+      }
+  }
+
+  // Mailboxes. Event carries the table row as printed on the page, so the page does not need to know how to render it.
+  //// Only IDs pending for somebody are visited; forgotten mailboxes are among them, as their rows have to go
+  for (uint8_t byte = 0; byte < sizeof(subscribers[0].mailboxes_pending); byte++) {
+    uint8_t bits = 0;
+    for (uint8_t n = 0; n < SUBSCRIBERS_MAX; n++)
+      if (ready[n])
+        bits |= subscribers[n].mailboxes_pending[byte];
+    for (uint8_t b = 0; bits; b++, bits >>= 1) {
+      if (!(bits & 1))
+        continue;
+      const uint8_t id = byte * 8 + b, bit = 1 << b;
+      bool any_ready = false;
+      for (uint8_t n = 0; n < SUBSCRIBERS_MAX; n++)
+        any_ready = any_ready || ready[n];
+      if (!any_ready)
+        break;     // Everybody is full; continue later
+      const auto mailbox = mailbox_manager[id];
+      StreamString row;          // Forgotten mailbox has no row
+      if (mailbox)
+        mailbox->printHTML(row);
+      StreamString event;
+      event.print(F("event: mailbox\ndata: {\"id\":"));
+      event.print(id);
+      event.print(F(",\"html\":"));
+      VirtualMailBox::printJSONString(event, row);
+      event.print(F("}\n\n"));
+      for (uint8_t n = 0; n < SUBSCRIBERS_MAX; n++) {
+        auto& subscriber = subscribers[n];
+        if (!ready[n] || !(subscriber.mailboxes_pending[byte] & bit))
+          continue;
+        if (write(subscriber, event))
+          subscriber.mailboxes_pending[byte] &= ~bit;
+        else
+          ready[n] = false, blocked[n] = true;
+      }
+    }
+  }
+
+  // Drop subscribers which do not take anything
+  for (uint8_t n = 0; n < SUBSCRIBERS_MAX; n++) {
+    auto& subscriber = subscribers[n];
+    if (blocked[n] && millis() - subscriber.t_progress >= STALL_TIMEOUT) {
+      System::log->printf(TIMED("Web events subscriber %s is stalled; dropping\n"), subscriber.client.remoteIP().toString().c_str());
+      subscriber.client.stop();
+    }
+  }
+}
+
+// Send pending events and keep subscriptions alive
+//// Comment line keeps proxies from closing idle connections and reveals dead subscribers. A busy socket needs no keepalive
+void WebEvents::update() {
+  send();
+  if (millis() - t_keepalive >= KEEPALIVE_INTERVAL) {
+    const String keepalive = F(": keepalive\n\n");
+    for (auto& subscriber : subscribers)
+      if (subscriber.client.connected() && !write(subscriber, keepalive) && millis() - subscriber.t_progress >= STALL_TIMEOUT) {
+        System::log->printf(TIMED("Web events subscriber %s is stalled; dropping\n"), subscriber.client.remoteIP().toString().c_str());
+        subscriber.client.stop();
+      }
+    t_keepalive = millis();
+  }
+}
+
+#endif // !DS_MAILBOX_REMOTE
@@ -0,0 +1,52 @@
+/* DS mailbox automation
+ * * Local module
+ * * * Web events definition
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_WEBEVENTS_H_
+#define _DS_WEBEVENTS_H_
+
+#include <Arduino.h>                 // uint8_t, ...
+#include <WiFiClient.h>              // WiFiClient
+#include "MailBoxMessage.h"          // MAILBOX_ID_MAX
+
+namespace ds {
+
+  class VirtualMailBox;
+
+  // Server-sent events channel for live web page updates
+  //// Subscribers hold a long-lived HTTP response. Publishing only marks what has changed; events are rendered from the current
+  //// state when sent, so a burst of changes costs one event per mailbox. Writing never waits for the network: what does not fit
+  //// into the socket stays pending, and only a subscriber which has not taken anything for STALL_TIMEOUT is dropped
+  class WebEvents {
+    public:
+      static const uint8_t SUBSCRIBERS_MAX = 4;  // Max number of subscribers (limited by RAM and sockets)
+      static const unsigned long KEEPALIVE_INTERVAL = 15000; // Interval between keepalive messages (ms)
+      static const unsigned long STALL_TIMEOUT = 30000; // Time after which a subscriber not taking events is dropped (ms)
+
+    private:
+      struct subscriber_t {
+        WiFiClient client;                       // Subscribed client
+        bool alarm_pending;                      // True if global alarm is to be sent
+        uint8_t mailboxes_pending[MAILBOX_ID_MAX / 8 + 1]; // Bitmap of mailboxes to be sent, by ID
+        unsigned long t_progress;                // Time of the last write or subscription (ms from boot)
+      };
+      subscriber_t subscribers[SUBSCRIBERS_MAX]; // Subscribers
+      unsigned long t_keepalive;                 // Time of the last keepalive message (ms from boot)
+
+      bool write(subscriber_t& /* subscriber */, const String& /* event */); // Send event to a subscriber if it fits. Returns false otherwise
+      bool isSubscribed();                       // Return true if anybody listens
+
+    public:
+      WebEvents() : subscribers(), t_keepalive(0) {}
+      void subscribe();                          // Serve subscription request
+      void publish(const VirtualMailBox& /* mailbox */); // Publish mailbox state change
+      void publishAlarm();                       // Publish global alarm change
+      void send();                               // Send pending events as far as the network allows
+      void update();                             // Send pending events and keep subscriptions alive
+  };
+
+} // namespace ds
+
+#endif // _DS_WEBEVENTS_H_
@@ -9,7 +9,9 @@
 
 #include "Receiver.h"         // Message receiver
 #include "MailBoxManager.h"   // Mailbox manager
+#include "MailBoxDB.h"        // Mailbox database
 #include "GoogleAssistant.h"  // Google interface
+#include "WebEvents.h"        // Web events
 #ifdef DS_SUPPORT_TELEGRAM
 #include "Telegram.h"         // Telegram interface
 #endif // DS_SUPPORT_TELEGRAM
@@ -45,7 +47,9 @@ const char *System::hostname PROGMEM = "Mailbox" // <hostname>.local in the loca
 // Global objects
 static Receiver receiver;                        // RF receiver
 MailBoxManager mailbox_manager;                  // Mailbox manager
+MailBoxDB mailbox_db;                            // Mailbox database
 GoogleAssistant google_assistant;                // Google interface
+WebEvents web_events;                            // Web events
 #ifdef DS_SUPPORT_TELEGRAM
 Telegram telegram;                               // Telegram interface
 #endif // DS_SUPPORT_TELEGRAM
@@ -79,6 +83,12 @@ static void handleButtonEvent(AceButton* /* button */, uint8_t event_type, uint8
       mailbox_manager.acknowledgeAlarm(F("button"));
       break;
 
+#ifdef DS_CAP_WIFIMANAGER
+    case AceButton::kEventLongPressed:    // Wi-Fi configuration follows; it blocks, and the module is often power cycled from there
+      mailbox_manager.save();
+      break;
+#endif // DS_CAP_WIFIMANAGER
+
 #ifdef DS_DEVBOARD
     case AceButton::kEventDoubleClicked:  // Emulate incoming event
       recv_message_emulated = true;
@@ -100,33 +110,12 @@ static void handleTimeSync() {
   }
 }
 
-// Timer handler
-static void handleAbsTimer(const TimerAbsolute* timer) {
-  const auto& action = timer->getAction();
-
-  if (action.startsWith("signal absent msg for mb_id=")) {
-
-    // This would be far easier if timer could store a back reference to mailbox; see https://github.com/denis-stepanov/esp-ds-system/issues/61
-    const auto mb = mailbox_manager[action.substring(28).toInt()];
-    if (mb)
-      mb->timeout();
-  }
-
-#ifdef DS_SUPPORT_TELEGRAM
-  if (action == "poll TG") {
-    telegram.update();
-  }
-#endif // DS_SUPPORT_TELEGRAM
-
-}
-
 //// Install hooks
 #ifdef DS_DEVBOARD
 void (*System::onButtonInit)() = handleButtonInit;
 #endif // DS_DEVBOARD
 void (*System::onButtonPress)(AceButton*, uint8_t, uint8_t) = handleButtonEvent;
 void (*System::onTimeSync)() = handleTimeSync;
-void (*System::timerHandler)(const TimerAbsolute*) = handleAbsTimer;
   
 void setup() {
 
@@ -159,14 +148,15 @@ void loop() {
     check_degraded = false;
   }
 
-  // Check for incoming message
-  if (receiver.messageAvailable())
+  // Check for incoming messages
+  while (receiver.messageAvailable())
     mailbox_manager.process(receiver.getMessage());
 
   // Background processing
   System::update();
   receiver.update();
   mailbox_manager.update();
+  web_events.update();
 }
 
 #endif // !DS_MAILBOX_REMOTE
@@ -26,12 +26,15 @@ ADC_MODE(ADC_VCC);                               // Configure ADC to measure Vcc
 Print* System::log = &Serial1;                   // Syslog on secondary UART (primary is occupied by transmitter)
 
 //// Other
-static const uint8_t MAILBOX_ID = 1;             // Mailbox identification number (1-15)
+static const uint8_t MAILBOX_ID = 1;             // Mailbox identification number (1-15; 1-255 with DS_MAILBOX_PROTO_EXT)
+static const uint8_t TX_REPEATS = 1;             // Number of times each message is sent (1-4). Each extra copy adds ~2.25 s of awake time
 
 // Normally, no need to change below this line
 
+static_assert(MAILBOX_ID <= MAILBOX_ID_MAX_BASIC || PROTO_VERSION == PROTO_VERSION_EXT, "Mailbox IDs above 15 require DS_MAILBOX_PROTO_EXT");
+
 // Global variables
-static Transmitter transmitter(Serial, MAILBOX_ID, PIN_HC12_SET); // Transmitter
+static Transmitter transmitter(Serial, MAILBOX_ID, PIN_HC12_SET, TX_REPEATS); // Transmitter
 static PhysicalMailBox mailbox(MAILBOX_ID, PIN_REED); // Mailbox
 
 void setup() {
@@ -39,14 +42,14 @@ void setup() {
   // First the system
   System::begin();
 
-  // Initialize RF transmitter
+  // Initialize RF transmitter. Wakeup does not block, so transmitter settles while the mailbox is being initialized
   transmitter.begin();
   transmitter.wakeup();
 
   // Initialize mailbox
   mailbox.begin();
 
-  // Send wakeup message
+  // Send wakeup message (waits for transmitter to become ready, if needed)
   transmitter << mailbox;
 }
 
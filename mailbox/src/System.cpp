@@ -57,30 +57,320 @@ const char *System::app_url     PROGMEM __attribute__ ((weak)) = nullptr;
 
 static const char *APP_LOG_FILE_NAME  PROGMEM = "/applog.txt";    // Current log file
 static const char *APP_LOG_FILE_NAME2 PROGMEM = "/applog2.txt";   // Rotated log file
+static const char *APP_LOG_INDEX_NAME  PROGMEM = "/applog.idx";   // Current log index
+static const char *APP_LOG_INDEX_NAME2 PROGMEM = "/applog2.idx";  // Rotated log index
 
 // Logs tend to fill up the drive. It is better to always keep some space available,
 // plus, current implementation will usually overshoot max log size by a few bytes. So reserve some free space
 static const size_t APP_LOG_SLACK = 51200;    // Reserve 50kiB
 
+// Lines are collected in RAM and written in groups, as every flush to flash rewrites a file block
+static const size_t APP_LOG_BUFFER_SIZE = 512;              // Log buffer size (B)
+static const unsigned long APP_LOG_FLUSH_INTERVAL = 10000;  // Max time a line can stay in the buffer (ms)
+static char app_log_buffer[APP_LOG_BUFFER_SIZE];            // Log buffer
+static size_t app_log_buffer_len = 0;                       // Amount of data in the buffer (B)
+static unsigned long app_log_buffer_time = 0;               // Time of the oldest line in the buffer (ms)
+
+// Log files have sidecar indexes with offsets of lines about every APP_LOG_INDEX_STEP bytes, so that any page or time
+// can be found without reading the log. Index is appended along with the log
+static const size_t APP_LOG_INDEX_STEP = 1024;              // Log size between index entries (B). This is also the log page size
+typedef struct {
+  uint32_t offset;                                          // Offset of a line start in the log (B)
+  uint32_t time;                                            // Time of the line (0 == unknown)
+} app_log_index_t;
+static File app_log_index;                                  // Current log index file
+static size_t app_log_pos = 0;                              // Current log size, including the buffer (B)
+static size_t app_log_index_next = 0;                       // Log offset from which the next line is indexed (B)
+static app_log_index_t app_log_index_pending;               // Index entry waiting for its log line to be flushed
+static bool app_log_index_pending_ok = false;               // True if an index entry is waiting
+
 File System::app_log;
 size_t System::app_log_size;
 
 // For large file systems, hard-limit log size. It is not likely that more than 1MiB of logs will be needed
 size_t System::app_log_size_max __attribute__ ((weak)) = 1048576;
 
+// Application log line reader
+//// File is read in blocks, and lines are returned in a fixed buffer, so no memory is allocated per line. Overlong lines are truncated
+class AppLogReader {
+  public:
+    static const size_t LINE_MAX = 255;                     // Max line length (B)
+    char line[LINE_MAX + 1];                                // Current line, without line terminator
+    size_t line_len;                                        // Current line length (B)
+    size_t line_offset;                                     // Offset of the current line in the file (B)
+
+  protected:
+    File& file;                                             // Log file
+    char block[256];                                        // Read buffer
+    size_t block_len;                                       // Amount of data in the read buffer (B)
+    size_t block_pos;                                       // Read position in the buffer
+    size_t offset;                                          // File offset of the read position (B)
+
+  public:
+    AppLogReader(File& _file, const size_t start = 0) : line_len(0), line_offset(start), file(_file), block_len(0), block_pos(0), offset(start) {
+      file.seek(start);
+    }
+
+    // Read the next line. Returns false at the end of file
+    bool next(const size_t end = SIZE_MAX) {
+      line_len = 0;
+      line_offset = offset;
+      if (offset >= end)
+        return false;
+      while (true) {
+        if (block_pos == block_len) {
+          block_len = file.read((uint8_t *)block, sizeof(block));
+          block_pos = 0;
+          if (!block_len) {
+            line[line_len] = 0;
+            return line_len || offset > line_offset;     // Last line without terminator
+          }
+        }
+        const char c = block[block_pos++];
+        offset++;
+        if (c == '\n')
+          break;
+        if (c != '\r' && line_len < LINE_MAX)
+          line[line_len++] = c;
+      }
+      line[line_len] = 0;
+      return true;
+    }
+};
+
+// Return time of a log line (0 == unknown)
+//// Time prefix format is "YYYY/MM/DD HH:MM:SS"
+static time_t appLogLineTime(const char *line, const size_t len) {
+  if (len < 19 || line[4] != '/' || line[7] != '/' || line[10] != ' ' || line[13] != ':' || line[16] != ':' || !isdigit(line[0]))
+    return 0;
+  struct tm tm;
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_year = atoi(line) - 1900;
+  tm.tm_mon = atoi(line + 5) - 1;
+  tm.tm_mday = atoi(line + 8);
+  tm.tm_hour = atoi(line + 11);
+  tm.tm_min = atoi(line + 14);
+  tm.tm_sec = atoi(line + 17);
+  tm.tm_isdst = -1;
+  return mktime(&tm);
+}
+
+// Build log index from the log. Returns the log offset from which the next line should be indexed
+//// Used when index is missing or damaged (e.g., after upgrade or power loss)
+static size_t appLogIndexBuild(const char *log_name, const char *index_name) {
+  auto &fs = System::fs;
+  auto log_file = fs.open(log_name, "r");
+  auto index_file = fs.open(index_name, "w");
+  size_t next = 0;
+  if (log_file && index_file) {
+    AppLogReader reader(log_file);
+    while (reader.next())
+      if (reader.line_offset >= next) {
+        const app_log_index_t entry = {(uint32_t)reader.line_offset, (uint32_t)appLogLineTime(reader.line, reader.line_len)};
+        index_file.write((const uint8_t *)&entry, sizeof(entry));
+        next = reader.line_offset + APP_LOG_INDEX_STEP;
+      }
+  }
+  log_file.close();
+  index_file.close();
+  return next;
+}
+
+// Open log index, rebuilding it if it does not match the log. Returns the log offset from which the next line should be indexed
+static size_t appLogIndexOpen(const char *log_name, const char *index_name, const size_t log_size) {
+  auto &fs = System::fs;
+  size_t next = 0;
+  bool index_ok = false;
+  auto index_file = fs.open(index_name, "r");
+  if (index_file) {
+    const auto n = index_file.size() / sizeof(app_log_index_t);
+    app_log_index_t entry;
+    if (!n)
+      index_ok = !log_size;
+    else
+      if (index_file.size() % sizeof(app_log_index_t) == 0 && index_file.seek((n - 1) * sizeof(entry)) &&
+          index_file.read((uint8_t *)&entry, sizeof(entry)) == sizeof(entry) && entry.offset < log_size) {
+        next = entry.offset + APP_LOG_INDEX_STEP;
+        index_ok = true;
+      }
+    index_file.close();
+  } else
+    index_ok = !log_size;
+  if (!index_ok && log_size) {
+#ifdef DS_CAP_SYS_LOG
+    System::log->printf(TIMED("Rebuilding application log index %s\n"), index_name);
+#endif // DS_CAP_SYS_LOG
+    next = appLogIndexBuild(log_name, index_name);
+  }
+  return next;
+}
+
+// Find the range of a log page in a file, newest page being 0. Returns the number of pages
+//// Without index, pages are cut by size, and the caller has to skip the first partial line
+static size_t appLogPage(const char *index_name, const size_t log_size, size_t& page, size_t& start, size_t& end, bool& aligned) {
+  auto index_file = System::fs.open(index_name, "r");
+  const size_t n = index_file ? index_file.size() / sizeof(app_log_index_t) : 0;
+  aligned = n;
+  if (!n) {
+    const auto pages = log_size ? (log_size + APP_LOG_INDEX_STEP - 1) / APP_LOG_INDEX_STEP : 1;
+    if (page >= pages)
+      page = pages - 1;
+    end = log_size - page * APP_LOG_INDEX_STEP;
+    start = end > APP_LOG_INDEX_STEP ? end - APP_LOG_INDEX_STEP : 0;
+    return pages;
+  }
+  if (page >= n)
+    page = n - 1;
+  const auto k = n - 1 - page;
+  app_log_index_t entry;
+  index_file.seek(k * sizeof(entry));
+  start = index_file.read((uint8_t *)&entry, sizeof(entry)) == sizeof(entry) && entry.offset < log_size ? entry.offset : 0;
+  end = log_size;
+  if (k + 1 < n && index_file.read((uint8_t *)&entry, sizeof(entry)) == sizeof(entry) && entry.offset <= log_size)
+    end = entry.offset;
+  index_file.close();
+  return n;
+}
+
+// Return the time of an index entry, borrowed from the nearest timed entry before "end" if unknown (0 == not found)
+//// Lines logged before time synchronization have no time, and they recur after every reboot. Such lines are not later than
+//// the next timed line, so borrowing its time keeps index times ordered. A page found this way never starts after the given time
+static time_t appLogIndexTime(File& index_file, const size_t k, const size_t end) {
+  app_log_index_t entry;
+  for (size_t i = k; i < end; i++)
+    if (index_file.seek(i * sizeof(entry)) && index_file.read((uint8_t *)&entry, sizeof(entry)) == sizeof(entry) && entry.time)
+      return entry.time;
+  return 0;
+}
+
+// Find the log page containing a given time, newest page being 0. Returns false if the time is before the file start
+//// Binary search over the index
+static bool appLogPageByTime(const char *index_name, const time_t t, size_t& page) {
+  auto index_file = System::fs.open(index_name, "r");
+  if (!index_file)
+    return false;
+  const size_t n = index_file.size() / sizeof(app_log_index_t);
+  size_t lo = 0, hi = n;   // Find the first entry later than t. Untimed entries up to "hi" are as late as "hi" itself
+  while (lo < hi) {
+    const auto mid = lo + (hi - lo) / 2;
+    const auto entry_time = appLogIndexTime(index_file, mid, hi);
+    if (entry_time && entry_time <= t)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  index_file.close();
+  if (!lo)
+    return false;
+  page = n - lo;
+  return true;
+}
+
+// Return the offset of the indexed line preceding a given time (0 == file start)
+static size_t appLogOffsetByTime(const char *index_name, const size_t log_size, const time_t t) {
+  size_t page, start, end;
+  bool aligned;
+  if (!appLogPageByTime(index_name, t, page))
+    return 0;
+  appLogPage(index_name, log_size, page, start, end, aligned);
+  return aligned ? start : 0;
+}
+
+// Case-insensitive substring matcher (Boyer-Moore-Horspool)
+//// Mismatching windows are skipped by up to the pattern length, so most of the text is not even looked at
+class AppLogMatcher {
+  public:
+    static const size_t PATTERN_MAX = 64;                   // Max pattern length (B). Callers must reject longer patterns
+
+  protected:
+    char pattern[PATTERN_MAX];                              // Pattern, lower case
+    size_t len;                                             // Pattern length (B)
+    uint8_t skip[256];                                      // Window shift by its last character
+
+  public:
+    AppLogMatcher(const char *_pattern) : len(0) {
+      while (_pattern[len] && len < PATTERN_MAX) {
+        pattern[len] = tolower(_pattern[len]);
+        len++;
+      }
+      memset(skip, len ? len : 1, sizeof(skip));
+      for (size_t i = 0; i + 1 < len; i++)
+        skip[(uint8_t)pattern[i]] = skip[(uint8_t)toupper(pattern[i])] = len - 1 - i;
+    }
+
+    // Return pattern length
+    size_t length() const {
+      return len;
+    }
+
+    // Return the first occurrence of the pattern in a text, or nullptr if not found. Empty pattern is found at the start
+    const char *find(const char *text, const size_t text_len) const {
+      for (size_t pos = 0; pos + len <= text_len; pos += skip[(uint8_t)text[pos + len - 1]]) {
+        size_t i = len;
+        while (i && tolower(text[pos + i - 1]) == pattern[i - 1])
+          i--;
+        if (!i)
+          return text + pos;
+      }
+      return nullptr;
+    }
+};
+
+// Write data into application log buffer, flushing it when full
+static bool appLogWrite(File& log_file, const char *data, const size_t len) {
+  bool ret = true;
+  if (app_log_buffer_len + len > APP_LOG_BUFFER_SIZE) {
+    ret = System::appLogFlush();
+    if (len > APP_LOG_BUFFER_SIZE)
+      return log_file.write((const uint8_t *)data, len) == len && ret;   // Does not fit; bypass the buffer
+  }
+  if (!app_log_buffer_len)
+    app_log_buffer_time = millis();
+  memcpy(app_log_buffer + app_log_buffer_len, data, len);
+  app_log_buffer_len += len;
+  return ret;
+}
+
 // Write a line into application log
+//// Line is buffered; lines copied to syslog are considered important and are flushed to disk immediately
 bool System::appLogWriteLn(const String& line, bool copy_to_syslog) {
   bool ret = false;
-  String msg;
   if (app_log_size_max) {
+    ret = true;
+
+    // Index the line if due
+    if (app_log_pos >= app_log_index_next) {
+      if (app_log_index_pending_ok)
+        appLogFlush();
+      app_log_index_pending = {(uint32_t)app_log_pos, (uint32_t)(
 #ifdef DS_CAP_SYS_TIME
-    msg += getTimeStr();
-    msg += F(": ");
+        time
+#else
+        0
 #endif // DS_CAP_SYS_TIME
-    msg += line;
-    ret = app_log.println(msg);
-    app_log.flush();
-    app_log_size += msg.length();
+      )};
+      app_log_index_pending_ok = true;
+      app_log_index_next = app_log_pos + APP_LOG_INDEX_STEP;
+    }
+#ifdef DS_CAP_SYS_TIME
+    // Time prefix is formatted once per second
+    static time_t prefix_time = -1;
+    static char prefix[24];
+    if (time != prefix_time) {
+      snprintf(prefix, sizeof(prefix), "%s: ", getTimeStr().c_str());
+      prefix_time = time;
+    }
+    const size_t prefix_len = strlen(prefix);
+    ret = appLogWrite(app_log, prefix, prefix_len) && ret;
+    app_log_size += prefix_len;
+    app_log_pos += prefix_len;
+#endif // DS_CAP_SYS_TIME
+    ret = appLogWrite(app_log, line.c_str(), line.length()) && ret;
+    ret = appLogWrite(app_log, "\r\n", 2) && ret;
+    app_log_size += line.length() + 2;
+    app_log_pos += line.length() + 2;
+    if (copy_to_syslog)
+      ret = appLogFlush() && ret;
   }
   if (copy_to_syslog) {
 #ifdef DS_CAP_SYS_LOG
@@ -91,6 +381,24 @@ bool System::appLogWriteLn(const String& line, bool copy_to_syslog) {
   return ret;
 }
 
+// Write buffered application log lines to disk
+//// Index entry is written after its line, so that index never points beyond the log
+bool System::appLogFlush() {
+  bool ret = true;
+  if (app_log_buffer_len) {
+    const auto len = app_log_buffer_len;
+    app_log_buffer_len = 0;
+    ret = app_log.write((const uint8_t *)app_log_buffer, len) == len;
+    app_log.flush();
+  }
+  if (app_log_index_pending_ok && app_log_index) {
+    app_log_index.write((const uint8_t *)&app_log_index_pending, sizeof(app_log_index_pending));
+    app_log_index.flush();
+  }
+  app_log_index_pending_ok = false;
+  return ret;
+}
+
 #endif // DS_CAP_APP_LOG
 
 
@@ -603,21 +911,93 @@ String System::getNetworkConfigPassword() {
 #include <ESP8266HTTPClient.h>      // HTTP_CODE_*
 
 ESP8266WebServer System::web_server;
-String System::web_page((char *)nullptr);        // Avoid initial memory allocation
+WebPage System::web_page;
 void (*System::registerWebPages)() __attribute__ ((weak)) = nullptr;
 
 #ifdef DS_CAP_SYS_FS
 static const char *FAV_ICON_PATH PROGMEM = "/favicon.png"; // Favicon on disk
 #endif // DS_CAP_SYS_FS
-static const size_t MAX_WEB_PAGE_SIZE = 2048;    // Preallocated web page buffer size (B)
 
 #ifdef DS_CAP_WEB_TIMERS
 std::forward_list<String> System::timer_actions; // List of timer actions
 #endif // DS_CAP_WEB_TIMERS
 
+// Start a new page
+void WebPage::begin(const char *_content_type) {
+  content_type = _content_type;
+  code = HTTP_CODE_OK;
+  buffer_len = 0;
+  sent = 0;
+  started = false;
+  heap_min = ESP.getFreeHeap();
+  t_begin = millis();
+}
+
+// Set HTTP response code
+void WebPage::setCode(const int _code) {
+  code = _code;
+}
+
+// Append a byte
+size_t WebPage::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+// Append data
+size_t WebPage::write(const uint8_t* data, size_t len) {
+  const auto ret = len;
+  while (len) {
+    if (buffer_len == BUFFER_SIZE)
+      flush();
+    const auto n = len < BUFFER_SIZE - buffer_len ? len : BUFFER_SIZE - buffer_len;
+    memcpy(buffer + buffer_len, data, n);
+    buffer_len += n;
+    data += n;
+    len -= n;
+  }
+  return ret;
+}
+
+// Send buffered data as a chunk
+//// Headers are sent with the first chunk; unknown content length makes the server use chunked transfer encoding
+void WebPage::flush() {
+  if (!started) {
+    System::web_server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    System::web_server.send(code, content_type, "");
+    started = true;
+  }
+  if (buffer_len) {
+    System::web_server.sendContent(buffer, buffer_len);
+    sent += buffer_len;
+    buffer_len = 0;
+  }
+  const auto heap = ESP.getFreeHeap();
+  if (heap < heap_min)
+    heap_min = heap;
+}
+
+// Complete the page. Returns the page size
+size_t WebPage::end() {
+  flush();
+  System::web_server.sendContent("");   // Terminating chunk
+  started = false;
+  return sent;
+}
+
+// Return the lowest free heap seen while sending
+uint32_t WebPage::getHeapMin() const {
+  return heap_min;
+}
+
+// Return time spent on the page so far (generation and sending)
+unsigned long WebPage::getTime() const {
+  return millis() - t_begin;
+}
+
 // Add standard header to the web page
 void System::pushHTMLHeader(const String& title, const String& head_user, bool redirect) {
-  web_page = F(
+  web_page.begin();
+  web_page += F(
     "<!DOCTYPE html>\n"
     "<html><head><title>");
   web_page += title;
@@ -860,7 +1240,7 @@ void System::serveAbout() {
 
 #ifdef DS_CAP_APP_LOG
 // Serve the "log" page
-static const size_t APP_LOG_PAGE_SIZE = 1024; // Max amount of information to display from the log file (B)
+//// Pages are located via log index; "t" parameter (seconds since epoch) opens the page containing the given time
 static const char *APP_LOG_STYLE PROGMEM =
   "<style>\n"
   "  h4 { text-align: center; border-bottom: 1px solid #000; line-height: 0.1em; margin: 15px 0 -15px; }\n"
@@ -870,38 +1250,49 @@ void System::serveAppLog() {
   pushHTMLHeader(F("Application Log"), APP_LOG_STYLE);
   web_page += F(
     "<h3>Application Log</h3>\n"
-    "[ <a href=\"/\">home</a> ]<hr/>\n"
+    "[ <a href=\"/\">home</a> ] [ <a href=\"/log/search\">search</a> ]<hr/>\n"
   );
 
   if (app_log_size_max) {
+    appLogFlush();   // Show the latest lines
 
     // Parse query params
-    unsigned int log_page = 0;
-    String log_file_name(APP_LOG_FILE_NAME), log_param;
+    size_t log_page = 0;
+    bool rotated = false;
     for (unsigned int i = 0; i < (unsigned int)web_server.args(); i++) {
       const String argname = web_server.argName(i);
       if (argname == "p")
         log_page = web_server.arg(i).toInt();
       else
-        if (argname == "r") {
-          log_file_name = APP_LOG_FILE_NAME2;
-          log_param = "r=1&";
-        }
+      if (argname == "r")
+        rotated = true;
+      else
+      if (argname == "t") {
+        const time_t t = web_server.arg(i).toInt();
+        rotated = !appLogPageByTime(APP_LOG_INDEX_NAME, t, log_page);
+        if (rotated && !appLogPageByTime(APP_LOG_INDEX_NAME2, t, log_page))
+          log_page = SIZE_MAX;   // Oldest page
+      }
     }
+    const char *log_file_name = rotated ? APP_LOG_FILE_NAME2 : APP_LOG_FILE_NAME;
+    const char *log_param = rotated ? "r=1&" : "";
 
     File log_file = fs.open(log_file_name, "r");
     if (log_file) {
       const size_t fsize = log_file.size();
+      size_t start, end;
+      bool aligned;
+      const auto pages = appLogPage(rotated ? APP_LOG_INDEX_NAME2 : APP_LOG_INDEX_NAME, fsize, log_page, start, end, aligned);
 
       // Print pagination buttons
-      if (fsize > (log_page + 1) * APP_LOG_PAGE_SIZE) {
+      if (log_page + 1 < pages) {
         web_page += F("[ <a href=\"/log?");
         web_page += log_param;
         web_page += F("p=");
         web_page += log_page + 1;
         web_page += F("\">&lt;&lt;</a> ]&nbsp;&nbsp;&nbsp;\n");
       } else {
-        if (log_file_name == APP_LOG_FILE_NAME && fs.exists(APP_LOG_FILE_NAME2))
+        if (!rotated && fs.exists(APP_LOG_FILE_NAME2))
           web_page += F("[ <a href=\"/log?r=1\">&lt;&lt;</a> ]&nbsp;&nbsp;&nbsp;\n");
         else
           web_page += F("[ &lt;&lt; ]&nbsp;&nbsp;&nbsp;\n");
@@ -913,13 +1304,15 @@ void System::serveAppLog() {
         web_page += log_page - 1;
         web_page += F("\">&gt;&gt;</a> ]\n");
       } else {
-        if (log_file_name == APP_LOG_FILE_NAME2 && fs.exists(APP_LOG_FILE_NAME)) {
+        if (rotated && fs.exists(APP_LOG_FILE_NAME)) {
           File log_file_next = fs.open(APP_LOG_FILE_NAME, "r");
           if (log_file_next) {
-            const size_t log_page_next = log_file_next.size() / APP_LOG_PAGE_SIZE;
+            size_t page_next = SIZE_MAX, start_next, end_next;
+            bool aligned_next;
+            appLogPage(APP_LOG_INDEX_NAME, log_file_next.size(), page_next, start_next, end_next, aligned_next);
             log_file_next.close();
             web_page += F("[ <a href=\"/log?p=");
-            web_page += log_page_next;
+            web_page += page_next;
             web_page += F("\">&gt;&gt;</a> ]\n");
           } else
             web_page += F("[ &gt;&gt; ]\n");
@@ -930,28 +1323,25 @@ void System::serveAppLog() {
       // Print log fragment
       web_page += F("<span style=\"font-family: monospace;\">\n");
 
-      if (fsize > (log_page + 1) * APP_LOG_PAGE_SIZE) {
-        log_file.seek(fsize - (log_page + 1) * APP_LOG_PAGE_SIZE);
-        log_file.readStringUntil('\n');
-      }
-      String line, old_date(F(""));
-      while (log_file.available() && log_file.position() <= fsize - log_page * APP_LOG_PAGE_SIZE) {
-        line = log_file.readStringUntil('\n');
-        String new_date = line.substring(0, 10);
-        if (new_date[4] == '/' && new_date[7] == '/' && new_date[0] != '/') {
-          line.remove(0, 11);
-          if (old_date != new_date) {
+      AppLogReader reader(log_file, start);
+      if (!aligned && start)
+        reader.next();   // Skip partial line
+      char old_date[11] = "";
+      while (reader.next(end)) {
+        const char *line = reader.line;
+        if (reader.line_len >= 11 && line[4] == '/' && line[7] == '/' && line[0] != '/') {
+          if (strncmp(old_date, line, 10)) {
             char time_str[32] = {0, };
 
             // Reconstruct date information from condensed log string
-            if (new_date.startsWith(F("--")))
+            if (line[0] == '-')
               strncpy_P(time_str, PSTR("(no date)"), sizeof(time_str) - 1);
             else {
               struct tm new_tm;
               memset(&new_tm, 0, sizeof(new_tm));
-              new_tm.tm_year = new_date.substring(0, 4).toInt() - 1900;
-              new_tm.tm_mon = new_date.substring(5, 7).toInt() - 1;
-              new_tm.tm_mday = new_date.substring(8, 10).toInt();
+              new_tm.tm_year = atoi(line) - 1900;
+              new_tm.tm_mon = atoi(line + 5) - 1;
+              new_tm.tm_mday = atoi(line + 8);
               new_tm.tm_isdst = -1;
               mktime(&new_tm);
               strftime(time_str, sizeof(time_str) - 1, "%A, %e %B %Y", &new_tm);
@@ -960,19 +1350,21 @@ void System::serveAppLog() {
             web_page += F("<h4><span>");
             web_page += time_str;
             web_page += F("</span></h4>\n");
-            old_date = new_date;
+            memcpy(old_date, line, 10);
+            old_date[10] = 0;
           }
+          line += 11;
         } else {
-          new_date = F("-");
-          if (old_date != new_date) {
+          if (strcmp(old_date, "-")) {
             web_page += F("<h4><span>(time disabled)</span></h4>\n");
-            old_date = new_date;
+            strcpy(old_date, "-");
           }
         }
         web_page += F("<br/>");
-        if (line.startsWith(F("--:--:--: ")))
-          line.remove(0, 10);
-        web_page += line;   // already contains '\n'
+        if (!strncmp_P(line, PSTR("--:--:--: "), 10))
+          line += 10;
+        web_page += line;
+        web_page += '\n';
       }
       log_file.close();
     } else
@@ -984,19 +1376,191 @@ void System::serveAppLog() {
   pushHTMLFooter();
   sendWebPage();
 }
+
+// Normalize time given for log search to the log time format (e.g., "YYYY-MM-DDTHH:MM" -> "YYYY/MM/DD HH:MM")
+static void appLogSearchTime(String& t) {
+  t.trim();
+  t.replace('-', '/');
+  t.replace('T', ' ');
+  if (t.length() > 19)
+    t.remove(19);
+}
+
+// Print a value for an HTML attribute enclosed in double quotes
+static void printHTMLAttr(Print& out, const String& value) {
+  for (unsigned int i = 0; i < value.length(); i++) {
+    const char c = value[i];
+    switch (c) {
+      case '&': out.print(F("&amp;"));  break;
+      case '<': out.print(F("&lt;"));   break;
+      case '>': out.print(F("&gt;"));   break;
+      case '"': out.print(F("&quot;")); break;
+      default:  out.print(c);           break;
+    }
+  }
+}
+
+// Return true if a log line mentions a mailbox, as in "Mailbox N", "mailbox N" or "id=N"
+static bool appLogLineHasMailBox(const AppLogMatcher& matcher, const char *line, const size_t len) {
+  for (const char *p = line; (p = matcher.find(p, len - (p - line))); p++) {
+    const char *next = p + matcher.length();
+    if (next == line + len || !isdigit(*next))
+      return true;
+  }
+  return false;
+}
+
+// Serve the "log search" page
+//// Both log files are scanned in one pass, oldest first, starting from the index entry preceding "from" time. Time limits are
+//// compared with the line time prefix as strings, so a partial time (e.g., date only) covers the whole period
+static const size_t APP_LOG_SEARCH_MATCHES_MAX = 500;    // Max number of lines shown
+void System::serveAppLogSearch() {
+
+  // Parse query params
+  String q, mb, from, to;
+  for (unsigned int i = 0; i < (unsigned int)web_server.args(); i++) {
+    const String argname = web_server.argName(i);
+    if (argname == "q")
+      q = web_server.arg(i);
+    else
+    if (argname == "mb") {
+      const auto id = web_server.arg(i).toInt();
+      if (id > 0)
+        mb = String(id);
+    } else
+    if (argname == "from")
+      from = web_server.arg(i);
+    else
+    if (argname == "to")
+      to = web_server.arg(i);
+  }
+  appLogSearchTime(from);
+  appLogSearchTime(to);
+
+  pushHTMLHeader(F("Application Log Search"));
+  web_page += F(
+    "<h3>Application Log Search</h3>\n"
+    "[ <a href=\"/\">home</a> ] [ <a href=\"/log\">log</a> ]<hr/>\n"
+    "<form action=\"/log/search\">\n"
+    "<label for=\"q\">Text: </label><input type=\"text\" id=\"q\" name=\"q\" value=\"");
+  printHTMLAttr(web_page, q);
+  web_page += F("\"/>\n"
+    "<label for=\"mb\">Mailbox: </label><input type=\"number\" id=\"mb\" name=\"mb\" min=\"1\" value=\"");
+  printHTMLAttr(web_page, mb);
+  web_page += F("\"/>\n"
+    "<label for=\"from\">From: </label><input type=\"text\" id=\"from\" name=\"from\" placeholder=\"YYYY/MM/DD HH:MM\" value=\"");
+  printHTMLAttr(web_page, from);
+  web_page += F("\"/>\n"
+    "<label for=\"to\">To: </label><input type=\"text\" id=\"to\" name=\"to\" placeholder=\"YYYY/MM/DD HH:MM\" value=\"");
+  printHTMLAttr(web_page, to);
+  web_page += F("\"/>\n"
+    "<button type=\"submit\">Search</button>\n"
+    "</form>\n");
+
+  if (!app_log_size_max)
+    web_page += F("<br/>Logging is disabled (missing or full file system)");
+  else
+  if (q.length() > AppLogMatcher::PATTERN_MAX) {
+    web_page += F("<br/>Search text is too long (max ");
+    web_page += AppLogMatcher::PATTERN_MAX;
+    web_page += F(" characters)");
+  } else
+  if (q.length() || mb.length() || from.length() || to.length()) {
+    appLogFlush();   // Search the latest lines too
+
+    const AppLogMatcher q_matcher(q.c_str());
+    const AppLogMatcher mb_matcher((String(F("mailbox ")) + mb).c_str());
+    const AppLogMatcher id_matcher((String(F("id=")) + mb).c_str());
+
+    // Start time, for skipping by index. Missing parts of the time are taken from the start of the period
+    time_t from_time = 0;
+    if (from.length()) {
+      char from_str[] = "0000/01/01 00:00:00";
+      memcpy(from_str, from.c_str(), from.length());
+      from_time = appLogLineTime(from_str, sizeof(from_str) - 1);
+    }
+
+    web_page += F("<span style=\"font-family: monospace;\">\n");
+    const auto ms = millis();
+    size_t matches = 0, lines = 0;
+    bool past_to = false;
+    for (const auto rotated : {true, false}) {
+      if (past_to)
+        break;
+      auto log_file = fs.open(rotated ? APP_LOG_FILE_NAME2 : APP_LOG_FILE_NAME, "r");
+      if (!log_file)
+        continue;
+      const auto start = from_time ? appLogOffsetByTime(rotated ? APP_LOG_INDEX_NAME2 : APP_LOG_INDEX_NAME, log_file.size(), from_time - 1) : 0;
+      AppLogReader reader(log_file, start);
+      while (matches < APP_LOG_SEARCH_MATCHES_MAX && reader.next()) {
+        if (!(++lines % 256))
+          yield();   // Relieve the system on large logs
+        const char *line = reader.line;
+        const auto len = reader.line_len;
+
+        // Lines without time (e.g., continuation lines) cannot match time limits. Lines are chronological, so the first
+        // line after "to" ends the search
+        if (from.length() && (!appLogLineTime(line, len) || strncmp(line, from.c_str(), from.length()) < 0))
+          continue;
+        if (to.length()) {
+          if (!appLogLineTime(line, len))
+            continue;
+          if (strncmp(line, to.c_str(), to.length()) > 0) {
+            past_to = true;
+            break;
+          }
+        }
+        if (q.length() && !q_matcher.find(line, len))
+          continue;
+        if (mb.length() && !appLogLineHasMailBox(mb_matcher, line, len) && !appLogLineHasMailBox(id_matcher, line, len))
+          continue;
+
+        // Link the line to its log page
+        const auto t = appLogLineTime(line, len);
+        if (t) {
+          web_page += F("<br/><a href=\"/log?t=");
+          web_page += t;
+          web_page += F("\">");
+          web_page.write((const uint8_t *)line, 19);
+          web_page += F("</a>");
+          web_page.write((const uint8_t *)line + 19, len - 19);
+        } else {
+          web_page += F("<br/>");
+          web_page.write((const uint8_t *)line, len);
+        }
+        web_page += '\n';
+        matches++;
+      }
+      log_file.close();
+    }
+    web_page += F("</span>\n<hr/>");
+    web_page += matches;
+    web_page += F(" line(s) found");
+    if (matches == APP_LOG_SEARCH_MATCHES_MAX)
+      web_page += F(" (limit reached; narrow the search)");
+    web_page += F(" in ");
+    web_page += millis() - ms;
+    web_page += F(" ms\n");
+#ifdef DS_CAP_SYS_LOG
+    log->printf(TIMED("Log search scanned %u line(s) in %lu ms\n"), (unsigned int)lines, millis() - ms);
+#endif // DS_CAP_SYS_LOG
+  }
+  pushHTMLFooter();
+  sendWebPage();
+}
 #endif // DS_CAP_APP_LOG
 
 // Send a web page
 void System::sendWebPage() {
+  const auto size = web_page.end();
 
 #ifdef DS_CAP_SYS_LOG
-  log->printf(TIMED("Serving webpage \""));
+  log->printf(TIMED("Served webpage \""));
   log->print(web_server.uri());
   log->print(F("\" to "));
-  log->println(web_server.client().remoteIP().toString());
+  log->print(web_server.client().remoteIP().toString());
+  log->printf(" (%zu B in %lu ms, min free heap %u B, max free block %u B)\n", size, web_page.getTime(), web_page.getHeapMin(), ESP.getMaxFreeBlockSize());
 #endif // DS_CAP_SYS_LOG
-
-  web_server.send(HTTP_CODE_OK, "text/html", web_page);
 }
 
 #endif // DS_CAP_WEBSERVER
@@ -1147,6 +1711,7 @@ void System::serveTimersSave() {
     }
   }
   timers.clear();
+  rescheduleTimers();
   abs_timers_active = false;
 
   // First, create all the timers
@@ -1385,7 +1950,7 @@ void System::buttonEventHandler(AceButton* button, uint8_t event_type, uint8_t b
 Timer::Timer(const timer_type_t _type, const String _action,
   const bool _armed, const bool _recurrent, const bool _transient, const int _id) :
   id(_id >= -1 ? _id : -1), type(_type >= 0 && _type <= TIMER_INVALID ? _type : TIMER_INVALID),
-  action(_action), armed(_armed), recurrent(_recurrent), transient(_transient) {}
+  action(_action), armed(_armed), recurrent(_recurrent), transient(_transient), callback(nullptr), context(nullptr) {}
 
 // Define pure virtual destructor (required by C++)
 Timer::~Timer() {
@@ -1467,6 +2032,21 @@ inline void Timer::forget() {
   transient = true;
 }
 
+// Set function to call on firing
+void Timer::setCallback(const timer_callback_t cb, void* ctx) {
+  callback = cb;
+  context = ctx;
+}
+
+// Call back on firing. Returns false if timer has no callback
+//// Typed callback with context spares the handler from parsing timer action and looking up its owner
+bool Timer::fire() const {
+  if (!callback)
+    return false;
+  callback(this, context);
+  return true;
+}
+
 // Abstract timer comparison operator
 bool Timer::operator==(const Timer& timer) const {
   return type == timer.getType() && id == timer.getID() && action == timer.getAction();
@@ -1486,9 +2066,91 @@ bool Timer::operator!=(const Timer& timer) const {
  *************************************************************************/
 #ifdef DS_CAP_TIMERS_ABS
 
+#include <algorithm>                // std::push_heap(), ...
+#include <functional>               // std::greater
+
 bool System::abs_timers_active = true;               // Activate timers
 std::forward_list<TimerAbsolute *> System::timers;
 void (*System::timerHandler)(const TimerAbsolute* /* timer */) __attribute__ ((weak)) = nullptr;
+std::vector<System::timer_queue_entry_t> System::timer_queue;
+time_t System::timer_queue_time = 0;
+TimerAbsolute* System::timer_firing = nullptr;
+
+// Register a timer
+void System::addTimer(TimerAbsolute* timer) {
+  if (!timer)
+    return;
+  timers.push_front(timer);
+  if (timer_queue_time)
+    scheduleTimer(timer, timer_queue_time + 1);
+}
+
+// Unregister a timer
+void System::removeTimer(TimerAbsolute* timer) {
+  timers.remove(timer);
+  timer_queue.erase(std::remove_if(timer_queue.begin(), timer_queue.end(),
+    [timer](const timer_queue_entry_t& e) { return e.second == timer; }), timer_queue.end());
+  std::make_heap(timer_queue.begin(), timer_queue.end(), std::greater<timer_queue_entry_t>());
+  if (timer_firing == timer)
+    timer_firing = nullptr;
+}
+
+// Recalculate firing times of all timers (needed after changing timer settings)
+//// Queue is rebuilt on the next second, when the current time is known
+void System::rescheduleTimers() {
+  timer_queue.clear();
+  timer_queue_time = 0;
+}
+
+// Put timer into the queue
+void System::scheduleTimer(TimerAbsolute* timer, const time_t from) {
+  const auto next = timer->getNextFiring(from);
+  if (next) {
+    timer_queue.push_back({next, timer});
+    std::push_heap(timer_queue.begin(), timer_queue.end(), std::greater<timer_queue_entry_t>());
+  }
+}
+
+// Fire timers due at a given time
+//// Timers are kept in a min-heap by next firing time, so a second with nothing due costs O(1), and each firing costs O(log n).
+//// Disarmed timers stay in the queue, so that they can be armed at any time
+void System::fireTimers(const time_t t) {
+
+  // Any time jump (sync, manual change, stalled loop) invalidates firing times. As before, skipped seconds are not caught up
+  if (!timer_queue_time || t != timer_queue_time + 1) {
+    timer_queue.clear();
+    for (auto timer : timers)
+      if (timer)
+        scheduleTimer(timer, t);
+  }
+  timer_queue_time = t;
+
+  while (!timer_queue.empty() && timer_queue.front().first <= t) {
+    std::pop_heap(timer_queue.begin(), timer_queue.end(), std::greater<timer_queue_entry_t>());
+    const auto timer = timer_queue.back().second;
+    timer_queue.pop_back();
+    if (timer->getType() == TIMER_INVALID)
+      continue;
+    if (timer->isArmed() && *timer == tm_time) {
+#ifdef DS_CAP_SYS_LOG
+      log->printf(TIMED("Timer \"%s\" fired\n"), timer->getAction().c_str());
+#endif // DS_CAP_SYS_LOG
+      timer_firing = timer;
+      if (!timer->fire() && timerHandler)
+        timerHandler(timer);
+      if (!timer_firing)
+        continue;   // Handler unregistered the timer
+      timer_firing = nullptr;
+      if (timer->getType() == TIMER_INVALID || timer->isTransient()) {
+        timers.remove(timer);
+        continue;
+      }
+      if (!timer->isRecurrent())
+        timer->disarm();
+    }
+    scheduleTimer(timer, t + 1);
+  }
+}
 
 // struct tm (re)use:
 //   int tm_sec;    - timer firing second (0..59)
@@ -1562,6 +2224,28 @@ void TimerAbsolute::disableDayOfWeek(const uint8_t new_dow) {
   time.tm_wday &= new_dow < TIMER_DOW_INVALID ? ~new_dow : ~TIMER_DOW_NONE;
 }
 
+// Return the nearest firing time not earlier than a given time (0 == never)
+//// Firing time is matched in local time, so a week ahead is enough to find it
+time_t TimerAbsolute::getNextFiring(const time_t from) {
+  const auto dow = getDayOfWeek();
+  if (!(dow & TIMER_DOW_ANY))
+    return 0;
+  struct tm tm_from;
+  localtime_r(&from, &tm_from);
+  for (uint8_t day = 0; day <= 7; day++) {
+    struct tm tm_next = tm_from;
+    tm_next.tm_mday += day;
+    tm_next.tm_hour = getHour();
+    tm_next.tm_min = getMinute();
+    tm_next.tm_sec = getSecond();
+    tm_next.tm_isdst = -1;
+    const auto next = mktime(&tm_next);
+    if (next >= from && 1 << tm_next.tm_wday & dow)
+      return next;
+  }
+  return 0;
+}
+
 // Return absolute timer with a matching ID
 TimerAbsolute* System::getTimerAbsByID(const int id) {
   auto it = std::find_if(timers.begin(), timers.end(), [=](const Timer *timer) { return timer && timer->getID() == id; } );
@@ -1768,6 +2452,7 @@ void TimerCountdownAbs::setOffset(const uint32_t offset) {
 }
 
 // Prepare timer for firing
+//// Firing time of day is taken from the local time of the next firing, so that the countdown keeps matching the clock across DST changes
 void TimerCountdownAbs::update(const time_t from_time) {
   const uint32_t interval = getInterval();
   auto next_time = getNextTime();
@@ -1775,33 +2460,34 @@ void TimerCountdownAbs::update(const time_t from_time) {
   if (next_time > cur_time && next_time - cur_time < (int) interval)
     return;     // Countdown goes as planned
 
-  if (next_time == cur_time) {     // Timer fired
-    setNextTime(next_time + interval);
-    auto next = getSecond() + interval;
-    setSecond(next % 60);
-    auto leap = next / 60;
-    next = getMinute() + leap;
-    setMinute(next % 60);
-    leap = next / 60;
-    setHour((getHour() + leap) % 24);
-    return;
+  if (next_time == cur_time)       // Timer fired
+    next_time += interval;
+  else {
+
+    // Otherwise we are out of sync and need to rebase the timer
+    const auto offset = getOffset();
+    struct tm tm_ref;
+    localtime_r(&cur_time, &tm_ref);
+    tm_ref.tm_hour = offset / (60 * 60);
+    tm_ref.tm_min = (offset - 60 * 60 * tm_ref.tm_hour) / 60;
+    tm_ref.tm_sec = offset % 60;
+    next_time = cur_time + interval - abs(cur_time - mktime(&tm_ref)) % interval;
   }
+  setNextTime(next_time);
+  struct tm tm_next;
+  localtime_r(&next_time, &tm_next);
+  setHour(tm_next.tm_hour);
+  setMinute(tm_next.tm_min);
+  setSecond(tm_next.tm_sec);
+}
 
-  // Otherwise we are out of sync and need to rebase the timer
-  const auto offset = getOffset();
-  struct tm tm_now, tm_ref;
-  localtime_r(&cur_time, &tm_now);
-  tm_ref = tm_now;
-  tm_ref.tm_hour = offset / (60 * 60);
-  tm_ref.tm_min = (offset - 60 * 60 * tm_ref.tm_hour) / 60;
-  tm_ref.tm_sec = offset % 60;
-  const auto tdiff = interval - abs(cur_time - mktime(&tm_ref)) % interval;
-  setNextTime(cur_time + tdiff);
-  setSecond((tm_now.tm_sec + tdiff) % 60);
-  auto leap = (tm_now.tm_sec + tdiff) / 60;
-  setMinute((tm_now.tm_min + leap) % 60);
-  leap = (tm_now.tm_min + leap) / 60;
-  setHour((tm_now.tm_hour + leap) % 24);
+// Return the nearest firing time not earlier than a given time (0 == never)
+//// Days of week are checked on firing, as walking a short countdown over the disabled days would take long
+time_t TimerCountdownAbs::getNextFiring(const time_t from) {
+  if (!(getDayOfWeek() & TIMER_DOW_ANY))
+    return 0;
+  update(from - 1);
+  return getNextTime();
 }
 
 // Countdown timer comparison operator
@@ -2064,12 +2750,15 @@ void System::begin() {
         app_log = fs.open(APP_LOG_FILE_NAME, "a");
         app_log_ok = app_log;
         if (app_log_ok) {
-          app_log_size = app_log.size();
+          app_log_size = app_log_pos = app_log.size();
+          app_log_index_next = appLogIndexOpen(APP_LOG_FILE_NAME, APP_LOG_INDEX_NAME, app_log_pos);
+          app_log_index = fs.open(APP_LOG_INDEX_NAME, "a");
           if (fs.exists(APP_LOG_FILE_NAME2)) {
             auto app_log2 = fs.open(APP_LOG_FILE_NAME2, "r");
             app_log_ok = app_log2;
             if (app_log_ok) {
               app_log_size += app_log2.size();
+              appLogIndexOpen(APP_LOG_FILE_NAME2, APP_LOG_INDEX_NAME2, app_log2.size());
               app_log2.close();
             } else
               app_log.close();
@@ -2121,7 +2810,6 @@ void System::begin() {
 #ifdef DS_CAP_SYS_LOG
   log->printf(TIMED("Starting web server... "));
 #endif // DS_CAP_SYS_LOG
-  web_page.reserve(MAX_WEB_PAGE_SIZE);
 
   // Quite counter-intuitively, web server calls the first suitable handler in order of registration, not the last one registered.
   // So register user handlers first, so that they override system handlers
@@ -2131,6 +2819,7 @@ void System::begin() {
   web_server.on("/about", serveAbout);
 #ifdef DS_CAP_APP_LOG
   web_server.on("/log", serveAppLog);
+  web_server.on("/log/search", serveAppLogSearch);
 #endif // DS_CAP_APP_LOG
 #ifdef DS_CAP_WEB_TIMERS
   web_server.on("/timers", serveTimers);
@@ -2159,20 +2848,30 @@ void System::begin() {
 void System::update() {
 
 #ifdef DS_CAP_APP_LOG
-  if (app_log_size_max && app_log_size >= app_log_size_max) {
+  if (app_log_buffer_len && millis() - app_log_buffer_time >= APP_LOG_FLUSH_INTERVAL)
+    appLogFlush();
+  // Each of the two log files takes up to half of the max size, so that the rotated file never triggers another rotation
+  if (app_log_size_max && app_log_pos >= app_log_size_max / 2) {
     bool rotation_ok = true;
 #ifdef DS_CAP_SYS_LOG
     log->printf(TIMED("Max application log size (%zu) reached, rotating...\n"), app_log_size_max);
 #endif // DS_CAP_SYS_LOG
+    appLogFlush();
     app_log_size = app_log.size();
     app_log.close();
+    app_log_index.close();
     if (fs.exists(APP_LOG_FILE_NAME2))
       rotation_ok = fs.remove(APP_LOG_FILE_NAME2);     // Rename will fail if file exists
+    fs.remove(APP_LOG_INDEX_NAME2);
     if (rotation_ok) {
       rotation_ok = fs.rename(APP_LOG_FILE_NAME, APP_LOG_FILE_NAME2);
       if (rotation_ok) {
+        fs.rename(APP_LOG_INDEX_NAME, APP_LOG_INDEX_NAME2);
         app_log = fs.open(APP_LOG_FILE_NAME, "a");
         rotation_ok = app_log;
+        app_log_index = fs.open(APP_LOG_INDEX_NAME, "w");
+        app_log_pos = 0;
+        app_log_index_next = 0;
       }
     }
     if (!rotation_ok) {
@@ -2227,6 +2926,7 @@ void System::update() {
       for (auto timer : timers)
         if (timer && (timer->getType() == TIMER_SUNRISE || timer->getType() == TIMER_SUNSET))
           static_cast<TimerSolar *>(timer)->adjust();
+      rescheduleTimers();
 #ifdef DS_CAP_SYS_LOG
       log->println(F("OK"));
 #endif // DS_CAP_SYS_LOG
@@ -2235,26 +2935,7 @@ void System::update() {
 
     // Process timers
     if (abs_timers_active && time_sync_status != TIME_SYNC_NONE)
-      for (auto timer : timers) {
-        if (timer && timer->getType() != TIMER_INVALID && timer->isArmed() && *timer == tm_time) {
-#ifdef DS_CAP_SYS_LOG
-          log->printf(TIMED("Timer \"%s\" fired\n"), timer->getAction().c_str());
-#endif // DS_CAP_SYS_LOG
-          if (timerHandler)
-            timerHandler(timer);
-          if (timer->getType() == TIMER_INVALID || timer->isTransient()) {
-            timers.remove(timer);
-            continue;
-          }
-          if (!timer->isRecurrent())
-            timer->disarm();
-        }
-#ifdef DS_CAP_TIMERS_COUNT_ABS
-        if (timer->getType() == TIMER_COUNTDOWN_ABS) {
-          static_cast<TimerCountdownAbs *>(timer)->update(time);
-        }
-#endif // DS_CAP_TIMERS_COUNT_ABS
-      }
+      fireTimers(time);
   }
 #endif // DS_CAP_TIMERS_ABS
 
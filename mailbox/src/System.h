@@ -119,6 +119,10 @@
 #include <forward_list>             // Timer or action list
 #endif // DS_CAP_TIMERS_ABS || DS_CAP_WEB_TIMERS
 
+#ifdef DS_CAP_TIMERS_ABS
+#include <vector>                   // Timer queue
+#endif // DS_CAP_TIMERS_ABS
+
 #ifdef DS_CAP_TIMERS_COUNT_TICK
 #include <Ticker.h>                 // Periodic events
 #endif // DS_CAP_TIMERS_COUNT_TICK
@@ -152,6 +156,9 @@ namespace ds {
     TIMER_INVALID                                     // Unsupported timer type (must be the last)
   } timer_type_t;
 
+  class Timer;
+  typedef void (*timer_callback_t)(const Timer* /* timer */, void* /* context */); // Timer firing callback
+
   class Timer {                                       // Generic timer (abstract)
 
     protected:
@@ -161,6 +168,8 @@ namespace ds {
       bool armed;                                     // True if timer is armed (will fire); false if ignored with no action
       bool recurrent;                                 // True if timer should be auto-rearmed after firing; false otherwise
       bool transient;                                 // True if timer should be disposed of after firing
+      timer_callback_t callback;                      // Function to call on firing (nullptr == use System::timerHandler)
+      void *context;                                  // Context passed to the callback (e.g., object owning the timer)
 
       void setType(const timer_type_t /* type */);    // Set timer type
 
@@ -182,6 +191,8 @@ namespace ds {
       virtual bool isTransient() const;               // Return true if timer is transient (i.e., will be dead after firing)
       virtual void keep();                            // Keep the timer around (default)
       virtual void forget();                          // Mark the timer for disposal
+      virtual void setCallback(const timer_callback_t /* cb */, void* ctx = nullptr); // Set function to call on firing
+      virtual bool fire() const;                      // Call back on firing. Returns false if timer has no callback
       bool operator==(const Timer& /* timer */) const; // Comparison operator
       bool operator!=(const Timer& /* timer */) const; // Comparison operator
   };
@@ -221,6 +232,7 @@ namespace ds {
       virtual void setDayOfWeek(const uint8_t /* new_dow */); // Set day of week setting
       virtual void enableDayOfWeek(const uint8_t /* new_dow */); // Enable some day(s) of week
       virtual void disableDayOfWeek(const uint8_t /* new_dow */); // Disable some day(s) of week
+      virtual time_t getNextFiring(const time_t /* from */); // Return the nearest firing time not earlier than a given time (0 == never)
       bool operator==(const TimerAbsolute& /* timer */) const; // Comparison operator
       bool operator!=(const TimerAbsolute& /* timer */) const; // Comparison operator
       bool operator==(const struct tm& /* _tm */) const; // Time comparison operator
@@ -275,6 +287,7 @@ namespace ds {
       virtual uint32_t getOffset() const;             // Return timer offset in seconds from midnight
       virtual void setOffset(const uint32_t /* offset */); // Set timer offset in seconds from midnight
       virtual void update(const time_t from_time = 0); // Prepare timer for firing. 0 means from current time
+      virtual time_t getNextFiring(const time_t /* from */); // Return the nearest firing time not earlier than a given time (0 == never)
       bool operator==(const TimerCountdownAbs& /* timer */) const; // Comparison operator
       bool operator!=(const TimerCountdownAbs& /* timer */) const; // Comparison operator
   };
@@ -300,6 +313,36 @@ namespace ds {
   };
 #endif // DS_CAP_TIMERS_COUNT_TICK
 
+#ifdef DS_CAP_WEBSERVER
+  class WebPage : public Print {                      // Web page writer; page is sent in HTTP chunks while being generated
+
+    public:
+      static const size_t BUFFER_SIZE = 1024;         // Chunk buffer size (B)
+
+    protected:
+      char buffer[BUFFER_SIZE];                       // Chunk buffer
+      size_t buffer_len;                              // Amount of data in the buffer (B)
+      size_t sent;                                    // Amount of data sent (B)
+      const char *content_type;                       // Content type of the page
+      int code;                                       // HTTP response code
+      bool started;                                   // True if HTTP headers have been sent
+      uint32_t heap_min;                              // Lowest free heap seen while sending (B)
+      unsigned long t_begin;                          // Time the page was started (ms from boot)
+
+    public:
+      WebPage() : buffer_len(0), sent(0), content_type(nullptr), code(0), started(false), heap_min(0), t_begin(0) {} // Constructor
+      void begin(const char *_content_type = "text/html"); // Start a new page
+      void setCode(const int /* _code */);            // Set HTTP response code (before the first chunk is sent)
+      virtual size_t write(uint8_t /* c */) override; // Append a byte
+      virtual size_t write(const uint8_t* /* data */, size_t /* len */) override; // Append data
+      virtual void flush() override;                  // Send buffered data as a chunk
+      size_t end();                                   // Complete the page. Returns the page size
+      uint32_t getHeapMin() const;                    // Return the lowest free heap seen while sending
+      unsigned long getTime() const;                  // Return time spent on the page so far (ms)
+      template <typename T> WebPage& operator+=(const T& x) { print(x); return *this; } // Append anything printable (String-compatible interface)
+  };
+#endif // DS_CAP_WEBSERVER
+
   // System class is just a collection of system-wide routines, so all of them are made static on purpose
   class System {
 
@@ -332,6 +375,7 @@ namespace ds {
       static size_t app_log_size_max;                 // Maximum size of application log. Setting this to 0 disables log at runtime
 
       static bool appLogWriteLn(const String& /* line */, bool copy_to_syslog = false); // Write a line into application log, optionally copying to syslog
+      static bool appLogFlush();                      // Write buffered application log lines to disk
 #endif // DS_CAP_APP_LOG
 
 #ifdef DS_CAP_SYS_LED
@@ -432,6 +476,7 @@ namespace ds {
       static void serveAbout();                       // Serve the "about" page
 #ifdef DS_CAP_APP_LOG
       static void serveAppLog();                      // Serve the "log" page
+      static void serveAppLogSearch();                // Serve the "log search" page
 #endif // DS_CAP_APP_LOG
 #ifdef DS_CAP_WEB_TIMERS
       static void serveTimers();                      // Serve the "timers" page
@@ -440,7 +485,7 @@ namespace ds {
 
     public:
       static ESP8266WebServer web_server;             // Web server
-      static String web_page;                         // Web page buffer
+      static WebPage web_page;                        // Web page writer
       static void pushHTMLHeader(const String& title = "", const String& head_user = "", bool redirect = false);  // Add standard header to the web page
       static void pushHTMLFooter();                   // Add standard footer to the web page
       static void (*registerWebPages)();              // Hook for registering user-supplied pages
@@ -461,9 +506,20 @@ namespace ds {
 #endif // DS_CAP_BUTTON
 
 #ifdef DS_CAP_TIMERS_ABS
+    protected:
+      typedef std::pair<time_t, TimerAbsolute *> timer_queue_entry_t; // Timer queue entry (next firing time, timer)
+      static std::vector<timer_queue_entry_t> timer_queue; // Timers ordered by next firing time (min-heap)
+      static time_t timer_queue_time;                 // Time the queue was last served (0 == queue needs rebuilding)
+      static TimerAbsolute* timer_firing;             // Timer being fired (nullptr if it has been removed while firing)
+      static void scheduleTimer(TimerAbsolute* /* timer */, const time_t /* from */); // Put timer into the queue
+      static void fireTimers(const time_t /* t */);   // Fire timers due at a given time
+
     public:
       static bool abs_timers_active;                  // True if absolute or solar timers should be served
-      static std::forward_list<TimerAbsolute *> timers; // List of timers
+      static std::forward_list<TimerAbsolute *> timers; // List of timers. Use addTimer() / removeTimer() to modify
+      static void addTimer(TimerAbsolute* /* timer */); // Register a timer
+      static void removeTimer(TimerAbsolute* /* timer */); // Unregister a timer
+      static void rescheduleTimers();                 // Recalculate firing times of all timers (needed after changing timer settings)
       static TimerAbsolute* getTimerAbsByID(const int /* id */); // Return absolute timer with a matching ID
       static void (*timerHandler)(const TimerAbsolute* /* timer */); // Timer handler
 #endif // DS_CAP_TIMERS_ABS
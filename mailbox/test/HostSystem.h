@@ -0,0 +1,26 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * System capabilities for host builds (replaces MySystem.h)
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_HOSTSYSTEM_H_
+#define _DS_HOSTSYSTEM_H_
+
+// Local module without hardware-only capabilities (button, Wi-Fi manager, mDNS)
+#define DS_CAP_APP_ID       // Enable application identification
+#define DS_CAP_APP_LOG      // Enable application log
+#define DS_CAP_SYS_LED      // Enable builtin LED
+#define DS_CAP_SYS_LOG      // Enable syslog
+#define DS_CAP_SYS_TIME     // Enable system time
+#define DS_CAP_SYS_UPTIME   // Enable system uptime counter
+#define DS_CAP_SYS_FS       // Enable file system
+#define DS_CAP_SYS_NETWORK  // Enable networking
+#define DS_CAP_WEBSERVER    // Enable web server
+#define DS_CAP_TIMERS_COUNT_ABS // Enable countdown timers via absolute time
+
+#define DS_TIMEZONE TZ_Etc_UTC
+
+#include "../src/System.h"  // Defines _DS_SYSTEM_H_, so MySystem.h is skipped
+
+#endif // _DS_HOSTSYSTEM_H_
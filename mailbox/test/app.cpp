@@ -0,0 +1,17 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Global objects of the local module (as in local.ino.h)
+ * (c) DNS 2020-2023
+ */
+
+#include "../MailBoxManager.h"   // Mailbox manager
+#include "../MailBoxDB.h"        // Mailbox database
+#include "../GoogleAssistant.h"  // Google interface
+#include "../WebEvents.h"        // Web events
+
+using namespace ds;
+
+MailBoxManager mailbox_manager;                  // Mailbox manager
+MailBoxDB mailbox_db;                            // Mailbox database
+GoogleAssistant google_assistant;                // Google interface
+WebEvents web_events;                            // Web events
@@ -0,0 +1,1206 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Benchmarks
+ * (c) DNS 2020-2023
+ */
+
+#include "fake/fake.h"
+#include <chrono>
+#include <forward_list>
+#include <memory>
+#include <new>
+#include <set>
+#include <malloc.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "../Receiver.h"
+#include "../BatteryEstimator.h"
+#include "../BatteryHistory.h"
+#include "../MailBoxManager.h"
+#include "../MailBoxDB.h"
+#include "../EventHistory.h"
+#include "../WebEvents.h"
+#include <LittleFS.h>
+#include <TZ.h>
+
+using namespace ds;
+
+// Access to the timer queue
+struct HostSystem : System {
+  using System::fireTimers;
+  typedef ESP8266WebServer::args_t args_t;
+};
+
+extern MailBoxManager mailbox_manager;
+extern WebEvents web_events;
+
+// Heap allocation counter, heap in use and its peak (not inlined, as GCC would then see malloc() paired with delete)
+static unsigned long allocations = 0;
+static size_t heap_used = 0, heap_peak = 0;
+__attribute__((noinline)) void *operator new(size_t size) {
+  allocations++;
+  if (const auto p = malloc(size ? size : 1)) {
+    heap_used += malloc_usable_size(p);
+    if (heap_used > heap_peak)
+      heap_peak = heap_used;
+    return p;
+  }
+  throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+  heap_used -= malloc_usable_size(p);
+  free(p);
+}
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+
+// Output discarding the data
+class Null : public Print {
+  public:
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t*, size_t size) override { return size; }
+};
+static Null null;
+
+// Stream collecting the data sent
+class Sink : public Stream {
+  public:
+    std::string data;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    using Print::write;
+    size_t write(uint8_t c) override { data += (char)c; return 1; }
+};
+
+// Deterministic pseudo-random numbers
+static uint32_t rnd(const uint32_t max) {
+  static uint32_t state = 12345;
+  state = state * 1103515245 + 12345;
+  return (state >> 8) % max;
+}
+
+// Encode a message as it would go on air
+static std::string frame(const uint8_t version, const uint16_t num, const uint8_t mb_id, const bool fec = false) {
+  MailBoxMessage msg;
+  msg.init(1);
+  msg[0] = version | 1 << 4;
+  msg.setMailBoxID(mb_id);
+  msg.setMessageNumber(num);
+  msg.terminate();
+  Sink out;
+  if (fec)
+    msg.sendFEC(out);
+  else
+    msg.send(out);
+  return out.data;
+}
+
+// Wall clock time (ns)
+static double now_ns() {
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/*************************************************************************
+ * Receiver: idle loop() pass and input ingestion
+ *************************************************************************/
+static void benchReceiver() {
+  System::log = &null;
+  Receiver rx(Serial1);
+  rx.begin();
+
+  // Idle pass, as in every loop() without radio input
+  const unsigned int N = 1000000;
+  auto allocations0 = allocations;
+  auto t_begin = now_ns();
+  for (unsigned int i = 0; i < N; i++)
+    rx.update();
+  const double idle_ns = (now_ns() - t_begin) / N;
+  const double idle_allocations = (double)(allocations - allocations0) / N;
+
+  // Stream of valid frames
+  const unsigned int M = 20000;
+  std::string data;
+  for (unsigned int i = 0; i < M; i++) {
+    data += frame(PROTO_VERSION, i, 1 + i % 15);
+  }
+
+  printf("Receiver: idle loop() pass: %.1f ns, %.2f allocation(s)\n", idle_ns, idle_allocations);
+  printf("  %u message(s), %zu B of input:\n", M, data.size());
+  for (const size_t chunk : {(size_t)1, (size_t)SIZE_MAX}) {
+    Serial1.read_chunk = chunk;
+    unsigned int received = 0;
+    allocations0 = allocations;
+    t_begin = now_ns();
+    for (size_t pos = 0; pos < data.size(); pos += 32) {   // Input arrives in portions of 4 frames, as much as the queue takes
+      Serial1.inject((const uint8_t *)data.data() + pos, std::min((size_t)32, data.size() - pos));
+      rx.update();
+      while (rx.messageAvailable()) {
+        rx.getMessage();
+        received++;
+      }
+    }
+    const double byte_ns = (now_ns() - t_begin) / data.size();
+    printf("  %s: %u received, %.1f ns per byte, %.2f allocation(s) per message\n",
+      chunk == 1 ? "byte per read()" : "bulk read()    ", received, byte_ns, (double)(allocations - allocations0) / M);
+  }
+  Serial1.read_chunk = SIZE_MAX;
+}
+
+// Frames following bursts of random noise
+static void benchResync() {
+  System::log = &null;
+  Receiver rx(Serial1);
+  rx.begin();
+  const unsigned int N = 20000;
+  printf("Receiver resync: %u frame(s), each after 1-24 B of random noise\n", N);
+  for (const auto version : {PROTO_VERSION_XOR, PROTO_VERSION_CRC8}) {
+    unsigned int recovered = 0, false_messages = 0;
+    for (unsigned int i = 0; i < N; i++) {
+      std::string data;
+      for (auto n = 1 + rnd(24); n; n--)
+        data += (char)rnd(256);
+      data += frame(version, i, 3);
+      Serial1.inject((const uint8_t *)data.data(), data.size());
+      rx.update();
+      while (rx.messageAvailable()) {
+        const auto msg = rx.getMessage();
+        if (msg.getMessageNumber() == i && msg.getMailBoxID() == 3)
+          recovered++;
+        else
+          false_messages++;
+      }
+    }
+    printf("  v%hhu: %.2f%% recovered, %u false message(s) from noise\n", version, 100.0 * recovered / N, false_messages);
+  }
+}
+
+
+/*************************************************************************
+ * Checksums: XOR vs CRC-8
+ *************************************************************************/
+static void benchChecksum() {
+  const unsigned int N = 1000000;
+  printf("Checksums: undetected errors in %u random frame(s) per error pattern\n", N);
+  printf("  pattern             v2 (XOR)     v3 (CRC-8)\n");
+  const struct { const char *name; unsigned int bits; bool burst; } patterns[] = {
+    {"2 random bits    ", 2, false}, {"4 random bits    ", 4, false}, {"8 random bits    ", 8, false},
+    {"random bits      ", 0, false}, {"burst <= 8 bits* ", 8, true}, {"burst <= 16 bits*", 16, true}
+  };
+  const unsigned int bits = 8 * MESSAGE_SIZE;
+  for (const auto& pattern : patterns) {
+    printf("  %s", pattern.name);
+    for (const auto version : {PROTO_VERSION_XOR, PROTO_VERSION_CRC8}) {
+      unsigned long missed = 0;
+      for (unsigned int i = 0; i < N; i++) {
+        byte data[MESSAGE_SIZE];
+        data[0] = version | 1 << 4;
+        for (unsigned int b = 1; b < sizeof(data); b++)
+          data[b] = rnd(256);
+        MailBoxMessage msg;
+        msg.load(data, sizeof(data));
+        msg.terminate();
+
+        // Error mask outside the version nibble
+        byte mask[MESSAGE_SIZE] = {};
+        if (pattern.burst) {
+          const auto len = 2 + rnd(pattern.bits - 1);          // First and last bits of a burst are flipped
+          const auto start = 4 + rnd(bits - 4 - len + 1);
+          for (unsigned int b = start; b < start + len; b++)
+            if (b == start || b == start + len - 1 || rnd(2))
+              mask[b / 8] |= 1 << b % 8;
+        } else if (pattern.bits)
+          for (unsigned int n = 0; n < pattern.bits; ) {
+            const auto b = 4 + rnd(bits - 4);
+            if (!(mask[b / 8] & 1 << b % 8)) {
+              mask[b / 8] |= 1 << b % 8;
+              n++;
+            }
+          }
+        else {
+          for (unsigned int b = 0; b < sizeof(mask); b++)
+            mask[b] = rnd(256);
+          mask[0] &= 0xf0;
+          if (!*(uint64_t *)mask)
+            continue;
+        }
+        for (unsigned int b = 0; b < sizeof(data); b++)
+          msg[b] ^= mask[b];
+        if (msg.checksumOK())
+          missed++;
+      }
+      printf("  %9.5f%%", 100.0 * missed / N);
+    }
+    printf("\n");
+  }
+  printf("  * contiguous in the order bits go on air (UART sends LSB first)\n");
+
+  // Cost of finalizing and verifying a message
+  const unsigned int M = 10000000;
+  printf("  terminate() + checksumOK():");
+  for (const auto version : {PROTO_VERSION_XOR, PROTO_VERSION_CRC8}) {
+    MailBoxMessage msg;
+    msg.init(1);
+    msg[0] = version | 1 << 4;
+    unsigned int ok = 0;
+    const auto t_begin = now_ns();
+    for (unsigned int i = 0; i < M; i++) {
+      msg.setMessageNumber(i);
+      msg.terminate();
+      ok += msg.checksumOK();
+    }
+    printf(" v%hhu %.1f ns%s", version, (now_ns() - t_begin) / M, ok == M ? "" : " (FAILED)");
+  }
+  printf("\n");
+}
+
+
+/*************************************************************************
+ * Forward error correction: delivery over a channel with random bit errors
+ *************************************************************************/
+static void benchFEC() {
+  System::log = &null;
+  Receiver rx(Serial1);
+  rx.begin();
+  const unsigned int N = 20000;
+  printf("FEC: %u v3 frame(s) over a channel with independent bit errors\n", N);
+  printf("  BER       delivered plain   delivered FEC   false messages plain/FEC\n");
+  for (const double ber : {1e-4, 1e-3, 5e-3, 1e-2, 2e-2, 5e-2}) {
+    printf("  %-8g", ber);
+    unsigned int false_messages[2] = {};
+    for (const auto fec : {false, true}) {
+      unsigned int delivered = 0;
+      for (unsigned int i = 0; i < N; i++) {
+        auto data = frame(PROTO_VERSION_CRC8, i, 3, fec);
+        for (auto& c : data)
+          for (unsigned int b = 0; b < 8; b++)
+            if (rnd(1000000) < ber * 1000000)
+              c ^= 1 << b;
+        Serial1.inject((const uint8_t *)data.data(), data.size());
+        rx.update();
+        fake::advance(5000);                     // Frames are seconds apart, so incomplete input times out in between
+        rx.update();
+        while (rx.messageAvailable()) {
+          const auto msg = rx.getMessage();
+          if (msg.getMessageNumber() == i && msg.getMailBoxID() == 3)
+            delivered++;
+          else
+            false_messages[fec]++;
+        }
+      }
+      printf("  %13.2f%%", 100.0 * delivered / N);
+    }
+    printf("   %u/%u\n", false_messages[0], false_messages[1]);
+  }
+}
+
+
+/*************************************************************************
+ * Redundant transmission: delivery with message copies and random gaps
+ *************************************************************************/
+static void benchRepeats() {
+
+  // Link model, as in Transmitter: copies RF_PACKET_INTERVAL + random(RF_PACKET_JITTER) apart; 8 B frame at 500 bps takes 128 ms on air
+  const unsigned int INTERVAL = 2000, AIR_TIME = 8 * 8 * 1000 / 500;
+  const unsigned int N = 200000;
+  printf("Redundant transmission: %u message(s) per case; delivered (duplicates per delivered message)\n", N);
+  printf("  copies jitter   20%% frame loss      2 mailboxes at once   both\n");
+  for (const unsigned int repeats : {1, 2, 3})
+    for (const unsigned int jitter : {0, 500}) {
+      if (repeats == 1 && jitter)
+        continue;
+      printf("  %-6u %-4u ms", repeats, jitter);
+      for (const auto scenario : {1, 2, 3}) {
+        const bool loss = scenario & 1, collisions = scenario & 2;
+        unsigned int delivered = 0, duplicates = 0;
+        for (unsigned int i = 0; i < N; i++) {
+
+          // Both mailboxes wake up on the same event, within 50 ms of each other
+          unsigned long t[2] = {0, rnd(50)};
+          unsigned long starts[2][3];
+          for (unsigned int k = 0; k < repeats; k++)
+            for (unsigned int m = 0; m < 2; m++) {
+              if (k)
+                t[m] += INTERVAL + (jitter ? rnd(jitter) : 0);
+              starts[m][k] = t[m];
+            }
+          unsigned int copies = 0;
+          for (unsigned int k = 0; k < repeats; k++) {
+            bool ok = !loss || rnd(100) >= 20;
+            if (collisions)
+              for (unsigned int j = 0; j < repeats; j++)
+                if (starts[0][k] < starts[1][j] + AIR_TIME && starts[1][j] < starts[0][k] + AIR_TIME)
+                  ok = false;
+            copies += ok;
+          }
+          if (copies) {
+            delivered++;
+            duplicates += copies - 1;
+          }
+        }
+        printf("%s%6.2f%% (%.2f)", scenario == 1 ? "   " : "     ", 100.0 * delivered / N, delivered ? (double)duplicates / delivered : 0);
+      }
+      printf("\n");
+    }
+}
+
+
+/*************************************************************************
+ * Battery estimate: noisy Vcc readings over a discharge
+ *************************************************************************/
+static void benchBattery() {
+
+  // Linear discharge over 2400 wakeups (8 months at 10 a day). Readings: +-15 mV noise; 1 of 10 is an outlier of up to +-20%
+  const unsigned int N = 2400, RUNS = 20;
+  const uint16_t VCC_000 = BatteryEstimator::VCC_REF_000, VCC_100 = BatteryEstimator::VCC_REF_100;
+  const uint8_t SAMPLES = BatteryEstimator::VCC_SAMPLES;
+  const char *names[] = {"single reading         ", "median of 5            ", "single reading + EWMA  ", "median of 5 + EWMA     "};
+  double error_sum[4] = {}, error_max[4] = {};
+  for (unsigned int run = 0; run < RUNS; run++) {
+    BatteryEstimator filters[4];
+    for (unsigned int i = 0; i < N; i++) {
+      const unsigned int cp = 10000 - 10000 * i / (N - 1);
+      const uint16_t vcc = VCC_000 + (VCC_100 - VCC_000) * cp / 10000;
+      uint16_t readings[SAMPLES];
+      for (auto& r : readings)
+        r = rnd(10) ? vcc - 15 + rnd(31) : vcc - vcc / 5 + rnd(2 * vcc / 5);
+      for (unsigned int f = 0; f < 4; f++) {
+        if (f < 2)
+          filters[f].setCP(BatteryEstimator::CP_UNKNOWN);    // No averaging
+        for (uint8_t s = 0; s < (f % 2 ? SAMPLES : 1); s++)
+          filters[f].addVcc(readings[s]);
+        filters[f].update();
+        const double error = fabs((double)filters[f].getCP() - cp) / 100;
+        error_sum[f] += error;
+        if (error > error_max[f])
+          error_max[f] = error;
+      }
+    }
+  }
+  printf("Battery estimate: %u discharge(s) over %u wakeups; error vs true level\n", RUNS, N);
+  for (unsigned int f = 0; f < 4; f++)
+    printf("  %s mean %5.2f%%, max %6.2f%%\n", names[f], error_sum[f] / N / RUNS, error_max[f]);
+
+  // Cost of an update
+  BatteryEstimator estimator;
+  const unsigned int M = 10000000;
+  const auto t_begin = now_ns();
+  for (unsigned int i = 0; i < M; i++) {
+    for (uint8_t s = 0; s < SAMPLES; s++)
+      estimator.addVcc(3700 + (i * 7 + s * 13) % 100);
+    estimator.update();
+  }
+  printf("  update with %hhu readings: %.1f ns\n", SAMPLES, (now_ns() - t_begin) / M);
+}
+
+
+/*************************************************************************
+ * Battery time to empty: prediction error over a discharge
+ *************************************************************************/
+static void benchDaysLeft() {
+
+  // Linear discharge from 100%, reported 4 times a day in whole percent with +-1% of noise
+  const unsigned int RUNS = 50;
+  const unsigned int days[] = {15, 30, 60, 120, 240, 360};
+  printf("Battery time to empty: %u run(s); mean (max) error of prediction vs true time to empty, by days since battery change\n", RUNS);
+  printf("  rate     ");
+  for (const auto d : days)
+    printf("%15s", ("day " + std::to_string(d)).c_str());
+  printf("\n");
+  for (const double rate : {0.2, 0.5, 1.0}) {
+    double error_sum[6] = {}, error_max[6] = {};
+    unsigned int predictions[6] = {};
+    for (unsigned int run = 0; run < RUNS; run++) {
+      BatteryHistory history;
+      const time_t t0 = 1700000000;
+      unsigned int d = 0;
+      for (unsigned int h = 0; h <= days[5] * 24; h += 6) {
+        const double level = 100 - rate * h / 24;
+        if (level < 1)
+          break;
+        const int reported = (int)(level + 0.5) + (int)rnd(3) - 1;
+        const uint8_t b = reported < 0 ? 0 : reported > 100 ? 100 : reported;
+        history.add(t0 + h * 3600, b);
+        if (h == days[d] * 24) {
+          const auto days_left = history.getDaysLeft(b);
+          if (days_left != BatteryHistory::DAYS_LEFT_UNKNOWN) {
+            const double error = fabs(days_left - level / rate) / (level / rate) * 100;
+            error_sum[d] += error;
+            error_max[d] = std::max(error_max[d], error);
+            predictions[d]++;
+          }
+          d++;
+        }
+      }
+    }
+    printf("  %.1f%%/day ", rate);
+    for (unsigned int d = 0; d < 6; d++)
+      if (predictions[d])
+        printf("  %5.1f%% (%3.0f%%)", error_sum[d] / predictions[d], error_max[d]);
+      else
+        printf("%15s", "-");
+    printf("\n");
+  }
+}
+
+
+/*************************************************************************
+ * Mailbox storage: boot load and flash writes per message
+ *************************************************************************/
+
+// Load mailboxes from per-mailbox text files, as the baseline did: probe every basic protocol ID
+static unsigned int loadFiles() {
+  unsigned int n = 0;
+  for (uint8_t id = MAILBOX_ID_MIN; id <= MAILBOX_ID_MAX_BASIC; id++) {
+    auto file = LittleFS.open(("/mailbox" + std::to_string(id) + ".cfg").c_str(), "r");
+    if (!file)
+      continue;
+    auto label = file.readStringUntil('\n');
+    label.trim();
+    file.parseInt();
+    file.parseInt();
+    file.parseInt();
+    file.close();
+    n++;
+  }
+  return n;
+}
+
+// Load mailboxes from the database
+static unsigned int loadDB() {
+  MailBoxDB db;
+  db.begin();
+  unsigned int n = 0;
+  mailbox_record_t rec;
+  while (db.next(rec))
+    n++;
+  return n;
+}
+
+// Total bytes read from all files named
+static unsigned long bytesRead(const std::vector<std::string>& paths) {
+  unsigned long n = 0;
+  for (const auto& path : paths)
+    if (const auto node = LittleFS.node(path.c_str()))
+      n += node->bytes_read;
+  return n;
+}
+
+static void benchStorage() {
+
+  // Boot: files vs database holding the same mailboxes. The in-memory file system makes host time a lower bound;
+  // on the module every open() costs a LittleFS directory lookup in flash
+  printf("Mailbox storage: boot load of N mailboxes (record %zu B)\n", sizeof(mailbox_record_t));
+  for (const unsigned int N : {1, 4, 15}) {
+    LittleFS.clear();
+    {
+      MailBoxDB db;
+      db.begin();
+      for (unsigned int id = MAILBOX_ID_MIN; id <= N; id++) {
+        auto file = LittleFS.open(("/mailbox" + std::to_string(id) + ".cfg").c_str(), "w");
+        file.println("Mailbox");
+        file.println(1700000000 + id);
+        file.println(80);
+        file.println(1690000000 + id);
+        file.close();
+        mailbox_record_t rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.id = id;
+        strcpy(rec.label, "Mailbox");
+        db.save(rec);
+      }
+    }
+    std::vector<std::string> files;
+    for (unsigned int id = MAILBOX_ID_MIN; id <= MAILBOX_ID_MAX_BASIC; id++)
+      files.push_back("/mailbox" + std::to_string(id) + ".cfg");
+    const unsigned int M = 10000;
+    auto opens = LittleFS.opens;
+    auto bytes = bytesRead(files);
+    auto t_begin = now_ns();
+    for (unsigned int i = 0; i < M; i++)
+      loadFiles();
+    const double t_files = (now_ns() - t_begin) / M / 1000;
+    const auto opens_files = (LittleFS.opens - opens) / M, bytes_files = (bytesRead(files) - bytes) / M;
+    opens = LittleFS.opens;
+    bytes = bytesRead({MailBoxDB::FILE_NAME});
+    t_begin = now_ns();
+    for (unsigned int i = 0; i < M; i++)
+      loadDB();
+    const double t_db = (now_ns() - t_begin) / M / 1000;
+    printf("  N=%-2u files:    %2lu open(s), %5lu B read, %6.2f us\n", N, opens_files, bytes_files, t_files);
+    printf("       database: %2lu open(s), %5lu B read, %6.2f us\n",
+      (LittleFS.opens - opens) / M, (bytesRead({MailBoxDB::FILE_NAME}) - bytes) / M, t_db);
+  }
+
+  // Flash writes: the baseline rewrote the mailbox file on every message. Messages come in bursts (door opening and closing,
+  // repeated deliveries), bursts are an hour apart; update() runs every second
+  printf("Mailbox storage: database record writes per message (baseline: 1 file rewrite per message)\n");
+  LittleFS.clear();
+  fake::now = 1700000000;
+  System::begin();
+  mailbox_manager.begin();
+  uint16_t num = 0;
+  for (const auto& burst : {std::make_pair(1u, 0u), std::make_pair(2u, 20u), std::make_pair(4u, 10u), std::make_pair(10u, 5u)}) {
+    const auto node = LittleFS.node(MailBoxDB::FILE_NAME);
+    const auto bytes = node->bytes_written;
+    const unsigned int BURSTS = 100;
+    for (unsigned int b = 0; b < BURSTS; b++)
+      for (unsigned int s = 0; s < 3600; s++) {
+        const auto gap = burst.second ? burst.second : 1;
+        if (s % gap == 0 && s / gap < burst.first) {
+          MailBoxMessage msg;
+          msg.init(1);
+          msg.setMailBoxID(1);
+          num = MailBoxMessage::getNextMessageNumber(num);
+          msg.setMessageNumber(num);
+          msg.setBattery(80);
+          msg.setDoor(num % 2);
+          msg.terminate();
+          mailbox_manager.process(msg);
+        }
+        fake::advance(1000);
+        fake::now++;
+        mailbox_manager.update();
+      }
+    const double writes = (double)(node->bytes_written - bytes) / sizeof(mailbox_record_t);
+    printf("  burst of %2u, %2u s apart: %.2f record write(s) per message\n", burst.first, burst.second, writes / (BURSTS * burst.first));
+  }
+  Serial.tx.clear();
+}
+
+/*************************************************************************
+ * Mailbox table: lookup, message processing and global alarm update
+ *************************************************************************/
+
+// Message from a mailbox
+static MailBoxMessage message(const uint8_t mb_id, const uint16_t num) {
+  MailBoxMessage msg;
+  msg.init(1);
+  msg.setMailBoxID(mb_id);
+  msg.setMessageNumber(num);
+  msg.setBattery(80);
+  msg.setDoor(num % 2);
+  msg.terminate();
+  return msg;
+}
+
+static void benchTable() {
+  printf("Mailbox table: N mailboxes registered; lookup of every ID in turn (baseline: sorted list walk)\n");
+  LittleFS.clear();
+  fake::now = 1700000000;
+  System::begin();
+  mailbox_manager.begin();
+  unsigned int registered = 0;
+  for (const unsigned int N : {1, 4, 15}) {
+    const auto allocs = allocations;
+    for (unsigned int id = MAILBOX_ID_MIN; id <= N; id++)
+      mailbox_manager.getMailBox(id, true);
+    const double allocs_registration = (double)(allocations - allocs) / (N - registered);
+    registered = N;
+
+    // Baseline kept pointers in a forward_list sorted by ID and scanned it
+    std::forward_list<VirtualMailBox *> list;
+    for (unsigned int id = N; id >= MAILBOX_ID_MIN; id--)
+      list.push_front(mailbox_manager[id]);
+    const unsigned int M = 10000000;
+    uintptr_t sum = 0;
+    auto t_begin = now_ns();
+    for (unsigned int i = 0; i < M; i++)
+      sum += (uintptr_t)mailbox_manager[MAILBOX_ID_MIN + i % N];
+    const double t_table = (now_ns() - t_begin) / M;
+    t_begin = now_ns();
+    for (unsigned int i = 0; i < M; i++) {
+      const uint8_t id = MAILBOX_ID_MIN + i % N;
+      for (const auto mb : list)
+        if (mb->getID() == id) {
+          sum -= (uintptr_t)mb;
+          break;
+        }
+    }
+    const double t_list = (now_ns() - t_begin) / M;
+    if (sum)
+      printf("  lookup mismatch\n");
+
+    // Message processing and global alarm update
+    const unsigned int P = 20000;
+    uint16_t num = 0;
+    t_begin = now_ns();
+    for (unsigned int i = 0; i < P; i++) {
+      num = MailBoxMessage::getNextMessageNumber(num);
+      mailbox_manager.process(message(MAILBOX_ID_MIN + i % N, num));
+      if (i % 100 == 0)
+        Serial.tx.clear();
+    }
+    const double t_process = (now_ns() - t_begin) / P;
+    mailbox_manager.save();
+    Serial.tx.clear();
+    t_begin = now_ns();
+    for (unsigned int i = 0; i < M / 10; i++)
+      mailbox_manager.updateAlarm();
+    const double t_alarm = (now_ns() - t_begin) / (M / 10);
+    printf("  N=%-2u lookup %5.2f ns (list %5.2f ns), process() %6.0f ns, updateAlarm() %5.2f ns, %.1f allocation(s) per registration\n",
+      N, t_table, t_list, t_process, t_alarm, allocs_registration);
+  }
+  Serial.tx.clear();
+}
+
+/*************************************************************************
+ * Load: all 255 mailbox IDs reporting to one receiver
+ *************************************************************************/
+static void benchLoad() {
+
+  // Every ID sends through the extended protocol; the receiver serves the first MailBoxManager::MAILBOXES_MAX of them.
+  // Heap is the host heap taken by mailboxes (pointers are twice the size of the module's)
+  printf("Load: %u mailbox IDs, at most %u served (sizeof(VirtualMailBox) %zu B on the host)\n",
+    MAILBOX_ID_MAX, MailBoxManager::MAILBOXES_MAX, sizeof(VirtualMailBox));
+  while (mailbox_manager.getNumMailBoxes())
+    mailbox_manager.deleteMailBox(mailbox_manager.getMailBoxAt(0)->getID());
+  Serial.tx.clear();
+  const auto heap_begin = heap_used;
+  uint16_t nums[MAILBOX_ID_MAX + 1] = {};
+  const auto send = [&nums](const uint8_t mb_id) {
+    MailBoxMessage msg;
+    msg.init(1);
+    msg[0] = PROTO_VERSION_EXT;
+    msg[1] = 1;
+    msg.setMailBoxID(mb_id);
+    nums[mb_id] = MailBoxMessage::getNextMessageNumber(nums[mb_id]);
+    msg.setMessageNumber(nums[mb_id]);
+    msg.setBattery(80);
+    msg.setDoor(nums[mb_id] % 2);
+    msg.terminate();
+    mailbox_manager.process(msg);
+    fake::advance(100);
+  };
+
+  // First round registers mailboxes
+  double t_begin = now_ns();
+  for (unsigned int id = MAILBOX_ID_MIN; id <= MAILBOX_ID_MAX; id++)
+    send(id);
+  const double t_first = (now_ns() - t_begin) / MAILBOX_ID_MAX;
+  Serial.tx.clear();
+  const auto num = mailbox_manager.getNumMailBoxes();
+  printf("  registered %hhu; heap %zu B (%zu B per mailbox); first round %.2f us per message\n",
+    num, heap_used - heap_begin, (heap_used - heap_begin) / num, t_first / 1000);
+
+  // Steady state: served and refused IDs
+  const unsigned int ROUNDS = 20;
+  t_begin = now_ns();
+  for (unsigned int r = 0; r < ROUNDS; r++) {
+    for (uint8_t n = 0; n < num; n++)
+      send(mailbox_manager.getMailBoxAt(n)->getID());
+    Serial.tx.clear();
+  }
+  const double t_served = (now_ns() - t_begin) / ROUNDS / num;
+  t_begin = now_ns();
+  for (unsigned int r = 0; r < ROUNDS; r++) {
+    for (unsigned int id = MAILBOX_ID_MAX - 100; id <= MAILBOX_ID_MAX; id++)
+      send(id);
+    Serial.tx.clear();
+  }
+  const double t_refused = (now_ns() - t_begin) / ROUNDS / 101;
+  printf("  process(): %.2f us per message from a served mailbox, %.2f us from a refused one\n", t_served / 1000, t_refused / 1000);
+  mailbox_manager.save();
+  mailbox_manager.update(true);
+  Serial.tx.clear();
+
+  // Page rendering
+  for (const char *uri : {"/", "/api/v1/mailboxes"}) {
+    const unsigned int M = 200;
+    size_t size = 0;
+    t_begin = now_ns();
+    for (unsigned int i = 0; i < M; i++) {
+      System::web_server.response.clear();
+      System::web_server.request(uri);
+      size = System::web_server.response.size();
+    }
+    printf("  %-18s %6zu B in %7.1f us\n", uri, size, (now_ns() - t_begin) / M / 1000);
+  }
+  Serial.tx.clear();
+}
+
+/*************************************************************************
+ * Event history
+ *************************************************************************/
+static void benchEvents() {
+  LittleFS.clear();
+  System::log = &null;
+  System::setTimeSyncStatus(TIME_SYNC_OK);
+  EventHistory history(1);
+  const time_t t0 = 1700000000;
+  const unsigned int N = 1000;
+  std::set<std::shared_ptr<fs::Node>> files;     // All files ever written, including the rotated out ones
+  double add_ns = 0;
+  for (unsigned int i = 0; i < N; i++) {
+    const auto t_begin = now_ns();
+    history.add(i % 2 ? EVENT_CLOSE : EVENT_OPEN, t0 + 60 * i, 100 - i / 10, i % 3, i % 300);
+    add_ns += now_ns() - t_begin;
+    for (const auto path : {"/events1.dat", "/events1.old"})
+      if (const auto node = LittleFS.node(path))
+        files.insert(node);
+  }
+  unsigned long writes = 0;
+  for (const auto& node : files)
+    writes += node->writes;
+  history.flush();
+
+  unsigned long reads = 0;
+  for (const auto path : {"/events1.dat", "/events1.old"})
+    reads -= LittleFS.node(path)->reads;
+  const auto n = history.query(t0 + 60 * (N - 100), t0 + 60 * (N - 90), [](const EventHistory::event_t&) {});
+  for (const auto path : {"/events1.dat", "/events1.old"})
+    reads += LittleFS.node(path)->reads;
+
+  printf("Event history: %u event(s)\n", N);
+  printf("  %lu batched write(s), %.0f ns per event\n", writes, add_ns / N);
+  printf("  range query: %zu event(s) found with %lu read(s)\n", n, reads);
+}
+
+/*************************************************************************
+ * Timer dispatch: typed callback vs action string matching
+ *************************************************************************/
+static unsigned long timeouts = 0;
+static void timeout(VirtualMailBox *mb) {
+  timeouts += mb->getID();
+}
+
+// Timer handler as before typed callbacks: action string parsing and mailbox lookup
+static void handleAbsTimer(const TimerAbsolute* timer) {
+  const auto& action = timer->getAction();
+  if (action.startsWith("signal absent msg for mb_id=")) {
+    const auto mb = mailbox_manager[action.substring(28).toInt()];
+    if (mb)
+      timeout(mb);
+  }
+}
+
+static void benchTimerDispatch() {
+
+  // Every mailbox served has its timer fire in turn. The mailbox timeout itself is replaced by a counter
+  const auto num = mailbox_manager.getNumMailBoxes();
+  printf("Timer dispatch: %hhu mailboxes, each timer fired in turn\n", num);
+  std::vector<std::unique_ptr<TimerCountdownAbs>> timers_typed, timers_string;
+  timers_typed.reserve(num);
+  timers_string.reserve(num);
+
+  // Allocations made by a timer besides the timer object itself
+  auto allocs = allocations;
+  for (uint8_t n = 0; n < num; n++) {
+    timers_typed.emplace_back(new TimerCountdownAbs("mb absent", 12));
+    timers_typed.back()->setCallback([](const Timer*, void *mb) { timeout(static_cast<VirtualMailBox *>(mb)); },
+      mailbox_manager.getMailBoxAt(n));
+  }
+  const double allocs_typed = (double)(allocations - allocs) / num - 1;
+  allocs = allocations;
+  for (uint8_t n = 0; n < num; n++)
+    timers_string.emplace_back(new TimerCountdownAbs(String("signal absent msg for mb_id=") + mailbox_manager.getMailBoxAt(n)->getID(), 12));
+  const double allocs_string = (double)(allocations - allocs) / num - 1;
+
+  const unsigned int M = 100000;
+  timeouts = 0;
+  allocs = allocations;
+  auto t_begin = now_ns();
+  for (unsigned int i = 0; i < M; i++)
+    timers_typed[i % num]->fire();
+  const double t_typed = (now_ns() - t_begin) / M;
+  const double allocs_fire_typed = (double)(allocations - allocs) / M;
+  const auto timeouts_typed = timeouts;
+  timeouts = 0;
+  allocs = allocations;
+  t_begin = now_ns();
+  for (unsigned int i = 0; i < M; i++)
+    handleAbsTimer(timers_string[i % num].get());
+  const double t_string = (now_ns() - t_begin) / M;
+  const double allocs_fire_string = (double)(allocations - allocs) / M;
+  if (timeouts != timeouts_typed)
+    printf("  dispatch mismatch\n");
+  printf("  typed callback: %6.1f ns and %.1f allocation(s) per firing; %.1f allocation(s) per timer\n", t_typed, allocs_fire_typed, allocs_typed);
+  printf("  action string:  %6.1f ns and %.1f allocation(s) per firing; %.1f allocation(s) per timer\n", t_string, allocs_fire_string, allocs_string);
+}
+
+/*************************************************************************
+ * Timers: queue vs checking every timer every second
+ *************************************************************************/
+static unsigned long fired = 0;
+static void count(const Timer*, void*) {
+  fired++;
+}
+
+// Random timer mix, same for both loops
+static TimerAbsolute *makeTimer(const unsigned int i) {
+  const bool armed = rnd(10), recurrent = rnd(8), transient = !recurrent && rnd(2);
+  TimerAbsolute *timer;
+  if (rnd(4))
+    timer = new TimerAbsolute("abs", rnd(24), rnd(60), rnd(60), 1 + rnd(TIMER_DOW_ANY), armed, recurrent, transient, i);
+  else {
+    const float interval = 60 * (1 + rnd(180));
+    timer = new TimerCountdownAbs("countdown", interval, rnd(interval), TIMER_DOW_ANY, armed, recurrent, transient, i);
+  }
+  timer->setCallback(count);
+  return timer;
+}
+
+// Set current time
+static void tick(const time_t t) {
+  System::time = t;
+  localtime_r(&t, &System::tm_time);
+}
+
+static void benchTimers() {
+  const unsigned int N = 500;
+  const time_t t0 = 1679266800 + 1, t1 = t0 + 10 * 24 * 3600 - 3600;   // 2023/03/20 - 2023/03/30, Europe/Paris
+  setTZ(TZ_Europe_Paris);
+  System::log = &null;
+
+  // Same mix for both loops
+  std::vector<std::unique_ptr<TimerAbsolute>> timers, timers_scan;
+  std::forward_list<TimerAbsolute *> list;
+  for (unsigned int i = 0; i < N; i++) {
+    const auto timer = makeTimer(i);
+    timers.emplace_back(timer);
+    System::addTimer(timer);
+    TimerAbsolute *copy;
+    if (timer->getType() == TIMER_COUNTDOWN_ABS) {
+      const auto countdown = static_cast<TimerCountdownAbs *>(timer);
+      copy = new TimerCountdownAbs("countdown", countdown->getInterval(), countdown->getOffset(), TIMER_DOW_ANY,
+        timer->isArmed(), timer->isRecurrent(), timer->isTransient(), i);
+    } else
+      copy = new TimerAbsolute("abs", timer->getHour(), timer->getMinute(), timer->getSecond(), timer->getDayOfWeek(),
+        timer->isArmed(), timer->isRecurrent(), timer->isTransient(), i);
+    copy->setCallback(count);
+    timers_scan.emplace_back(copy);
+    list.push_front(copy);
+  }
+
+  // Queue
+  fired = 0;
+  auto t_begin = now_ns();
+  for (auto t = t0; t < t1; t++) {
+    tick(t);
+    HostSystem::fireTimers(t);
+  }
+  const double queue_ns = (now_ns() - t_begin) / (t1 - t0);
+  const auto fired_queue = fired;
+  System::timers.clear();
+  System::rescheduleTimers();
+
+  // Scan, as the system did before the queue
+  fired = 0;
+  t_begin = now_ns();
+  for (auto t = t0; t < t1; t++) {
+    tick(t);
+    for (auto it = list.begin(), prev = list.before_begin(); it != list.end(); ) {
+      auto timer = *it;
+      if (timer->isArmed() && *timer == System::tm_time) {
+        timer->fire();
+        if (timer->isTransient()) {
+          it = list.erase_after(prev);
+          continue;
+        }
+        if (!timer->isRecurrent())
+          timer->disarm();
+      }
+      if (timer->getType() == TIMER_COUNTDOWN_ABS)
+        static_cast<TimerCountdownAbs *>(timer)->update(t);
+      prev = it++;
+    }
+  }
+  const double scan_ns = (now_ns() - t_begin) / (t1 - t0);
+  setTZ(TZ_Etc_UTC);
+
+  printf("Timers: %u timers over 10 days across DST change\n", N);
+  printf("  queue: %lu firing(s), %.0f ns per second\n", fired_queue, queue_ns);
+  printf("  scan:  %lu firing(s), %.0f ns per second\n", fired, scan_ns);
+}
+
+
+/*************************************************************************
+ * Application log
+ *************************************************************************/
+static const time_t T0 = 1700000000;             // 2023/11/14 22:13:20 UTC
+
+// Set both clocks to a given time
+static void setTime(const time_t t) {
+  fake::now = t;
+  System::setTime(t);
+}
+
+// Start the system over an existing or empty file system
+static void start(const bool format, const size_t size_max) {
+  System::appLogFlush();
+  if (System::app_log)
+    System::app_log.close();
+  if (format)
+    LittleFS.clear();
+  Serial.tx.clear();
+  System::log = &Serial;
+  System::app_log_size_max = size_max;
+  setTime(T0);
+  System::begin();
+}
+
+// Typical log line of a given number
+static String line(const unsigned int i) {
+  return String("Mailbox ") + (i % 20 + 1) + ": event #" + i + ", battery " + i % 100 + "%";
+}
+
+// Write a log line of a given number. Lines come in bursts of 5 every 100 seconds, as for a mailbox event
+static void writeLine(const unsigned int i, const String& str, const bool important = false) {
+  if (i % 5 == 0)
+    setTime(T0 + 20 * i);
+  System::appLogWriteLn(str, important);
+}
+
+static void writeLine(const unsigned int i) {
+  writeLine(i, line(i));
+}
+
+// Number reported in the last system log message of a kind
+static unsigned long logged(const char *prefix) {
+  const auto pos = Serial.tx.rfind(prefix);
+  return pos == std::string::npos ? 0 : strtoul(Serial.tx.c_str() + pos + strlen(prefix), nullptr, 10);
+}
+
+static void benchLogWrite() {
+  start(true, 4 * 1048576);
+  const auto node = LittleFS.node("/applog.txt");
+  const auto flushes = node->flushes;
+  const unsigned int N = 10000;
+  std::vector<String> lines;
+  for (unsigned int i = 0; i < N; i++)
+    lines.push_back(line(i));
+  System::log = &null;
+  const auto t_begin = now_ns();
+  for (unsigned int i = 0; i < N; i++)
+    writeLine(i, lines[i], i % 20 == 0);         // 5% copied to syslog
+  const double line_ns = (now_ns() - t_begin) / N;
+  System::appLogFlush();
+  printf("Application log: %u line(s), 5%% copied to syslog\n", N);
+  printf("  %lu flush(es) for %zu B, %.0f ns per line\n", node->flushes - flushes, node->data.size(), line_ns);
+}
+
+static void benchLogPages() {
+  LittleFS.total_bytes = 8 * 1048576;
+  start(true, 4 * 1048576);
+  unsigned int lines = 0;
+  while (LittleFS.node("/applog.txt")->data.size() < 1048576) {
+    writeLine(lines++);
+    System::appLogFlush();
+  }
+  const auto pages = LittleFS.node("/applog.idx")->data.size() / 8;
+
+  // Index rebuild on start
+  LittleFS.remove("/applog.idx");
+  auto t_begin = now_ns();
+  start(false, 4 * 1048576);
+  const double rebuild_ms = (now_ns() - t_begin) / 1e6;
+
+  // Page rendering
+  double page_us_max = 0, page_us_sum = 0;
+  for (size_t p = 0; p < pages; p++) {
+    t_begin = now_ns();
+    System::web_server.request("/log", {{"p", String(p)}});
+    const double page_us = (now_ns() - t_begin) / 1e3;
+    page_us_sum += page_us;
+    if (page_us > page_us_max)
+      page_us_max = page_us;
+  }
+  printf("Application log pages: %zu B, %u line(s), %zu page(s)\n", LittleFS.node("/applog.txt")->data.size(), lines, pages);
+  printf("  index rebuild on start: %.1f ms\n", rebuild_ms);
+  printf("  page: %.0f us on average, %.0f us at most\n", page_us_sum / pages, page_us_max);
+  LittleFS.total_bytes = 2 * 1048576;
+}
+
+static void benchLogSearch() {
+  start(true, 1048576);                          // Two files of 512 kiB
+  unsigned int i = 0;
+  while (!LittleFS.exists("/applog2.txt") || LittleFS.node("/applog.txt")->data.size() < 500 * 1024) {
+    writeLine(i++);
+    System::update();
+  }
+  System::appLogFlush();
+  printf("Application log search: %zu + %zu B\n", LittleFS.node("/applog2.txt")->data.size(), LittleFS.node("/applog.txt")->data.size());
+
+  // Full scan for a text not found
+  double scan_ms_min = 1e9, scan_ms_max = 0;
+  for (unsigned int n = 0; n < 10; n++) {
+    const auto t_begin = now_ns();
+    System::web_server.request("/log/search", {{"q", "no such text"}});
+    const double scan_ms = (now_ns() - t_begin) / 1e6;
+    scan_ms_min = std::min(scan_ms_min, scan_ms);
+    scan_ms_max = std::max(scan_ms_max, scan_ms);
+  }
+  const auto lines = logged("Log search scanned ");
+  printf("  full scan: %lu line(s) in %.1f-%.1f ms\n", lines, scan_ms_min, scan_ms_max);
+
+  // One day of the latest log
+  const auto t_day = T0 + 20 * i - 86400;
+  char from[20];
+  strftime(from, sizeof(from), "%Y/%m/%d %H:%M:%S", gmtime(&t_day));
+  const auto t_begin = now_ns();
+  System::web_server.request("/log/search", {{"mb", "7"}, {"from", from}});
+  printf("  last day: %lu line(s) scanned of %lu in %.1f ms\n", logged("Log search scanned "), lines, (now_ns() - t_begin) / 1e6);
+}
+
+/*************************************************************************
+ * Web pages: chunked page writer vs the whole page in a String
+ *************************************************************************/
+static double t_first_byte = 0;
+static void firstByte() {
+  if (!t_first_byte)
+    t_first_byte = now_ns();
+}
+
+static void benchPages() {
+  while (mailbox_manager.getNumMailBoxes())
+    mailbox_manager.deleteMailBox(mailbox_manager.getMailBoxAt(0)->getID());
+  uint16_t num = 0;
+  for (unsigned int id = MAILBOX_ID_MIN; id <= MAILBOX_ID_MAX_BASIC; id++) {
+    num = MailBoxMessage::getNextMessageNumber(num);
+    mailbox_manager.process(message(id, num));
+  }
+  mailbox_manager.update(true);
+  Serial.tx.clear();
+
+  // Heap taken by the response in the fake server is not the module's, so it is reserved upfront
+  auto& server = System::web_server;
+  server.response.reserve(65536);
+  server.on_content = firstByte;
+  printf("Web pages: %u mailboxes; heap peak above idle, time to first byte and total (WebPage buffer %zu B is static)\n",
+    MAILBOX_ID_MAX_BASIC, WebPage::BUFFER_SIZE);
+  for (const char *uri : {"/", "/mailbox?id=1", "/conf"}) {
+    const String path = String(uri).substring(0, String(uri).indexOf('?'));
+    const HostSystem::args_t args = path == "/mailbox" ? HostSystem::args_t{{"id", "1"}} : HostSystem::args_t{};
+    const unsigned int M = 200;
+    size_t heap = 0;
+    double t_first = 0, t_total = 0;
+    for (unsigned int i = 0; i < M; i++) {
+      heap_peak = heap_used;
+      const auto heap_begin = heap_used;
+      t_first_byte = 0;
+      const auto t_begin = now_ns();
+      server.request(path, args);
+      t_total += now_ns() - t_begin;
+      t_first += t_first_byte - t_begin;
+      heap = std::max(heap, heap_peak - heap_begin);
+    }
+    const auto size = server.response.size();
+
+    // Before, the page was appended piece by piece to one String reserved at 2 KiB, and sent once complete
+    heap_peak = heap_used;
+    const auto heap_begin = heap_used;
+    {
+      String page;
+      page.reserve(2048);
+      for (size_t pos = 0; pos < size; pos += 32)
+        page.concat(server.response.data() + pos, std::min((size_t)32, size - pos));
+    }
+    printf("  %-14s %6zu B in %lu chunk(s): heap %5zu B, first byte %5.1f us, total %5.1f us; as one String: heap %5zu B\n",
+      uri, size, server.chunks, heap, t_first / M / 1000, t_total / M / 1000, heap_peak - heap_begin);
+  }
+  server.on_content = nullptr;
+  Serial.tx.clear();
+}
+
+/*************************************************************************
+ * JSON API: poll cost with and without a state change
+ *************************************************************************/
+static void benchAPI() {
+  auto& server = System::web_server;
+  const auto num = mailbox_manager.getNumMailBoxes();
+  printf("JSON API: %hhu mailboxes; cost of one poll\n", num);
+  const auto poll = [&server](const char *uri, const ESP8266WebServer::args_t& headers) {
+    const unsigned int M = 2000;
+    const auto allocs = allocations;
+    const auto t_begin = now_ns();
+    for (unsigned int i = 0; i < M; i++)
+      server.request(uri, {}, headers);
+    printf("  %-22s %-16s %3d %6zu B %7.2f us %5.1f allocation(s)\n", uri, headers.empty() ? "" : "If-None-Match",
+      server.code, server.response.size(), (now_ns() - t_begin) / M / 1000, (double)(allocations - allocs) / M);
+  };
+  poll("/", {});                                 // Scraping the page, as before the API
+  poll("/api/v1/mailboxes", {});
+  poll("/api/v1/mailboxes", {{"If-None-Match", mailbox_manager.getETag()}});
+  poll("/api/v1/mailboxes/1", {});
+  poll("/api/v1/mailboxes/1", {{"If-None-Match", mailbox_manager.getETag()}});
+  Serial.tx.clear();
+}
+
+/*************************************************************************
+ * Web events: push latency
+ *************************************************************************/
+static void benchEventsPush() {
+
+  // Events are written from within message processing, so the time process() takes bounds the latency from message to socket
+  auto& server = System::web_server;
+  printf("Web events: %hhu mailboxes; message processing until the event is in the socket\n", mailbox_manager.getNumMailBoxes());
+  std::vector<std::shared_ptr<WiFiClient::Connection>> subs;
+  uint16_t num = 100;
+  for (const unsigned int n : {0u, 1u, (unsigned int)WebEvents::SUBSCRIBERS_MAX}) {
+    while (subs.size() < n) {
+      server.request("/events");
+      subs.push_back(server.client().connection);
+    }
+    const unsigned int M = 2000;
+    size_t sent = 0;
+    double t = 0;
+    for (unsigned int i = 0; i < M; i++) {
+      for (const auto& sub : subs)
+        sub->sent.clear();
+      num = MailBoxMessage::getNextMessageNumber(num);
+      const auto msg = message(1 + i % MAILBOX_ID_MAX_BASIC, num);
+      const auto t_begin = now_ns();
+      mailbox_manager.process(msg);
+      t += now_ns() - t_begin;
+      for (const auto& sub : subs)
+        sent += sub->sent.size();
+      if (i % 100 == 0)
+        Serial.tx.clear();
+    }
+    printf("  %u subscriber(s): %5.2f us per message, %4zu B sent per subscriber\n", n, t / M / 1000, n ? sent / M / n : 0);
+  }
+
+  // A subscriber with a full socket gets one event per mailbox once it drains, however many changes happened
+  subs.front()->sent.clear();
+  subs.front()->window = 0;
+  for (unsigned int i = 0; i < 100; i++) {
+    num = MailBoxMessage::getNextMessageNumber(num);
+    mailbox_manager.process(message(1 + i % 3, num));
+  }
+  subs.front()->window = SIZE_MAX;
+  const auto t_begin = now_ns();
+  web_events.update();
+  const double t_drain = now_ns() - t_begin;
+  size_t events = 0;
+  for (auto pos = subs.front()->sent.find("event: "); pos != std::string::npos; pos = subs.front()->sent.find("event: ", pos + 1))
+    events++;
+  printf("  100 changes of 3 mailboxes behind a full socket: %zu event(s) sent in %.1f us once it drains\n", events, t_drain / 1000);
+  for (const auto& sub : subs)
+    sub->connected = false;
+  Serial.tx.clear();
+}
+
+int main() {
+  benchReceiver();
+  benchResync();
+  benchChecksum();
+  benchFEC();
+  benchRepeats();
+  benchBattery();
+  benchDaysLeft();
+  benchStorage();
+  benchTable();
+  benchLoad();
+  benchEvents();
+  benchTimerDispatch();
+  benchTimers();
+  benchLogWrite();
+  benchPages();
+  benchAPI();
+  benchEventsPush();
+  benchLogPages();
+  benchLogSearch();
+  return 0;
+}
@@ -0,0 +1,85 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Arduino core stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_ARDUINO_H_
+#define _DS_FAKE_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+
+// Flash memory access; on the host, flash is plain memory
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+class __FlashStringHelper;
+#define FPSTR(p) (reinterpret_cast<const __FlashStringHelper *>(p))
+#define F(s) FPSTR(PSTR(s))
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strcasecmp_P strcasecmp
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+
+#ifndef __STRING
+#define __STRING(x) #x
+#endif // __STRING
+#ifndef __XSTRING
+#define __XSTRING(x) __STRING(x)
+#endif // __XSTRING
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+using std::min;
+using std::max;
+
+#define DEC 10
+#define HEX 16
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#ifndef LED_BUILTIN
+#define LED_BUILTIN 1
+#endif // LED_BUILTIN
+
+unsigned long millis();                          // Fake clock (see fake.h)
+unsigned long micros();
+void delay(unsigned long /* ms */);              // Advances the fake clock
+void yield();
+long random(long /* max */);
+long random(long /* min */, long /* max */);
+void pinMode(uint8_t /* pin */, uint8_t /* mode */);
+int digitalRead(uint8_t /* pin */);
+void digitalWrite(uint8_t /* pin */, uint8_t /* value */);
+
+// Time zone and NTP (declared in Arduino.h by ESP8266 core)
+void setTZ(const char* /* tz */);
+void configTime(const char* /* tz */, const char* /* server1 */, const char* server2 = nullptr, const char* server3 = nullptr);
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "HardwareSerial.h"
+#include "Esp.h"
+
+#endif // _DS_FAKE_ARDUINO_H_
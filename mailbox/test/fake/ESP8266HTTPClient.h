@@ -0,0 +1,30 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * ESP8266 HTTP client stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_ESP8266HTTPCLIENT_H_
+#define _DS_FAKE_ESP8266HTTPCLIENT_H_
+
+#include <Arduino.h>
+#include "WiFiClient.h"
+
+enum {
+  HTTP_CODE_OK = 200,
+  HTTP_CODE_NOT_MODIFIED = 304,
+  HTTP_CODE_BAD_REQUEST = 400,
+  HTTP_CODE_NOT_FOUND = 404,
+  HTTP_CODE_SERVICE_UNAVAILABLE = 503
+};
+
+// Client which never reaches the server
+class HTTPClient {
+  public:
+    bool begin(WiFiClient&, const String&) { return true; }
+    void addHeader(const String&, const String&) {}
+    int POST(const String&) { return -1; }
+    void end() {}
+};
+
+#endif // _DS_FAKE_ESP8266HTTPCLIENT_H_
@@ -0,0 +1,75 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * ESP8266 web server stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_ESP8266WEBSERVER_H_
+#define _DS_FAKE_ESP8266WEBSERVER_H_
+
+#include <Arduino.h>
+#include <FS.h>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "WiFiClient.h"
+#include "uri/UriBraces.h"
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+const size_t CONTENT_LENGTH_UNKNOWN = (size_t)-1;
+
+// Web server served by the test. A request runs the matching handler and collects the response
+class ESP8266WebServer {
+  public:
+    typedef std::function<void()> THandlerFunction;
+    typedef std::vector<std::pair<String, String>> args_t;
+
+  protected:
+    struct handler_t {
+      String uri;                                // URI, possibly with "{}" placeholders
+      THandlerFunction fn;                       // Handler
+    };
+    std::vector<handler_t> handlers;             // Registered handlers
+    String request_uri;                          // Current request URI
+    args_t request_args;                         // Current request arguments
+    args_t request_headers;                      // Current request headers
+    std::vector<String> path_args;               // Current request path arguments
+    WiFiClient request_client;                   // Current request client
+
+  public:
+    int code = 0;                                // Response code
+    String content_type;                         // Response content type
+    std::string response;                        // Response body
+    unsigned long chunks = 0;                    // Number of content chunks sent
+    void (*on_content)() = nullptr;              // Called when content is sent (e.g., to time the first byte)
+
+    ESP8266WebServer(int = 80) {}
+    void begin() {}
+    void stop() {}
+    void handleClient() {}
+    void on(const String& uri, THandlerFunction fn) { handlers.push_back({uri, fn}); }
+    void on(const String& uri, HTTPMethod, THandlerFunction fn) { on(uri, fn); }
+    void on(const UriBraces& uri, THandlerFunction fn) { on(uri.uri, fn); }
+    void serveStatic(const char*, fs::FS&, const char*, const char* = nullptr) {}
+    void collectHeaders(const char*[], size_t) {}
+    const String& uri() const { return request_uri; }
+    int args() const { return request_args.size(); }
+    String argName(int i) const { return i < args() ? request_args[i].first : String(); }
+    String arg(int i) const { return i < args() ? request_args[i].second : String(); }
+    String arg(const String& name) const;
+    bool hasArg(const String& name) const;
+    String header(const String& name) const;
+    String pathArg(unsigned int i) const { return i < path_args.size() ? path_args[i] : String(); }
+    WiFiClient& client() { return request_client; }
+    void setContentLength(size_t) {}
+    void sendHeader(const String&, const String&, bool = false) {}
+    void send(int _code, const char* _content_type = nullptr, const String& content = String());
+    void send(int _code, const String& _content_type, const String& content) { send(_code, _content_type.c_str(), content); }
+    void sendContent(const char* content, size_t size);
+    void sendContent(const String& content) { sendContent(content.c_str(), content.length()); }
+
+    // Test interface
+    int request(const String& /* uri */, const args_t& args = {}, const args_t& headers = {}); // Serve a request. Returns response code (404 if no handler)
+};
+
+#endif // _DS_FAKE_ESP8266WEBSERVER_H_
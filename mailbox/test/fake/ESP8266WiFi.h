@@ -0,0 +1,31 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * ESP8266 Wi-Fi stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_ESP8266WIFI_H_
+#define _DS_FAKE_ESP8266WIFI_H_
+
+#include <Arduino.h>
+#include "IPAddress.h"
+#include "WiFiClient.h"
+
+enum WiFiMode_t { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA };
+
+// Network which is always connected
+class ESP8266WiFiClass {
+  public:
+    bool mode(WiFiMode_t) { return true; }
+    bool hostname(const char*) { return true; }
+    int begin(const char* = nullptr, const char* = nullptr) { return 0; }
+    bool isConnected() { return true; }
+    String SSID() { return "host"; }
+    int32_t channel() { return 1; }
+    int32_t RSSI() { return -50; }
+    IPAddress localIP() { return IPAddress(192, 168, 1, 1); }
+};
+
+extern ESP8266WiFiClass WiFi;
+
+#endif // _DS_FAKE_ESP8266WIFI_H_
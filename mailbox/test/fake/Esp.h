@@ -0,0 +1,41 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * ESP8266 chip interface stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_ESP_H_
+#define _DS_FAKE_ESP_H_
+
+#include <stdint.h>
+#include "WString.h"
+
+enum FlashMode_t { FM_QIO, FM_QOUT, FM_DIO, FM_DOUT, FM_UNKNOWN };
+
+// Heap figures are fixed, as the host heap says nothing about the device
+class EspClass {
+  public:
+    uint32_t free_heap = 40000;                  // Reported free heap (B)
+    uint32_t max_free_block = 30000;             // Reported largest free block (B)
+    uint16_t vcc = 3000;                         // Reported supply voltage (mV)
+
+    uint32_t getFreeHeap() { return free_heap; }
+    uint32_t getMaxFreeBlockSize() { return max_free_block; }
+    void getHeapStats(uint32_t *free, uint16_t *max, uint8_t *frag) {
+      *free = free_heap;
+      *max = max_free_block;
+      *frag = 100 - 100 * max_free_block / free_heap;
+    }
+    uint8_t getCpuFreqMHz() { return 80; }
+    uint32_t getFlashChipSize() { return 4194304; }
+    uint32_t getFlashChipSpeed() { return 40000000; }
+    FlashMode_t getFlashChipMode() { return FM_DIO; }
+    String getFullVersion() { return "host"; }
+    uint32_t getChipId() { return 0x123456; }
+    uint16_t getVcc() { return vcc; }
+    uint32_t random() { return ::random(); }
+};
+
+extern EspClass ESP;
+
+#endif // _DS_FAKE_ESP_H_
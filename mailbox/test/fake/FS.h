@@ -0,0 +1,104 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * ESP8266 file system stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_FS_H_
+#define _DS_FAKE_FS_H_
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace fs {
+
+  enum SeekMode { SeekSet, SeekCur, SeekEnd };
+
+  struct FSInfo {
+    size_t totalBytes;
+    size_t usedBytes;
+    size_t blockSize;
+    size_t pageSize;
+    size_t maxOpenFiles;
+    size_t maxPathLength;
+  };
+
+  // File contents with access statistics
+  struct Node {
+    std::vector<uint8_t> data;                   // Contents
+    unsigned long reads = 0;                     // Number of read() calls
+    unsigned long writes = 0;                    // Number of write() calls
+    unsigned long bytes_read = 0;                // Number of bytes read
+    unsigned long bytes_written = 0;             // Number of bytes written
+    unsigned long flushes = 0;                   // Number of flush() calls
+  };
+
+  // In-memory file. Mode semantics follow fopen()
+  class File : public Stream {
+      std::shared_ptr<Node> node;                // Contents (nullptr == not open)
+      size_t pos = 0;                            // Read/write position
+      bool readable = false;                     // True if open for reading
+      bool writable = false;                     // True if open for writing
+      bool append = false;                       // True if writes go to the end of file
+
+    public:
+      File() {}
+      File(std::shared_ptr<Node> _node, const char* /* mode */);
+      operator bool() const { return node != nullptr; }
+      int available() override { return readable && node && pos < node->data.size() ? node->data.size() - pos : 0; }
+      int read() override;
+      int peek() override;
+      size_t read(uint8_t* /* buffer */, size_t /* size */) override;
+      using Print::write;
+      size_t write(uint8_t c) override { return write(&c, 1); }
+      size_t write(const uint8_t* /* buffer */, size_t /* size */) override;
+      int availableForWrite() override { return writable ? 4096 : 0; }
+      void flush() override { if (node) node->flushes++; }
+      bool seek(uint32_t /* pos */, SeekMode mode = SeekSet);
+      size_t position() const { return pos; }
+      size_t size() const { return node ? node->data.size() : 0; }
+      bool truncate(uint32_t /* size */);
+      void close() { node = nullptr; }
+  };
+
+  // In-memory file system. Directories are implied by file names
+  class FS {
+      std::map<std::string, std::shared_ptr<Node>> files;
+
+    public:
+      size_t total_bytes = 2 * 1024 * 1024;      // Reported file system size (B)
+      unsigned long opens = 0;                   // Number of open() calls, including failed ones
+
+      bool begin() { return true; }
+      void end() {}
+      bool format() { files.clear(); return true; }
+      bool info(FSInfo& /* info */);
+      File open(const char* /* path */, const char* /* mode */);
+      File open(const String& path, const char* mode) { return open(path.c_str(), mode); }
+      bool exists(const char* /* path */);
+      bool exists(const String& path) { return exists(path.c_str()); }
+      bool remove(const char* /* path */);
+      bool remove(const String& path) { return remove(path.c_str()); }
+      bool rename(const char* /* from */, const char* /* to */);
+      bool rename(const String& from, const String& to) { return rename(from.c_str(), to.c_str()); }
+      bool mkdir(const char*) { return true; }
+      bool mkdir(const String&) { return true; }
+
+      // Test interface
+      std::shared_ptr<Node> node(const char* /* path */); // Return file contents (nullptr if missing)
+      std::string contents(const char* /* path */);       // Return file contents as string
+      void clear() { files.clear(); }                     // Remove all files
+  };
+
+} // namespace fs
+
+using fs::FS;
+using fs::File;
+using fs::FSInfo;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif // _DS_FAKE_FS_H_
@@ -0,0 +1,52 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Arduino HardwareSerial stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_HARDWARESERIAL_H_
+#define _DS_FAKE_HARDWARESERIAL_H_
+
+#include <deque>
+#include "Stream.h"
+
+enum SerialConfig { SERIAL_8N1 };
+enum SerialMode { SERIAL_FULL, SERIAL_RX_ONLY, SERIAL_TX_ONLY };
+
+// Serial line with an input queue filled by the test and an output buffer inspected by the test
+class HardwareSerial : public Stream {
+  public:
+    std::deque<uint8_t> rx;                      // Input waiting to be read
+    std::string tx;                              // Output written
+    size_t read_chunk = SIZE_MAX;                // Max amount of data returned by one bulk read (B)
+    bool echo = false;                           // Copy output to stdout
+
+    void begin(unsigned long /* baud */, SerialConfig = SERIAL_8N1, SerialMode = SERIAL_FULL) {}
+    void end() {}
+    void inject(const uint8_t *buffer, size_t size) { rx.insert(rx.end(), buffer, buffer + size); }
+    int available() override { return rx.size(); }
+    int peek() override { return rx.empty() ? -1 : rx.front(); }
+    int read() override {
+      if (rx.empty())
+        return -1;
+      const auto c = rx.front();
+      rx.pop_front();
+      return c;
+    }
+    size_t read(uint8_t *buffer, size_t size) override { return Stream::read(buffer, size < read_chunk ? size : read_chunk); }
+    size_t read(char *buffer, size_t size) { return read((uint8_t *)buffer, size); }
+    using Print::write;
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override {
+      tx.append((const char *)buffer, size);
+      if (echo)
+        fwrite(buffer, 1, size, stdout);
+      return size;
+    }
+    int availableForWrite() override { return 128; }
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif // _DS_FAKE_HARDWARESERIAL_H_
@@ -0,0 +1,24 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Arduino IPAddress stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_IPADDRESS_H_
+#define _DS_FAKE_IPADDRESS_H_
+
+#include <Arduino.h>
+
+class IPAddress {
+    uint8_t a[4];
+
+  public:
+    IPAddress(uint8_t a0 = 0, uint8_t a1 = 0, uint8_t a2 = 0, uint8_t a3 = 0) : a{a0, a1, a2, a3} {}
+    String toString() const {
+      char buf[16];
+      snprintf(buf, sizeof(buf), "%u.%u.%u.%u", a[0], a[1], a[2], a[3]);
+      return buf;
+    }
+};
+
+#endif // _DS_FAKE_IPADDRESS_H_
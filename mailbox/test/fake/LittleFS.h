@@ -0,0 +1,14 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * LittleFS stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_LITTLEFS_H_
+#define _DS_FAKE_LITTLEFS_H_
+
+#include <FS.h>
+
+extern fs::FS LittleFS;
+
+#endif // _DS_FAKE_LITTLEFS_H_
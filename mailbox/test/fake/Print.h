@@ -0,0 +1,54 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Arduino Print stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_PRINT_H_
+#define _DS_FAKE_PRINT_H_
+
+#include <stdarg.h>
+#include "WString.h"
+#include "Printable.h"
+
+class Print {
+  protected:
+    size_t printNumber(unsigned long long /* n */, uint8_t /* base */);
+
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t /* c */) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+      size_t n = 0;
+      while (size-- && write(*buffer++))
+        n++;
+      return n;
+    }
+    size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t printf(const char *format, ...) __attribute__ ((format (printf, 2, 3)));
+    size_t printf_P(PGM_P format, ...) __attribute__ ((format (printf, 2, 3)));
+
+    size_t print(const __FlashStringHelper *str) { return write(reinterpret_cast<const char *>(str)); }
+    size_t print(const String& str) { return write(str.c_str(), str.length()); }
+    size_t print(const char *str) { return write(str); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char n, int base = DEC) { return printNumber(n, base); }
+    size_t print(int n, int base = DEC) { return n < 0 && base == DEC ? print('-') + printNumber(-(long long)n, base) : printNumber((unsigned int)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return printNumber(n, base); }
+    size_t print(long n, int base = DEC) { return n < 0 && base == DEC ? print('-') + printNumber(-(long long)n, base) : printNumber((unsigned long)n, base); }
+    size_t print(unsigned long n, int base = DEC) { return printNumber(n, base); }
+    size_t print(long long n, int base = DEC) { return n < 0 && base == DEC ? print('-') + printNumber(-(unsigned long long)n, base) : printNumber(n, base); }
+    size_t print(unsigned long long n, int base = DEC) { return printNumber(n, base); }
+    size_t print(double n, int digits = 2) { return printf("%.*f", digits, n); }
+    size_t print(const Printable& x) { return x.printTo(*this); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(const T& x) { return print(x) + println(); }
+    template <typename T> size_t println(const T& x, int arg) { return print(x, arg) + println(); }
+};
+
+#endif // _DS_FAKE_PRINT_H_
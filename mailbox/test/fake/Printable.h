@@ -0,0 +1,20 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Arduino Printable stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_PRINTABLE_H_
+#define _DS_FAKE_PRINTABLE_H_
+
+#include <stddef.h>
+
+class Print;
+
+class Printable {
+  public:
+    virtual ~Printable() {}
+    virtual size_t printTo(Print& /* p */) const = 0;
+};
+
+#endif // _DS_FAKE_PRINTABLE_H_
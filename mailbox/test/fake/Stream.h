@@ -0,0 +1,68 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Arduino Stream stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_STREAM_H_
+#define _DS_FAKE_STREAM_H_
+
+#include "Print.h"
+
+void delay(unsigned long /* ms */);              // Advances the fake clock
+
+// Input is never waited for on the host, so parsing stops at the end of available data. The time which the device would
+// spend waiting for more input (stream timeout) passes on the fake clock instead
+class Stream : public Print {
+    unsigned long timeout = 1000;                // Stream timeout (ms)
+
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual size_t read(uint8_t *buffer, size_t size) {
+      size_t n = 0;
+      for (int c; n < size && (c = read()) >= 0; n++)
+        buffer[n] = c;
+      return n;
+    }
+    void setTimeout(unsigned long ms) { timeout = ms; }
+    size_t readBytes(char *buffer, size_t size) { return read((uint8_t *)buffer, size); }
+    size_t readBytes(uint8_t *buffer, size_t size) { return read(buffer, size); }
+    String readStringUntil(char terminator) {
+      String ret;
+      int c;
+      while ((c = read()) >= 0 && c != terminator)
+        ret += (char)c;
+      if (c < 0)
+        delay(timeout);
+      return ret;
+    }
+    String readString() {
+      String ret;
+      for (int c; (c = read()) >= 0; )
+        ret += (char)c;
+      delay(timeout);
+      return ret;
+    }
+    long parseInt() {
+      int c;
+      while ((c = peek()) >= 0 && c != '-' && !isdigit(c))
+        read();
+      bool negative = false;
+      long value = 0;
+      if (c == '-') {
+        negative = true;
+        read();
+      }
+      while ((c = peek()) >= 0 && isdigit(c)) {
+        value = value * 10 + c - '0';
+        read();
+      }
+      if (c < 0)
+        delay(timeout);                          // Waiting for the number to end, or to begin
+      return negative ? -value : value;
+    }
+};
+
+#endif // _DS_FAKE_STREAM_H_
@@ -0,0 +1,27 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * ESP8266 StreamString stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_STREAMSTRING_H_
+#define _DS_FAKE_STREAMSTRING_H_
+
+#include <Arduino.h>
+
+class StreamString : public String, public Stream {
+    size_t pos = 0;                              // Read position
+
+  public:
+    using String::operator=;
+    using Print::write;
+    size_t write(uint8_t c) override { s += (char)c; return 1; }
+    size_t write(const uint8_t *buffer, size_t size) override { s.append((const char *)buffer, size); return size; }
+    int availableForWrite() override { return 1024; }
+    int available() override { return s.length() - pos; }
+    int read() override { return pos < s.length() ? (uint8_t)s[pos++] : -1; }
+    int peek() override { return pos < s.length() ? (uint8_t)s[pos] : -1; }
+    using Stream::read;
+};
+
+#endif // _DS_FAKE_STREAMSTRING_H_
@@ -0,0 +1,13 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * ESP8266 time zone list stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_TZ_H_
+#define _DS_FAKE_TZ_H_
+
+#define TZ_Etc_UTC          PSTR("UTC0")
+#define TZ_Europe_Paris     PSTR("CET-1CEST,M3.5.0,M10.5.0/3")
+
+#endif // _DS_FAKE_TZ_H_
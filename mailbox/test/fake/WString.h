@@ -0,0 +1,167 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Arduino String stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_WSTRING_H_
+#define _DS_FAKE_WSTRING_H_
+
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+class __FlashStringHelper;
+
+// Arduino String over std::string. Only the interface used by the sketch is provided
+class String {
+  protected:
+    std::string s;
+
+    template <typename T> static std::string num(const char *fmt, T v) {
+      char buf[32];
+      snprintf(buf, sizeof(buf), fmt, v);
+      return buf;
+    }
+    static std::string num(unsigned long long v, unsigned char base) {
+      if (base == 10)
+        return num("%llu", v);
+      std::string r;
+      do {
+        const auto d = v % base;
+        r.insert(r.begin(), d < 10 ? '0' + d : 'a' + d - 10);
+        v /= base;
+      } while (v);
+      return r;
+    }
+
+  public:
+    String() {}
+    String(const String&) = default;
+    String(String&&) = default;
+    String(const char *cstr) : s(cstr ? cstr : "") {}
+    String(const char *cstr, size_t len) : s(cstr, len) {}
+    String(const std::string& str) : s(str) {}
+    String(const __FlashStringHelper *str) : String(reinterpret_cast<const char *>(str)) {}
+    explicit String(char c) : s(1, c) {}
+    explicit String(unsigned char v, unsigned char base = 10) : s(num(v, base)) {}
+    explicit String(int v, unsigned char base = 10) : s(base == 10 ? num("%d", v) : num((unsigned int)v, base)) {}
+    explicit String(unsigned int v, unsigned char base = 10) : s(num(v, base)) {}
+    explicit String(long v, unsigned char base = 10) : s(base == 10 ? num("%ld", v) : num((unsigned long)v, base)) {}
+    explicit String(unsigned long v, unsigned char base = 10) : s(num(v, base)) {}
+    explicit String(long long v) : s(num("%lld", v)) {}
+    explicit String(unsigned long long v) : s(num(v, 10)) {}
+    explicit String(float v, unsigned char decimals = 2) : String((double)v, decimals) {}
+    explicit String(double v, unsigned char decimals = 2) {
+      char buf[64];
+      snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+      s = buf;
+    }
+
+    // Access
+    const char *c_str() const { return s.c_str(); }
+    unsigned int length() const { return s.length(); }
+    bool isEmpty() const { return s.empty(); }
+    bool reserve(unsigned int size) { s.reserve(size); return true; }
+    char charAt(unsigned int i) const { return i < s.length() ? s[i] : 0; }
+    void setCharAt(unsigned int i, char c) { if (i < s.length()) s[i] = c; }
+    char operator[](unsigned int i) const { return charAt(i); }
+    char& operator[](unsigned int i) { static char dummy; return i < s.length() ? s[i] : (dummy = 0); }
+    const char *begin() const { return s.c_str(); }
+    const char *end() const { return s.c_str() + s.length(); }
+
+    // Assignment and concatenation
+    String& operator=(const String&) = default;
+    String& operator=(String&&) = default;
+    String& operator=(const char *cstr) { s = cstr ? cstr : ""; return *this; }
+    String& operator=(const __FlashStringHelper *str) { return *this = reinterpret_cast<const char *>(str); }
+    bool concat(const String& str) { s += str.s; return true; }
+    bool concat(const char *cstr) { if (cstr) s += cstr; return true; }
+    bool concat(const char *cstr, unsigned int len) { s.append(cstr, len); return true; }
+    bool concat(const __FlashStringHelper *str) { return concat(reinterpret_cast<const char *>(str)); }
+    bool concat(char c) { s += c; return true; }
+    bool concat(unsigned char v) { s += num(v, 10); return true; }
+    bool concat(int v) { s += num("%d", v); return true; }
+    bool concat(unsigned int v) { s += num(v, 10); return true; }
+    bool concat(long v) { s += num("%ld", v); return true; }
+    bool concat(unsigned long v) { s += num(v, 10); return true; }
+    bool concat(long long v) { s += num("%lld", v); return true; }
+    bool concat(unsigned long long v) { s += num(v, 10); return true; }
+    bool concat(float v) { return concat(String(v)); }
+    bool concat(double v) { return concat(String(v)); }
+    template <typename T> String& operator+=(const T& x) { concat(x); return *this; }
+    String& operator+=(const char *cstr) { concat(cstr); return *this; }
+
+    // Comparison
+    int compareTo(const String& str) const { return s.compare(str.s); }
+    bool equals(const String& str) const { return s == str.s; }
+    bool equals(const char *cstr) const { return s == (cstr ? cstr : ""); }
+    bool equalsIgnoreCase(const String& str) const { return s.length() == str.s.length() && !strcasecmp(c_str(), str.c_str()); }
+    bool operator==(const String& rhs) const { return equals(rhs); }
+    bool operator==(const char *cstr) const { return equals(cstr); }
+    bool operator==(const __FlashStringHelper *str) const { return equals(reinterpret_cast<const char *>(str)); }
+    bool operator!=(const String& rhs) const { return !equals(rhs); }
+    bool operator!=(const char *cstr) const { return !equals(cstr); }
+    bool operator<(const String& rhs) const { return s < rhs.s; }
+    bool operator>(const String& rhs) const { return s > rhs.s; }
+    bool startsWith(const String& prefix, unsigned int offset = 0) const { return s.compare(offset, prefix.s.length(), prefix.s) == 0 && offset <= s.length(); }
+    bool endsWith(const String& suffix) const { return s.length() >= suffix.s.length() && !s.compare(s.length() - suffix.s.length(), suffix.s.length(), suffix.s); }
+
+    // Search
+    int indexOf(char c, unsigned int from = 0) const { const auto p = s.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+    int indexOf(const String& str, unsigned int from = 0) const { const auto p = s.find(str.s, from); return p == std::string::npos ? -1 : (int)p; }
+    int lastIndexOf(char c) const { const auto p = s.rfind(c); return p == std::string::npos ? -1 : (int)p; }
+    int lastIndexOf(const String& str) const { const auto p = s.rfind(str.s); return p == std::string::npos ? -1 : (int)p; }
+    String substring(unsigned int from) const { return from < s.length() ? String(s.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+      if (from > to)
+        std::swap(from, to);
+      return from < s.length() ? String(s.substr(from, to - from)) : String();
+    }
+
+    // Modification
+    void replace(char find, char repl) { for (auto& c : s) if (c == find) c = repl; }
+    void replace(const String& find, const String& repl) {
+      if (find.s.empty())
+        return;
+      for (size_t p = 0; (p = s.find(find.s, p)) != std::string::npos; p += repl.s.length())
+        s.replace(p, find.s.length(), repl.s);
+    }
+    void remove(unsigned int index) { if (index < s.length()) s.erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < s.length()) s.erase(index, count); }
+    void toLowerCase() { for (auto& c : s) c = tolower(c); }
+    void toUpperCase() { for (auto& c : s) c = toupper(c); }
+    void trim() {
+      const auto b = s.find_first_not_of(" \t\r\n\f\v");
+      if (b == std::string::npos) {
+        s.clear();
+        return;
+      }
+      s = s.substr(b, s.find_last_not_of(" \t\r\n\f\v") - b + 1);
+    }
+
+    // Conversion
+    long toInt() const { return atol(c_str()); }
+    float toFloat() const { return atof(c_str()); }
+    double toDouble() const { return atof(c_str()); }
+};
+
+inline String operator+(const String& lhs, const String& rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String& lhs, const char *rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const char *lhs, const String& rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String& lhs, const __FlashStringHelper *rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String& lhs, char rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String& lhs, unsigned char rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String& lhs, int rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String& lhs, unsigned int rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String& lhs, long rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String& lhs, unsigned long rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String& lhs, long long rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String& lhs, unsigned long long rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String& lhs, float rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String& lhs, double rhs) { String r(lhs); r.concat(rhs); return r; }
+inline bool operator==(const char *lhs, const String& rhs) { return rhs == lhs; }
+
+#endif // _DS_FAKE_WSTRING_H_
@@ -0,0 +1,48 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * ESP8266 WiFiClient stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_WIFICLIENT_H_
+#define _DS_FAKE_WIFICLIENT_H_
+
+#include <Arduino.h>
+#include <memory>
+#include "IPAddress.h"
+
+// Client socket. Copies share the connection, as in ESP8266 core
+class WiFiClient : public Stream {
+  public:
+    struct Connection {
+      bool connected = true;                     // Connection status
+      std::string sent;                          // Data written
+      size_t window = SIZE_MAX;                  // Free space in the send buffer (B); drained by the test
+    };
+    std::shared_ptr<Connection> connection;      // Connection (nullptr == none)
+
+    WiFiClient() {}
+    explicit WiFiClient(std::shared_ptr<Connection> _connection) : connection(_connection) {}
+    uint8_t connected() { return connection && connection->connected; }
+    explicit operator bool() { return connected(); }
+    void stop() { if (connection) connection->connected = false; connection = nullptr; }
+    void setNoDelay(bool) {}
+    IPAddress remoteIP() const { return IPAddress(192, 168, 1, 2); }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    using Print::write;
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override {
+      if (!connected())
+        return 0;
+      const auto n = size < connection->window ? size : connection->window;
+      connection->sent.append((const char *)buffer, n);
+      if (connection->window != SIZE_MAX)
+        connection->window -= n;
+      return n;
+    }
+    int availableForWrite() override { return connected() ? (connection->window < 65535 ? connection->window : 65535) : 0; }
+};
+
+#endif // _DS_FAKE_WIFICLIENT_H_
@@ -0,0 +1,17 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * ESP8266 core declarations stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_COREDECLS_H_
+#define _DS_FAKE_COREDECLS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+uint32_t crc32(const void* /* data */, size_t /* length */, uint32_t crc = 0xffffffff); // CRC-32 as in ESP8266 core
+void settimeofday_cb(const std::function<void()>& /* cb */); // Install time sync hook (never called on the host)
+
+#endif // _DS_FAKE_COREDECLS_H_
@@ -0,0 +1,376 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Stand-ins implementation
+ * (c) DNS 2020-2023
+ */
+
+#include "fake.h"
+#include "../HostSystem.h"
+#include <FS.h>
+#include <LittleFS.h>
+#include <ESP8266WiFi.h>
+#include <ESP8266WebServer.h>
+#include <coredecls.h>
+#include <sntp.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+unsigned long fake::ms = 0;
+time_t fake::now = 0;
+static unsigned long now_ms = 0;                 // Fraction of the current second passed (ms)
+
+// Let time pass. System clock follows millis()
+void fake::advance(const unsigned long dt) {
+  ms += dt;
+  if (now) {
+    now_ms += dt;
+    now += now_ms / 1000;
+    now_ms %= 1000;
+  }
+}
+
+// System clock
+extern "C" time_t time(time_t *t) __THROW {
+  if (t)
+    *t = fake::now;
+  return fake::now;
+}
+
+extern "C" int settimeofday(const struct timeval *tv, const struct timezone*) __THROW {
+  if (!tv)
+    return -1;
+  fake::now = tv->tv_sec;
+  now_ms = 0;
+  return 0;
+}
+
+unsigned long millis() {
+  return fake::ms;
+}
+
+unsigned long micros() {
+  return fake::ms * 1000;
+}
+
+void delay(unsigned long dt) {
+  fake::advance(dt);
+}
+
+void yield() {
+}
+
+long random(long max) {
+  return max > 0 ? ::random() % max : 0;
+}
+
+long random(long min, long max) {
+  return max > min ? min + ::random() % (max - min) : min;
+}
+
+void pinMode(uint8_t, uint8_t) {
+}
+
+int digitalRead(uint8_t) {
+  return HIGH;
+}
+
+void digitalWrite(uint8_t, uint8_t) {
+}
+
+void setTZ(const char *tz) {
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+void configTime(const char *tz, const char*, const char*, const char*) {
+  setTZ(tz);
+}
+
+void settimeofday_cb(const std::function<void()>&) {
+}
+
+const char *sntp_getservername(unsigned char) {
+  return "pool.ntp.org";
+}
+
+// CRC-32 as in ESP8266 core (MSB first, no final XOR)
+uint32_t crc32(const void *data, size_t length, uint32_t crc) {
+  const uint8_t *p = (const uint8_t *)data;
+  while (length--) {
+    const uint8_t c = *p++;
+    for (uint32_t i = 0x80; i > 0; i >>= 1) {
+      bool bit = crc & 0x80000000;
+      if (c & i)
+        bit = !bit;
+      crc <<= 1;
+      if (bit)
+        crc ^= 0x04c11db7;
+    }
+  }
+  return crc;
+}
+
+// Network credentials, supplied by the sketch when Wi-Fi manager is not used
+const char *ds::System::wifi_ssid = "host";
+const char *ds::System::wifi_pass = "";
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+EspClass ESP;
+ESP8266WiFiClass WiFi;
+fs::FS LittleFS;
+
+
+/*************************************************************************
+ * Print
+ *************************************************************************/
+size_t Print::printNumber(unsigned long long n, uint8_t base) {
+  char buf[8 * sizeof(n) + 1];
+  char *p = buf + sizeof(buf);
+  if (base < 2)
+    base = 10;
+  do {
+    const auto d = n % base;
+    *--p = d < 10 ? '0' + d : 'A' + d - 10;
+    n /= base;
+  } while (n);
+  return write((const uint8_t *)p, buf + sizeof(buf) - p);
+}
+
+static size_t vprint(Print& out, const char *format, va_list args) {
+  char buf[256];
+  va_list args2;
+  va_copy(args2, args);
+  const auto len = vsnprintf(buf, sizeof(buf), format, args);
+  if (len < 0) {
+    va_end(args2);
+    return 0;
+  }
+  if ((size_t)len < sizeof(buf)) {
+    va_end(args2);
+    return out.write((const uint8_t *)buf, len);
+  }
+  std::string big(len + 1, 0);
+  vsnprintf(&big[0], big.size(), format, args2);
+  va_end(args2);
+  return out.write((const uint8_t *)big.c_str(), len);
+}
+
+size_t Print::printf(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  const auto ret = vprint(*this, format, args);
+  va_end(args);
+  return ret;
+}
+
+size_t Print::printf_P(PGM_P format, ...) {
+  va_list args;
+  va_start(args, format);
+  const auto ret = vprint(*this, format, args);
+  va_end(args);
+  return ret;
+}
+
+
+/*************************************************************************
+ * File system
+ *************************************************************************/
+using namespace fs;
+
+File::File(std::shared_ptr<Node> _node, const char *mode) : node(_node) {
+  readable = mode[0] == 'r' || strchr(mode, '+');
+  writable = mode[0] != 'r' || strchr(mode, '+');
+  append = mode[0] == 'a';
+  pos = mode[0] == 'a' && !strchr(mode, '+') ? node->data.size() : 0;
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) ? c : -1;
+}
+
+int File::peek() {
+  return readable && node && pos < node->data.size() ? node->data[pos] : -1;
+}
+
+size_t File::read(uint8_t *buffer, size_t size) {
+  if (!readable || !node)
+    return 0;
+  node->reads++;
+  const auto n = pos < node->data.size() ? std::min(size, node->data.size() - pos) : 0;
+  memcpy(buffer, node->data.data() + pos, n);
+  node->bytes_read += n;
+  pos += n;
+  return n;
+}
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+  if (!writable || !node)
+    return 0;
+  node->writes++;
+  auto& data = node->data;
+  if (append)
+    pos = data.size();
+  if (pos + size > data.size())
+    data.resize(pos + size);
+  memcpy(data.data() + pos, buffer, size);
+  node->bytes_written += size;
+  pos += size;
+  return size;
+}
+
+bool File::seek(uint32_t offset, SeekMode mode) {
+  if (!node)
+    return false;
+  switch (mode) {
+    case SeekSet: pos = offset; break;
+    case SeekCur: pos += offset; break;
+    case SeekEnd: pos = node->data.size() + offset; break;
+  }
+  return true;
+}
+
+bool File::truncate(uint32_t size) {
+  if (!writable || !node)
+    return false;
+  node->data.resize(size);
+  if (pos > size)
+    pos = size;
+  return true;
+}
+
+bool FS::info(FSInfo& fsi) {
+  memset(&fsi, 0, sizeof(fsi));
+  fsi.totalBytes = total_bytes;
+  for (const auto& f : files)
+    fsi.usedBytes += f.second->data.size();
+  fsi.blockSize = 4096;
+  fsi.pageSize = 256;
+  fsi.maxOpenFiles = 5;
+  fsi.maxPathLength = 32;
+  return true;
+}
+
+File FS::open(const char *path, const char *mode) {
+  opens++;
+  auto it = files.find(path);
+  if (mode[0] == 'r') {
+    if (it == files.end())
+      return File();
+    return File(it->second, mode);
+  }
+  if (it == files.end())
+    it = files.emplace(path, std::make_shared<Node>()).first;
+  else
+  if (mode[0] == 'w')
+    it->second->data.clear();
+  return File(it->second, mode);
+}
+
+bool FS::exists(const char *path) {
+  return files.count(path);
+}
+
+bool FS::remove(const char *path) {
+  return files.erase(path);
+}
+
+// Existing target makes rename fail, as in SPIFFS
+bool FS::rename(const char *from, const char *to) {
+  auto it = files.find(from);
+  if (it == files.end() || files.count(to))
+    return false;
+  files[to] = it->second;
+  files.erase(it);
+  return true;
+}
+
+std::shared_ptr<Node> FS::node(const char *path) {
+  const auto it = files.find(path);
+  return it == files.end() ? nullptr : it->second;
+}
+
+std::string FS::contents(const char *path) {
+  const auto n = node(path);
+  return n ? std::string(n->data.begin(), n->data.end()) : std::string();
+}
+
+
+/*************************************************************************
+ * Web server
+ *************************************************************************/
+String ESP8266WebServer::arg(const String& name) const {
+  for (const auto& a : request_args)
+    if (a.first == name)
+      return a.second;
+  return String();
+}
+
+bool ESP8266WebServer::hasArg(const String& name) const {
+  for (const auto& a : request_args)
+    if (a.first == name)
+      return true;
+  return false;
+}
+
+String ESP8266WebServer::header(const String& name) const {
+  for (const auto& h : request_headers)
+    if (h.first.equalsIgnoreCase(name))
+      return h.second;
+  return String();
+}
+
+void ESP8266WebServer::send(int _code, const char *_content_type, const String& content) {
+  code = _code;
+  content_type = _content_type;
+  response.append(content.c_str(), content.length());
+  if (content.length() && on_content)
+    on_content();
+}
+
+void ESP8266WebServer::sendContent(const char *content, size_t size) {
+  if (size) {
+    chunks++;
+    if (on_content)
+      on_content();
+  }
+  response.append(content, size);
+}
+
+// Match URI against a pattern with "{}" placeholders, collecting path arguments
+static bool matchURI(const String& pattern, const String& uri, std::vector<String>& path_args) {
+  path_args.clear();
+  const char *p = pattern.c_str(), *u = uri.c_str();
+  while (*p) {
+    if (p[0] == '{' && p[1] == '}') {
+      const char *end = strchr(u, '/');
+      if (!end)
+        end = u + strlen(u);
+      path_args.push_back(String(u, end - u));
+      u = end;
+      p += 2;
+    } else
+    if (*p++ != *u++)
+      return false;
+  }
+  return !*u;
+}
+
+// Serve a request. Returns response code (404 if no handler)
+int ESP8266WebServer::request(const String& uri, const args_t& args, const args_t& headers) {
+  code = 0;
+  content_type = "";
+  response.clear();
+  chunks = 0;
+  request_uri = uri;
+  request_args = args;
+  request_headers = headers;
+  request_client = WiFiClient(std::make_shared<WiFiClient::Connection>());
+  for (const auto& h : handlers)
+    if (matchURI(h.uri, uri, path_args)) {
+      h.fn();
+      return code;
+    }
+  return code = 404;
+}
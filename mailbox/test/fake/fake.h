@@ -0,0 +1,19 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Stand-ins control interface
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_H_
+#define _DS_FAKE_H_
+
+#include <time.h>
+
+// Both clocks are under test control. time() and settimeofday() are replaced, so that the system clock can be set freely
+namespace fake {
+  extern unsigned long ms;                       // Current value of millis()
+  extern time_t now;                             // Current value of time()
+  void advance(const unsigned long /* ms */);    // Let time pass. System clock follows millis()
+}
+
+#endif // _DS_FAKE_H_
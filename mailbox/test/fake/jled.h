@@ -0,0 +1,30 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * JLed stand-in (https://github.com/jandelgado/jled)
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_JLED_H_
+#define _DS_FAKE_JLED_H_
+
+#include <Arduino.h>
+
+// LED that only remembers its last brightness
+class JLed {
+  public:
+    uint8_t brightness = 0;                      // Last brightness set
+
+    JLed(uint8_t /* pin */) {}
+    JLed& LowActive() { return *this; }
+    JLed& On() { brightness = 255; return *this; }
+    JLed& Off() { brightness = 0; return *this; }
+    JLed& Set(uint8_t _brightness) { brightness = _brightness; return *this; }
+    JLed& Blink(uint16_t, uint16_t) { brightness = 255; return *this; }
+    JLed& Breathe(uint16_t) { brightness = 255; return *this; }
+    JLed& Repeat(uint16_t) { return *this; }
+    JLed& Forever() { return *this; }
+    JLed& Stop() { return *this; }
+    bool Update() { return false; }
+};
+
+#endif // _DS_FAKE_JLED_H_
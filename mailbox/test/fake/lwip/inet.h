@@ -0,0 +1,12 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * lwIP byte order helpers stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_LWIP_INET_H_
+#define _DS_FAKE_LWIP_INET_H_
+
+#include <arpa/inet.h>                 // htons() / ntohs()
+
+#endif // _DS_FAKE_LWIP_INET_H_
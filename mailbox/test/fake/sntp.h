@@ -0,0 +1,14 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * lwIP SNTP stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_SNTP_H_
+#define _DS_FAKE_SNTP_H_
+
+#define SNTP_UPDATE_DELAY 3600000
+
+const char *sntp_getservername(unsigned char /* idx */);
+
+#endif // _DS_FAKE_SNTP_H_
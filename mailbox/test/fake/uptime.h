@@ -0,0 +1,21 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Uptime library stand-in (https://github.com/YiannisBourkelis/Uptime-Library)
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_UPTIME_H_
+#define _DS_FAKE_UPTIME_H_
+
+#include <Arduino.h>
+
+// Uptime derived from the fake millis() clock
+namespace uptime {
+  inline void calculateUptime() {}
+  inline unsigned long getDays() { return millis() / 86400000UL; }
+  inline unsigned long getHours() { return millis() / 3600000UL % 24; }
+  inline unsigned long getMinutes() { return millis() / 60000UL % 60; }
+  inline unsigned long getSeconds() { return millis() / 1000UL % 60; }
+}
+
+#endif // _DS_FAKE_UPTIME_H_
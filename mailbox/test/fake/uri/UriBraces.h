@@ -0,0 +1,18 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * ESP8266 URI with parameters stand-in
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_FAKE_URIBRACES_H_
+#define _DS_FAKE_URIBRACES_H_
+
+#include <Arduino.h>
+
+class UriBraces {
+  public:
+    String uri;                                  // URI with "{}" placeholders
+    explicit UriBraces(const char* _uri) : uri(_uri) {}
+};
+
+#endif // _DS_FAKE_URIBRACES_H_
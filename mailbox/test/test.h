@@ -0,0 +1,80 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Minimal test framework
+ * (c) DNS 2020-2023
+ */
+
+#ifndef _DS_TEST_H_
+#define _DS_TEST_H_
+
+#include <stdio.h>
+#include <string>
+
+// Test case registration. A test file is a list of TEST() blocks; main() comes from TEST_MAIN()
+namespace test {
+  typedef void (*test_fn_t)();
+  struct Case {
+    const char *name;                            // Test name
+    test_fn_t fn;                                // Test body
+    Case *next;                                  // Next registered test
+    Case(const char *_name, test_fn_t _fn);      // Register a test
+  };
+  extern Case *cases;                            // Registered tests, in reverse order
+  extern unsigned int checks;                    // Number of checks made
+  extern unsigned int failures;                  // Number of failed checks
+
+  // Record a check result
+  inline bool check(const bool ok, const char *expr, const char *file, const int line) {
+    checks++;
+    if (!ok) {
+      failures++;
+      fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+    }
+    return ok;
+  }
+
+  // Record an equality check result
+  template <typename A, typename B>
+  bool checkEqual(const A& a, const B& b, const char *expr, const char *file, const int line) {
+    const bool ok = a == b;
+    if (!check(ok, expr, file, line))
+      fprintf(stderr, "    values: %s vs %s\n", std::to_string(a).c_str(), std::to_string(b).c_str());
+    return ok;
+  }
+  inline bool checkEqual(const std::string& a, const std::string& b, const char *expr, const char *file, const int line) {
+    const bool ok = a == b;
+    if (!check(ok, expr, file, line))
+      fprintf(stderr, "    values: \"%s\" vs \"%s\"\n", a.c_str(), b.c_str());
+    return ok;
+  }
+
+  int run();                                     // Run all tests. Returns process exit code
+}
+
+#define TEST(NAME) \
+  static void test_##NAME(); \
+  static test::Case test_case_##NAME(#NAME, test_##NAME); \
+  static void test_##NAME()
+
+#define CHECK(EXPR) test::check((EXPR), #EXPR, __FILE__, __LINE__)
+#define CHECK_EQ(A, B) test::checkEqual((A), (B), #A " == " #B, __FILE__, __LINE__)
+
+#define TEST_MAIN() \
+  test::Case *test::cases = nullptr; \
+  unsigned int test::checks = 0; \
+  unsigned int test::failures = 0; \
+  test::Case::Case(const char *_name, test_fn_t _fn) : name(_name), fn(_fn), next(cases) { cases = this; } \
+  int test::run() { \
+    Case *list = nullptr; \
+    for (auto c = cases; c; ) { auto next = c->next; c->next = list; list = c; c = next; } \
+    for (auto c = list; c; c = c->next) { \
+      const auto failures_before = failures; \
+      c->fn(); \
+      printf("%s %s\n", failures == failures_before ? "PASS" : "FAIL", c->name); \
+    } \
+    printf("%u check(s), %u failure(s)\n", checks, failures); \
+    return failures ? 1 : 0; \
+  } \
+  int main() { return test::run(); }
+
+#endif // _DS_TEST_H_
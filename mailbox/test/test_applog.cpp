@@ -0,0 +1,274 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Application log: buffering, index, pages, rotation and search
+ * (c) DNS 2020-2023
+ */
+
+#include "test.h"
+#include "fake/fake.h"
+#include <LittleFS.h>
+#include <ESP8266WebServer.h>
+
+using namespace ds;
+
+// Access to the log size
+struct HostSystem : System {
+  using System::app_log_size;
+};
+
+static const time_t T0 = 1700000000;             // 2023/11/14 22:13:20 UTC
+static const size_t LOG_SIZE_MAX = 1048576;      // Default log size limit (B)
+static const size_t INDEX_STEP = 1024;           // Log size between index entries (B)
+
+// Log index entry, as stored on disk
+typedef struct {
+  uint32_t offset;
+  uint32_t time;
+} index_entry_t;
+
+// Set both clocks to a given time
+static void setTime(const time_t t) {
+  fake::now = t;
+  System::setTime(t);
+}
+
+// Start the system over an existing or empty file system
+static void start(const bool format = true, const size_t size_max = LOG_SIZE_MAX) {
+  System::appLogFlush();
+  if (System::app_log)
+    System::app_log.close();
+  if (format)
+    LittleFS.clear();
+  Serial.tx.clear();
+  System::app_log_size_max = size_max;
+  setTime(T0);
+  System::begin();
+}
+
+// Write a line per minute, with a running number
+static void writeLines(const unsigned int from, const unsigned int to, const time_t t0 = T0) {
+  for (unsigned int i = from; i < to; i++) {
+    setTime(t0 + 60 * i);
+    System::appLogWriteLn(String("Mailbox ") + (i % 20 + 1) + ": event #" + i + ", battery " + i % 100 + "%");
+  }
+}
+
+// Return log index entries
+static std::vector<index_entry_t> index(const char *path) {
+  const auto data = LittleFS.contents(path);
+  std::vector<index_entry_t> entries(data.size() / sizeof(index_entry_t));
+  memcpy(entries.data(), data.data(), entries.size() * sizeof(index_entry_t));
+  return entries;
+}
+
+// Return true if a string contains another one
+static bool contains(const std::string& str, const std::string& what) {
+  return str.find(what) != std::string::npos;
+}
+
+TEST(lines_are_buffered_and_flushed_on_time) {
+  start();
+  const auto size = LittleFS.node("/applog.txt")->data.size();
+  System::appLogWriteLn("buffered line");
+  CHECK_EQ(LittleFS.node("/applog.txt")->data.size(), size);
+  fake::advance(9000);
+  System::update();
+  CHECK(!contains(LittleFS.contents("/applog.txt"), "buffered line"));
+  fake::advance(1000);
+  System::update();
+  CHECK(contains(LittleFS.contents("/applog.txt"), "2023/11/14 22:13:20: buffered line\r\n"));
+
+  // Important lines are written at once
+  System::appLogWriteLn("important line", true);
+  CHECK(contains(LittleFS.contents("/applog.txt"), "important line\r\n"));
+  CHECK(contains(Serial.tx, "important line"));
+}
+
+TEST(buffer_saves_writes) {
+  start();
+  const auto node = LittleFS.node("/applog.txt");
+  const auto writes = node->writes;
+  writeLines(0, 1000);
+  System::appLogFlush();
+  const auto lines = 1000u;
+  CHECK(node->writes - writes < lines / 5);      // Lines are about 50 B long; buffer is 512 B
+  CHECK_EQ(node->data.size(), (size_t)HostSystem::app_log_size);
+
+  // Time prefix follows the clock
+  CHECK(contains(LittleFS.contents("/applog.txt"), "\r\n2023/11/14 22:14:20: Mailbox 2: event #1,"));
+  CHECK(contains(LittleFS.contents("/applog.txt"), "\r\n2023/11/15 14:52:20: Mailbox 20: event #999,"));
+}
+
+TEST(index_points_to_lines) {
+  start();
+  writeLines(0, 1000);
+  System::appLogFlush();
+  const auto log = LittleFS.contents("/applog.txt");
+  const auto entries = index("/applog.idx");
+  CHECK(entries.size() >= log.size() / INDEX_STEP);
+  CHECK(entries.size() <= log.size() / INDEX_STEP + 1);
+  CHECK_EQ(entries.front().offset, 0u);
+  for (size_t i = 0; i < entries.size(); i++) {
+    const auto& entry = entries[i];
+    CHECK(entry.offset < log.size());
+    CHECK(!entry.offset || log[entry.offset - 1] == '\n');
+    CHECK_EQ(log.substr(entry.offset, 19), std::string(System::getTimeStr(entry.time).c_str()));
+    if (i) {
+      CHECK(entry.offset >= entries[i - 1].offset + INDEX_STEP);
+      CHECK(entry.offset < entries[i - 1].offset + INDEX_STEP + 100);
+    }
+  }
+}
+
+TEST(index_is_rebuilt_when_missing_or_damaged) {
+  start();
+  writeLines(0, 1000);
+  System::appLogFlush();
+  const auto original = LittleFS.contents("/applog.idx");
+
+  // Missing index
+  LittleFS.remove("/applog.idx");
+  start(false);
+  CHECK(contains(Serial.tx, "Rebuilding application log index /applog.idx"));
+  CHECK_EQ(LittleFS.contents("/applog.idx").substr(0, original.size()), original);
+
+  // Index pointing beyond the log, as after a power loss
+  System::appLogFlush();
+  auto& data = LittleFS.node("/applog.idx")->data;
+  const index_entry_t bad = {UINT32_MAX / 2, 0};
+  data.insert(data.end(), (const uint8_t *)&bad, (const uint8_t *)&bad + sizeof(bad));
+  start(false);
+  CHECK(contains(Serial.tx, "Rebuilding application log index /applog.idx"));
+  for (const auto& entry : index("/applog.idx"))
+    CHECK(entry.offset < LittleFS.node("/applog.txt")->data.size());
+
+  // Intact index is reused
+  start(false);
+  CHECK(!contains(Serial.tx, "Rebuilding"));
+}
+
+TEST(pages_follow_index) {
+  start();
+  writeLines(0, 1000);
+
+  // Latest page shows the latest lines, including buffered ones
+  CHECK_EQ(System::web_server.request("/log"), 200);
+  auto page = System::web_server.response;
+  CHECK(contains(page, "event #999,"));
+  CHECK(!contains(page, "event #900,"));
+  CHECK(contains(page, "p=1\">&lt;&lt;</a>"));
+  CHECK(contains(page, "[ &gt;&gt; ]"));
+  CHECK(System::web_server.chunks > 0);
+
+  // Each page starts with a full line and holds about one index step of the log
+  const auto pages = index("/applog.idx").size();
+  for (size_t p = 0; p < pages; p++) {
+    System::web_server.request("/log", {{"p", String(p)}});
+    page = System::web_server.response;
+    unsigned int lines = 0, partial = 0;
+    for (auto pos = page.find("<br/>"); pos != std::string::npos; pos = page.find("<br/>", pos + 1)) {
+      lines++;
+      if (page.compare(pos + 5 + 8, 2, ": "))    // "<br/>HH:MM:SS: "
+        partial++;
+    }
+    CHECK(lines > 10 || !p);                      // Latest page holds what was written since the last index entry
+    CHECK_EQ(partial, 0u);
+  }
+
+  // The oldest page has no older link
+  System::web_server.request("/log", {{"p", String(pages - 1)}});
+  CHECK(contains(System::web_server.response, "event #0,"));
+  CHECK(contains(System::web_server.response, "[ &lt;&lt; ]"));
+
+  // Page by time
+  for (const unsigned int i : {0u, 1u, 333u, 500u, 998u}) {
+    System::web_server.request("/log", {{"t", String(T0 + 60 * i)}});
+    CHECK(contains(System::web_server.response, std::string("event #") + std::to_string(i) + ","));
+  }
+}
+
+TEST(log_rotates_and_rotated_part_is_reachable) {
+  start(true, 64 * 1024);
+  const unsigned int N = 2000;                   // About 100 kiB
+  for (unsigned int i = 0; i < N; i += 10) {
+    writeLines(i, i + 10);
+    System::update();
+  }
+  System::appLogFlush();
+  CHECK(contains(Serial.tx, "Max application log size (65536) reached, rotating..."));
+  CHECK(LittleFS.exists("/applog2.txt"));
+  CHECK(LittleFS.exists("/applog2.idx"));
+  const auto log = LittleFS.contents("/applog.txt"), log2 = LittleFS.contents("/applog2.txt");
+  CHECK(log2.size() >= 32 * 1024);               // Rotated log is kept whole
+  CHECK(log.size() + log2.size() < 64 * 1024 + 512);
+  CHECK(contains(log, "event #1999,"));
+  CHECK_EQ(index("/applog.idx").front().offset, 0u);
+  CHECK(System::app_log_size_max);
+
+  // Oldest page of the current log links to the rotated log
+  const auto pages = index("/applog.idx").size();
+  System::web_server.request("/log", {{"p", String(pages - 1)}});
+  CHECK(contains(System::web_server.response, "/log?r=1\">&lt;&lt;</a>"));
+
+  // Time from the rotated log opens the rotated log
+  const auto first = log2.substr(log2.find("event #") + 7);
+  const unsigned int oldest = atoi(first.c_str());
+  System::web_server.request("/log", {{"t", String(T0 + 60 * (oldest + 5))}});
+  CHECK(contains(System::web_server.response, std::string("event #") + std::to_string(oldest + 5) + ","));
+
+  // Time older than the log opens the oldest page
+  System::web_server.request("/log", {{"t", String(T0 - 3600)}});
+  CHECK(contains(System::web_server.response, std::string("event #") + std::to_string(oldest) + ","));
+  CHECK(contains(System::web_server.response, "[ &lt;&lt; ]"));
+
+  // Search covers both logs, oldest first
+  System::web_server.request("/log/search", {{"q", "event #"}, {"mb", "20"}});
+  const auto& found = System::web_server.response;
+  const auto pos_old = found.find(std::string("event #") + std::to_string(oldest / 20 * 20 + 39) + ",");
+  const auto pos_new = found.find("event #1999,");
+  CHECK(pos_old != std::string::npos && pos_new != std::string::npos && pos_old < pos_new);
+}
+
+TEST(search_by_text_mailbox_and_time) {
+  start();
+  writeLines(0, 1000);
+  auto& web_server = System::web_server;
+
+  // Text is case insensitive
+  CHECK_EQ(web_server.request("/log/search", {{"q", "EVENT #42,"}}), 200);
+  CHECK(contains(web_server.response, "event #42,"));
+  CHECK(contains(web_server.response, "1 line(s) found"));
+  CHECK(contains(web_server.response, std::string("<a href=\"/log?t=") + std::to_string(T0 + 60 * 42) + "\">"));
+  CHECK(contains(Serial.tx, "Log search scanned 100"));     // 1000 lines plus the start line
+
+  // Mailbox number does not match its prefix (1 vs 10-19)
+  web_server.request("/log/search", {{"mb", "1"}});
+  CHECK(contains(web_server.response, "50 line(s) found"));
+  CHECK(contains(web_server.response, ": Mailbox 1: event #980,"));
+  CHECK(!contains(web_server.response, "Mailbox 11:"));
+
+  // Time range; partial time covers the whole period
+  web_server.request("/log/search", {{"q", "event"}, {"from", "2023-11-15T00:00"}, {"to", "2023/11/15 00:09"}});
+  CHECK(contains(web_server.response, "10 line(s) found"));
+  Serial.tx.clear();
+  web_server.request("/log/search", {{"q", "event"}, {"from", "2023/11/14 23"}, {"to", "2023/11/14 23"}});
+  CHECK(contains(web_server.response, "60 line(s) found"));
+  CHECK(!contains(Serial.tx, "Log search scanned 100"));     // Index lets the search skip the start of the log
+
+  // Form values are escaped
+  web_server.request("/log/search", {{"q", "\"><script>"}});
+  CHECK(contains(web_server.response, "value=\"&quot;&gt;&lt;script&gt;\""));
+  CHECK(contains(web_server.response, "0 line(s) found"));
+
+  // Overlong pattern is refused
+  web_server.request("/log/search", {{"q", std::string(65, 'x').c_str()}});
+  CHECK(contains(web_server.response, "Search text is too long (max 64 characters)"));
+  CHECK(!contains(web_server.response, "line(s) found"));
+
+  // Empty query shows just the form
+  web_server.request("/log/search");
+  CHECK(!contains(web_server.response, "line(s) found"));
+}
+
+TEST_MAIN()
+
@@ -0,0 +1,217 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Battery level estimate
+ * (c) DNS 2020-2023
+ */
+
+#include "test.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "../BatteryEstimator.h"
+#include "../BatteryHistory.h"
+
+using namespace ds;
+
+static const uint16_t VCC_000 = BatteryEstimator::VCC_REF_000;
+static const uint16_t VCC_100 = BatteryEstimator::VCC_REF_100;
+
+// Deterministic pseudo-random numbers
+static uint32_t rnd(const uint32_t max) {
+  static uint32_t state = 4242;
+  state = state * 1103515245 + 12345;
+  return (state >> 8) % max;
+}
+
+// Vcc corresponding to a battery level (0.01%)
+static uint16_t vcc(const unsigned int cp) {
+  return VCC_000 + (VCC_100 - VCC_000) * cp / 10000;
+}
+
+// Noisy Vcc reading: +-15 mV of noise, and 1 reading of 10 is an outlier of up to +-20%
+static uint16_t noisy(const uint16_t vcc) {
+  if (rnd(10) == 0)
+    return vcc - vcc / 5 + rnd(2 * vcc / 5);
+  return vcc - 15 + rnd(31);
+}
+
+// Battery discharge trace: true level (0.01%) and Vcc readings on every wakeup
+struct trace_t {
+  std::vector<unsigned int> cp;
+  std::vector<std::vector<uint16_t>> readings;
+};
+
+// Linear discharge from 100% to 0% over a number of wakeups
+static trace_t discharge(const unsigned int wakeups) {
+  trace_t trace;
+  for (unsigned int i = 0; i < wakeups; i++) {
+    const unsigned int cp = 10000 - 10000 * i / (wakeups - 1);
+    trace.cp.push_back(cp);
+    std::vector<uint16_t> readings;
+    for (uint8_t s = 0; s < BatteryEstimator::VCC_SAMPLES; s++)
+      readings.push_back(noisy(vcc(cp)));
+    trace.readings.push_back(readings);
+  }
+  return trace;
+}
+
+// Update estimate with a set of readings
+static uint8_t update(BatteryEstimator& estimator, const std::vector<uint16_t>& readings) {
+  for (const auto r : readings)
+    estimator.addVcc(r);
+  return estimator.update();
+}
+
+TEST(median_rejects_two_outliers_of_five) {
+  BatteryEstimator estimator;
+  for (const uint16_t r : {3800, 3000, 3790, 4600, 3810})
+    estimator.addVcc(r);
+  CHECK_EQ(estimator.getVcc(), 3800);
+  estimator.addVcc(1000);                        // Extra reading is ignored
+  CHECK_EQ(estimator.getVcc(), 3800);
+}
+
+TEST(first_update_sets_baseline) {
+  BatteryEstimator estimator;
+  CHECK_EQ(estimator.getLevel(), BATTERY_LEVEL_UNKNOWN);
+  CHECK_EQ(estimator.update(), BATTERY_LEVEL_UNKNOWN); // No readings
+  CHECK_EQ(update(estimator, {3775, 3775, 3775, 3775, 3775}), 50);
+  CHECK_EQ(estimator.getCP(), 5000);
+}
+
+TEST(readings_out_of_range_are_clamped) {
+  BatteryEstimator low, high;
+  CHECK_EQ(update(low, {3000, 3000, 3000, 3000, 3000}), 0);
+  CHECK_EQ(update(high, {4200, 4200, 4200, 4200, 4200}), 100);
+}
+
+TEST(estimate_survives_deep_sleep) {
+  BatteryEstimator estimator;
+  update(estimator, {3700, 3700, 3700, 3700, 3700});
+  BatteryEstimator restored;
+  restored.setCP(estimator.getCP());
+  CHECK_EQ(restored.getCP(), estimator.getCP());
+  CHECK_EQ(restored.getLevel(), 25);
+  restored.setCP(0xdead);                        // RTC memory garbage
+  CHECK_EQ(restored.getLevel(), BATTERY_LEVEL_UNKNOWN);
+}
+
+TEST(step_converges) {
+  BatteryEstimator estimator(10000);
+  unsigned int wakeups = 0;
+  while (estimator.getCP() > 5100 && wakeups < 100) {
+    update(estimator, {3775, 3775, 3775, 3775, 3775});
+    wakeups++;
+  }
+  CHECK(wakeups >= 35 && wakeups <= 40);         // 1/10 of the difference per wakeup
+  for (unsigned int i = 0; i < 50; i++)
+    update(estimator, {3775, 3775, 3775, 3775, 3775});
+  CHECK(estimator.getCP() - 5000 < 10);          // Fixed point leaves less than 0.1%
+}
+
+TEST(noisy_discharge_replay) {
+
+  // Single readings are off by up to 20% of Vcc, i.e., by any level. Median + average keep within 1% on average over a
+  // realistic discharge (8 months at a few wakeups a day); when 3 readings of 5 are outliers, it may jump by up to 10%.
+  // A fast discharge adds a lag
+  for (const unsigned int wakeups : {300u, 1000u, 3000u}) {
+    const auto trace = discharge(wakeups);
+    BatteryEstimator estimator;
+    unsigned int error_max = 0, raw_error_max = 0;
+    unsigned long error_sum = 0;
+    for (unsigned int i = 0; i < wakeups; i++) {
+      update(estimator, trace.readings[i]);
+      const auto error = (unsigned int)abs((int)estimator.getCP() - (int)trace.cp[i]);
+      error_sum += error;
+      if (error > error_max)
+        error_max = error;
+      const int raw = trace.readings[i][0];
+      const int raw_cp = raw < VCC_000 ? 0 : raw > VCC_100 ? 10000 : 10000 * (raw - VCC_000) / (VCC_100 - VCC_000);
+      const auto raw_error = (unsigned int)abs(raw_cp - (int)trace.cp[i]);
+      if (raw_error > raw_error_max)
+        raw_error_max = raw_error;
+    }
+    CHECK(error_sum / wakeups <= (wakeups >= 1000 ? 100u : 350u));
+    CHECK(error_max <= 1000);
+    CHECK(raw_error_max >= 5000);
+  }
+}
+
+static const time_t T0 = 1700000000;            // 2023/11/14 22:13:20 UTC
+static const time_t DAY = 86400;
+static const uint16_t DAYS_LEFT_UNKNOWN = BatteryHistory::DAYS_LEFT_UNKNOWN;
+
+TEST(history_needs_samples_and_discharge) {
+  BatteryHistory history;
+  CHECK_EQ(history.getDaysLeft(90), DAYS_LEFT_UNKNOWN);
+  CHECK(history.add(T0, 90));
+  CHECK(!history.add(T0 + 3600, 89));            // Too early
+  CHECK(history.add(T0 + DAY, 90));
+  CHECK_EQ(history.getDaysLeft(90), DAYS_LEFT_UNKNOWN);
+  CHECK(history.add(T0 + 2 * DAY, 90));
+  CHECK_EQ(history.getDaysLeft(90), DAYS_LEFT_UNKNOWN); // Flat
+}
+
+TEST(history_linear_discharge) {
+  BatteryHistory history;
+  for (unsigned int d = 0; d <= 20; d++)
+    history.add(T0 + d * DAY, 100 - d);
+  CHECK_EQ(history.getDaysLeft(80), 80);
+  CHECK_EQ(history.getDaysLeft(0), 0);
+}
+
+TEST(history_thinning_keeps_span) {
+
+  // A full history drops every other sample and doubles the interval, keeping the oldest sample
+  BatteryHistory history;
+  BatteryHistory::record_t rec;
+  for (unsigned int d = 0; d < 24; d++)
+    CHECK(history.add(T0 + d * DAY, 100 - d / 5));
+  history.save(rec);
+  CHECK_EQ(rec.len, 24);
+  CHECK_EQ(rec.scale, 0);
+  CHECK(history.add(T0 + 24 * DAY, 95));
+  history.save(rec);
+  CHECK_EQ(rec.len, 13);
+  CHECK_EQ(rec.scale, 1);
+  CHECK_EQ(rec.samples[0].hour, 0);
+  CHECK_EQ(rec.samples[1].hour, 48);
+  CHECK_EQ(rec.samples[12].hour, 24 * 24);
+  CHECK(!history.add(T0 + 25 * DAY, 95));        // Interval is 2 days now
+  CHECK(history.add(T0 + 26 * DAY, 95));
+
+  // Interval stops growing at 2^5 days; history then slides
+  for (unsigned int d = 27; d < 5 * 365; d++)
+    history.add(T0 + d * DAY, 90);
+  history.save(rec);
+  CHECK_EQ(rec.scale, 5);
+  CHECK_EQ(rec.len, 24);
+  CHECK(rec.samples[0].hour > 0);
+
+  BatteryHistory history2;
+  history2.load(rec);
+  BatteryHistory::record_t rec2;
+  history2.save(rec2);
+  CHECK(!memcmp(&rec, &rec2, sizeof(rec)));
+}
+
+TEST(history_slow_discharge) {
+
+  // 0.2%/day in whole percent with +-1% noise, 4 reports a day: prediction error shrinks as history grows
+  for (unsigned int run = 0; run < 20; run++) {
+    BatteryHistory history;
+    for (unsigned int h = 0; h <= 240 * 24; h += 6) {
+      const double level = 100 - 0.2 * h / 24;
+      const uint8_t b = (int)(level + 0.5) + (int)rnd(3) - 1;
+      history.add(T0 + h * 3600, b);
+      const double error = fabs(history.getDaysLeft(b) - level / 0.2) / (level / 0.2);
+      if (h == 60 * 24)
+        CHECK(error < 0.25);
+      if (h == 120 * 24 || h == 240 * 24)
+        CHECK(error < 0.1);
+    }
+  }
+}
+
+TEST_MAIN()
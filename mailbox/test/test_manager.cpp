@@ -0,0 +1,233 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Mailbox manager
+ * (c) DNS 2020-2023
+ */
+
+#include "test.h"
+#include "fake/fake.h"
+#include <limits.h>
+#include <LittleFS.h>
+#include "../MailBoxManager.h"
+
+using namespace ds;
+
+extern MailBoxManager mailbox_manager;
+
+// Start the system and mailboxes over an empty file system
+static void start() {
+  static bool started = false;
+  if (!started) {
+    LittleFS.clear();
+    fake::now = 1700000000;
+    System::begin();
+    mailbox_manager.begin();
+    started = true;
+  }
+  Serial.tx.clear();
+}
+
+// Message from a mailbox
+static MailBoxMessage message(const uint8_t mb_id, const uint16_t num) {
+  MailBoxMessage msg;
+  msg.init(1);
+  msg.setMailBoxID(mb_id);
+  msg.setMessageNumber(num);
+  msg.setBattery(80);
+  msg.setDoor(num % 2);
+  msg.terminate();
+  return msg;
+}
+
+// Process a message. Returns true if it was taken as a duplicate
+static bool duplicate(const uint8_t mb_id, const uint16_t num) {
+  Serial.tx.clear();
+  CHECK(mailbox_manager.process(message(mb_id, num)));
+  return Serial.tx.find("Duplicate message") != std::string::npos;
+}
+
+TEST(copies_inside_window_are_dropped) {
+  start();
+  CHECK(!duplicate(3, 10));
+  fake::advance(2300);
+  CHECK(duplicate(3, 10));
+  CHECK(Serial.tx.find("Duplicate message (10) from mailbox 3; ignoring") != std::string::npos);
+  fake::advance(2300);
+  CHECK(duplicate(3, 10));
+  CHECK(!duplicate(3, 11));
+  CHECK(!duplicate(4, 10));                      // Same number from another mailbox
+}
+
+TEST(copy_outside_window_is_processed) {
+  start();
+  CHECK(!duplicate(3, 20));
+  fake::advance(29999);
+  CHECK(duplicate(3, 20));
+  fake::advance(1);
+  CHECK(!duplicate(3, 20));
+}
+
+TEST(recent_messages_of_several_mailboxes) {
+
+  // Duplicates are recognized with up to 7 other messages in between
+  start();
+  for (uint8_t mb_id = 1; mb_id <= 8; mb_id++)
+    CHECK(!duplicate(mb_id, 30));
+  fake::advance(1000);
+  for (uint8_t mb_id = 1; mb_id <= 8; mb_id++)
+    CHECK(duplicate(mb_id, 30));
+}
+
+TEST(message_number_wrap) {
+  start();
+  uint16_t num = UINT16_MAX - 2;
+  for (unsigned int i = 0; i < 6; i++) {
+    CHECK(!duplicate(5, MailBoxMessage::getNextMessageNumber(num)));
+    fake::advance(100);
+  }
+  CHECK(duplicate(5, 2));                        // First number after wrap
+}
+
+TEST(millis_wrap) {
+  start();
+  fake::ms = ULONG_MAX - 1000;
+  CHECK(!duplicate(6, 40));
+  fake::advance(2000);
+  CHECK(duplicate(6, 40));
+  fake::advance(28500);
+  CHECK(!duplicate(6, 40));
+}
+
+static const unsigned int ABSENCE_TIME = VirtualMailBox::ABSENCE_TIME;
+
+// Global alarm from a full rescan of mailboxes. Alarms found are marked as seen
+static mailbox_alarm rescanAlarm(bool *seen) {
+  auto alarm = ALARM_NONE;
+  for (unsigned int id = MAILBOX_ID_MIN; id <= MAILBOX_ID_MAX; id++)
+    if (const auto mailbox = mailbox_manager[id]) {
+      seen[mailbox->getAlarm()] = true;
+      if (mailbox->getAlarm() > alarm)
+        alarm = mailbox->getAlarm();
+    }
+  return alarm;
+}
+
+TEST(global_alarm_matches_rescan) {
+
+  // Random mix of messages, acknowledgements, deletions and time passing. The global alarm is kept from per-level counts
+  // updated on every change; it must always equal the highest alarm found by scanning all mailboxes
+  start();
+  System::setTimeSyncTime(fake::now);
+  uint32_t state = 1;
+  const auto rnd = [&state](const uint32_t max) { state = state * 1103515245 + 12345; return (state >> 8) % max; };
+  uint16_t nums[MAILBOX_ID_MAX_BASIC + 1] = {};
+  bool seen[ALARM_DOOR_OPEN + 1] = {};
+  for (unsigned int step = 0; step < 20000; step++) {
+    const uint8_t mb_id = MAILBOX_ID_MIN + rnd(8);
+    switch (rnd(8)) {
+      case 0:
+      case 1:
+      case 2: {
+        MailBoxMessage msg;
+        msg.init(1);
+        msg.setMailBoxID(mb_id);
+        nums[mb_id] = MailBoxMessage::getNextMessageNumber(nums[mb_id]);
+        msg.setMessageNumber(nums[mb_id]);
+        msg.setBattery(rnd(5) ? 80 : 5);
+        msg.setBoot(!rnd(10));
+        msg.setOnline(rnd(4));
+        msg.setDoor(rnd(2));
+        msg.terminate();
+        mailbox_manager.process(msg);
+        break;
+      }
+      case 3:
+        mailbox_manager.acknowledgeAlarm(F("test"), rnd(3) ? mb_id : 0);
+        break;
+      case 4:
+        if (!rnd(4))
+          mailbox_manager.deleteMailBox(mb_id);
+        break;
+      default:
+        fake::advance(rnd(2) ? 1000 : 600000);
+        fake::now += rnd(100) ? 601 : ABSENCE_TIME + 1;
+        System::update();
+        mailbox_manager.update(!rnd(20));
+    }
+    if (!CHECK_EQ((int)mailbox_manager.getAlarm(), (int)rescanAlarm(seen)))
+      break;
+    Serial.tx.clear();
+  }
+  for (auto alarm = ALARM_NONE; alarm <= ALARM_DOOR_OPEN; alarm = (mailbox_alarm)(alarm + 1))
+    CHECK(seen[alarm]);                          // All levels have been gone through
+}
+
+TEST(mailbox_limit_and_order) {
+
+  // All IDs in scrambled order; registration stops at the limit, and registered mailboxes stay in ID order
+  start();
+  MailBoxManager mbm;
+  const auto MAILBOXES_MAX = MailBoxManager::MAILBOXES_MAX;
+  for (unsigned int i = 0; i < MAILBOX_ID_MAX; i++)
+    mbm.getMailBox(MAILBOX_ID_MIN + i * 97 % MAILBOX_ID_MAX, true);
+  CHECK_EQ(mbm.getNumMailBoxes(), MAILBOXES_MAX);
+  CHECK(Serial.tx.find("all 32 slots are in use") != std::string::npos);
+  CHECK(!mbm.getMailBoxAt(MAILBOXES_MAX));
+  for (uint8_t n = 1; n < mbm.getNumMailBoxes(); n++)
+    CHECK(mbm.getMailBoxAt(n - 1)->getID() < mbm.getMailBoxAt(n)->getID());
+
+  // Freed slots are taken by new mailboxes
+  const auto first = mbm.getMailBoxAt(0)->getID(), last = mbm.getMailBoxAt(MAILBOXES_MAX - 1)->getID();
+  mbm.deleteMailBox(first);                      // Returns false if never saved
+  mbm.deleteMailBox(last);
+  CHECK(!mbm[first] && !mbm[last]);
+  CHECK(mbm.getMailBox(255, true) && mbm.getMailBox(1, true));
+  CHECK_EQ(mbm.getNumMailBoxes(), MAILBOXES_MAX);
+  CHECK_EQ(mbm.getMailBoxAt(0)->getID(), 1);
+  CHECK_EQ(mbm.getMailBoxAt(MAILBOXES_MAX - 1)->getID(), 255);
+  for (uint8_t n = 1; n < mbm.getNumMailBoxes(); n++)
+    CHECK(mbm.getMailBoxAt(n - 1)->getID() < mbm.getMailBoxAt(n)->getID());
+}
+
+TEST(reliability_in_status) {
+
+  // Lost messages count against all windows, and the text status shows them all
+  start();
+  System::setTimeSyncTime(fake::now);
+  System::update();
+  for (const uint16_t num : {1, 3, 4})           // Message 2 is lost
+    CHECK(mailbox_manager.process(message(12, num)));
+  String text;
+  mailbox_manager.printText(text, 12);
+  if (!CHECK(text.indexOf("*75%* / *75%* / *75%* (100 msg / 24 h / 7 d)") >= 0))  // Bad values are in bold
+    fprintf(stderr, "    %s\n", text.c_str());
+}
+
+// Write a file
+static void writeFile(const char *path, const char *contents) {
+  auto file = LittleFS.open(path, "w");
+  file.print(contents);
+  file.close();
+}
+
+TEST(legacy_files_are_migrated_without_stream_timeouts) {
+
+  // Baseline text files carry no battery history; later ones do. Binary files are not recognized
+  LittleFS.clear();
+  writeFile("/mailbox1.cfg", "Front\n1690000000\n80\n1680000000\n");
+  writeFile("/mailbox2.cfg", "Back\n1690000100\n70\n1680000100\n1680000100 2\n0 90\n24 70\n");
+  writeFile("/mailbox3.dat", "DSMB");
+  const auto t0 = millis();
+  {
+    MailBoxManager mbm;
+    mbm.begin();
+    CHECK(millis() - t0 < 1000);
+    CHECK(mbm[1] && mbm[1]->getLabel() == "Front" && mbm[1]->getBattery() == 80 && mbm[1]->getLastSeen() == 1690000000);
+    CHECK(mbm[2] && mbm[2]->getLabel() == "Back" && mbm[2]->getBattery() == 70 && mbm[2]->getLastSeen() == 1690000100);
+    CHECK(!mbm[3]);
+  }
+  CHECK(!LittleFS.exists("/mailbox1.cfg") && !LittleFS.exists("/mailbox2.cfg"));
+  CHECK(LittleFS.exists("/mailbox3.dat"));
+}
+
+TEST_MAIN()
@@ -0,0 +1,215 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Communication protocol
+ * (c) DNS 2020-2023
+ */
+
+#include "test.h"
+#include "../MailBoxMessage.h"
+
+using namespace ds;
+
+// Bitwise CRC-8 (polynomial 0x07, initial value 0), as a reference for the table-driven one
+static uint8_t crc8(const uint8_t *buf, const size_t len) {
+  uint8_t crc = 0;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= buf[i];
+    for (uint8_t b = 0; b < 8; b++)
+      crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
+
+// Stream collecting the data sent
+class Sink : public Stream {
+  public:
+    std::string data;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    using Print::write;
+    size_t write(uint8_t c) override { data += (char)c; return 1; }
+};
+
+// Build a sample message of a given protocol version
+static MailBoxMessage sample(const uint8_t version, const uint8_t mb_id = 7) {
+  MailBoxMessage msg;
+  msg.init(1);
+  msg[0] = version;
+  if (version == PROTO_VERSION_EXT)
+    msg[1] = 1;
+  else
+    msg[0] |= 1 << 4;
+  msg.setMailBoxID(mb_id);
+  msg.setMessageNumber(1234);
+  msg.setTime(5000);
+  msg.setBattery(87);
+  msg.setDoor(true);
+  msg.setOnline(true);
+  msg.terminate();
+  return msg;
+}
+
+TEST(crc8_reference) {
+  CHECK_EQ(crc8((const uint8_t *)"123456789", 9), 0xF4);
+}
+
+TEST(crc8_table_matches_reference) {
+  for (const auto version : {PROTO_VERSION_CRC8, PROTO_VERSION_EXT}) {
+    auto msg = sample(version);
+    for (unsigned int n = 0; n < 1000; n++) {
+      msg.setMessageNumber(n * 7919);
+      msg.setBattery(n % 101);
+      msg.terminate();
+      Sink out;
+      msg.send(out);
+      CHECK_EQ(out.data.size(), msg.getSize());
+      CHECK_EQ((uint8_t)out.data.back(), crc8((const uint8_t *)out.data.data(), out.data.size() - 1));
+    }
+  }
+}
+
+TEST(frame_sizes) {
+  CHECK_EQ(MESSAGE_SIZE, 8u);
+  CHECK_EQ(MESSAGE_EXT_SIZE, 10u);
+  CHECK_EQ(MESSAGE_FEC_SIZE, 20u);
+  CHECK_EQ(sample(PROTO_VERSION_XOR).getSize(), MESSAGE_SIZE);
+  CHECK_EQ(sample(PROTO_VERSION_CRC8).getSize(), MESSAGE_SIZE);
+  CHECK_EQ(sample(PROTO_VERSION_EXT).getSize(), MESSAGE_EXT_SIZE);
+}
+
+TEST(fields_round_trip) {
+  for (const auto version : {PROTO_VERSION_XOR, PROTO_VERSION_CRC8, PROTO_VERSION_EXT}) {
+    const uint8_t mb_id = version == PROTO_VERSION_EXT ? 200 : 15;
+    const auto msg = sample(version, mb_id);
+    Sink out;
+    msg.send(out);
+    MailBoxMessage msg2;
+    CHECK(msg2.load((const byte *)out.data.data(), out.data.size()));
+    CHECK(msg2.protocolVersionOK());
+    CHECK(msg2.checksumOK());
+    CHECK_EQ(msg2.getProtocolVersion(), version);
+    CHECK_EQ(msg2.getReceiverID(), 1);
+    CHECK_EQ(msg2.getMailBoxID(), mb_id);
+    CHECK_EQ(msg2.getMessageNumber(), 1234);
+    CHECK_EQ(msg2.getTime(), 5000);
+    CHECK_EQ(msg2.getBattery(), 87);
+    CHECK(msg2.getDoor());
+    CHECK(msg2.getOnline());
+    CHECK(!msg2.getBoot());
+  }
+}
+
+TEST(length_mismatch_rejected) {
+  const auto msg = sample(PROTO_VERSION_EXT);
+  Sink out;
+  msg.send(out);
+  MailBoxMessage msg2;
+  CHECK(!msg2.load((const byte *)out.data.data(), MESSAGE_SIZE));
+  CHECK(!msg2.load((const byte *)out.data.data(), 0));
+  CHECK(!msg2.load((const byte *)out.data.data(), MESSAGE_FEC_SIZE + 1));
+}
+
+// Return true if a frame with given bits flipped passes the checksum
+static bool undetected(std::string data, const std::initializer_list<unsigned int> bits) {
+  for (const auto b : bits)
+    data[b / 8] ^= 1 << b % 8;
+  MailBoxMessage msg;
+  msg.load((const byte *)data.data(), data.size());
+  return msg.checksumOK();
+}
+
+TEST(crc8_catches_bit_errors) {
+
+  // Exhaustive over all 1-3 bit errors outside the version nibble. CRC-8 catches them all; XOR misses pairs of flips in the same bit position
+  for (const auto version : {PROTO_VERSION_XOR, PROTO_VERSION_CRC8}) {
+    const auto msg = sample(version);
+    Sink out;
+    msg.send(out);
+    unsigned int missed[4] = {};
+    const unsigned int bits = 8 * MESSAGE_SIZE;
+    for (unsigned int b1 = 4; b1 < bits; b1++) {
+      missed[1] += undetected(out.data, {b1});
+      for (unsigned int b2 = b1 + 1; b2 < bits; b2++) {
+        missed[2] += undetected(out.data, {b1, b2});
+        for (unsigned int b3 = b2 + 1; b3 < bits; b3++)
+          missed[3] += undetected(out.data, {b1, b2, b3});
+      }
+    }
+    CHECK_EQ(missed[1], 0u);
+    if (version == PROTO_VERSION_CRC8) {
+      CHECK_EQ(missed[2], 0u);
+      CHECK_EQ(missed[3], 0u);
+    } else
+      CHECK(missed[2] > 0);
+  }
+}
+
+TEST(fec_round_trip) {
+  for (const auto version : {PROTO_VERSION_XOR, PROTO_VERSION_CRC8, PROTO_VERSION_EXT}) {
+    const auto msg = sample(version);
+    Sink out;
+    CHECK_EQ(msg.sendFEC(out), 2 * msg.getSize());
+    MailBoxMessage msg2;
+    CHECK_EQ(msg2.decodeFEC((const byte *)out.data.data(), msg.getSize()), 0);
+    CHECK(msg2.checksumOK());
+    CHECK_EQ(msg2.getMessageNumber(), 1234);
+  }
+}
+
+TEST(fec_corrects_single_bit_per_codeword) {
+  for (const auto version : {PROTO_VERSION_CRC8, PROTO_VERSION_EXT}) {
+    const auto msg = sample(version);
+    Sink out;
+    msg.sendFEC(out);
+    for (unsigned int b = 0; b < 8 * out.data.size(); b++) {
+      auto data = out.data;
+      data[b / 8] ^= 1 << b % 8;
+      MailBoxMessage msg2;
+      CHECK_EQ(msg2.decodeFEC((const byte *)data.data(), msg.getSize()), 1);
+      CHECK(msg2.checksumOK());
+      CHECK_EQ(msg2.getBattery(), 87);
+    }
+
+    // One flip in every codeword is still recoverable
+    auto data = out.data;
+    for (size_t i = 0; i < data.size(); i++)
+      data[i] ^= 1 << i % 8;
+    MailBoxMessage msg2;
+    CHECK_EQ(msg2.decodeFEC((const byte *)data.data(), msg.getSize()), (int8_t)data.size());
+    CHECK(msg2.checksumOK());
+  }
+}
+
+TEST(fec_detects_double_bit_errors) {
+  const auto msg = sample(PROTO_VERSION_CRC8);
+  Sink out;
+  msg.sendFEC(out);
+  for (unsigned int b1 = 0; b1 < 8; b1++)
+    for (unsigned int b2 = b1 + 1; b2 < 8; b2++) {
+      auto data = out.data;
+      data[3] ^= 1 << b1 | 1 << b2;
+      MailBoxMessage msg2;
+      CHECK_EQ(msg2.decodeFEC((const byte *)data.data(), msg.getSize()), -1);
+    }
+}
+
+TEST(fec_codewords) {
+  const auto msg = sample(PROTO_VERSION_CRC8);
+  Sink out, out_fec;
+  msg.send(out);
+  msg.sendFEC(out_fec);
+  CHECK(MailBoxMessage::isFECEncoded((const byte *)out_fec.data.data(), out_fec.data.size()));
+  CHECK(!MailBoxMessage::isFECEncoded((const byte *)out.data.data(), out.data.size()));
+  auto data = out_fec.data;
+  data[5] ^= 0x20;                               // Correctable, but not a codeword as is
+  CHECK(!MailBoxMessage::isFECEncoded((const byte *)data.data(), data.size()));
+}
+
+TEST(message_number_skips_unknown_on_wrap) {
+  uint16_t num = UINT16_MAX - 1;
+  CHECK_EQ(MailBoxMessage::getNextMessageNumber(num), UINT16_MAX);
+  CHECK_EQ(MailBoxMessage::getNextMessageNumber(num), 2);    // Odd/even parity is kept
+}
+
+TEST_MAIN()
@@ -0,0 +1,64 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Radio statistics
+ * (c) DNS 2020-2023
+ */
+
+#include "test.h"
+#include "fake/fake.h"
+#include "../RadioStats.h"
+
+using namespace ds;
+
+TEST(radio_reliability_windows) {
+  const time_t t0 = 1700000000 / 86400 * 86400;
+  RadioStats stats;
+  CHECK_EQ(stats.getReliability(RadioStats::WINDOW_FRAMES, t0), -1);
+  CHECK_EQ(stats.getReliability(RadioStats::WINDOW_DAY, t0), -1);
+
+  // 3 of 4 messages received every hour for a day
+  for (unsigned int h = 0; h < 24; h++) {
+    stats.add(t0 + h * 3600, true, 3);
+    stats.add(t0 + h * 3600 + 60, false, 1);
+  }
+  const time_t t1 = t0 + 23 * 3600;
+  CHECK_EQ(stats.getReliability(RadioStats::WINDOW_FRAMES, t1), 75);
+  CHECK_EQ(stats.getReliability(RadioStats::WINDOW_DAY, t1), 75);
+  CHECK_EQ(stats.getReliability(RadioStats::WINDOW_WEEK, t1), 75);
+
+  // Partial rollover: half of the day window is perfect
+  for (unsigned int h = 24; h < 36; h++)
+    stats.add(t0 + h * 3600, true, 4);
+  const auto day = stats.getReliability(RadioStats::WINDOW_DAY, t0 + 35 * 3600);
+  CHECK(day > 75 && day < 100);
+  CHECK_EQ(stats.getReliability(RadioStats::WINDOW_FRAMES, t0 + 35 * 3600), 87);   // 48 new frames and 52 of the old ones
+
+  // Windows expire without messages
+  CHECK_EQ(stats.getReliability(RadioStats::WINDOW_DAY, t0 + 60 * 3600), -1);
+  CHECK(stats.getReliability(RadioStats::WINDOW_WEEK, t0 + 60 * 3600) > 75);
+  CHECK_EQ(stats.getReliability(RadioStats::WINDOW_WEEK, t0 + 8 * 86400), -1);
+
+  // Clock going back keeps accumulating in the newest bucket
+  stats.reset();
+  stats.add(t0 + 10 * 3600, true, 1);
+  stats.add(t0 + 5 * 3600, false, 1);
+  CHECK_EQ(stats.getReliability(RadioStats::WINDOW_DAY, t0 + 10 * 3600), 50);
+
+  // Saturation keeps the ratio
+  stats.reset();
+  for (unsigned int i = 0; i < 100; i++) {
+    stats.add(t0, true, 9);
+    stats.add(t0, false, 1);
+  }
+  const auto saturated = stats.getReliability(RadioStats::WINDOW_DAY, t0);
+  CHECK(saturated >= 85 && saturated <= 95);
+
+  // Frame window is a ring of the last 100 messages
+  stats.reset();
+  stats.add(0, false, 100);
+  stats.add(0, true, 30);
+  CHECK_EQ(stats.getReliability(RadioStats::WINDOW_FRAMES, 0), 30);
+  CHECK_EQ(stats.getReliability(RadioStats::WINDOW_DAY, 0), -1);
+}
+
+TEST_MAIN()
@@ -0,0 +1,300 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Persistent state: event history, mailbox database
+ * (c) DNS 2020-2023
+ */
+
+#include "test.h"
+#include "fake/fake.h"
+#include <LittleFS.h>
+#include <map>
+#include <set>
+#include <vector>
+#include "../EventHistory.h"
+#include "../MailBoxDB.h"
+
+using namespace ds;
+
+// Clean file system and logs
+static void reset() {
+  LittleFS.clear();
+  Serial.tx.clear();
+  System::setTimeSyncStatus(TIME_SYNC_OK);
+}
+
+// Collect events from a time range
+static std::vector<EventHistory::event_t> query(EventHistory& history, const time_t from, const time_t to) {
+  std::vector<EventHistory::event_t> events;
+  const auto n = history.query(from, to, [&events](const EventHistory::event_t& event) { events.push_back(event); });
+  CHECK_EQ(n, events.size());
+  return events;
+}
+
+// Return number of file reads made since the last call
+static unsigned long reads(const char *path) {
+  static std::map<std::string, unsigned long> last;
+  const auto node = LittleFS.node(path);
+  const auto n = node ? node->reads : 0;
+  const auto ret = n - last[path];
+  last[path] = n;
+  return ret;
+}
+
+TEST(events_need_time) {
+  reset();
+  EventHistory history(1);
+  System::setTimeSyncStatus(TIME_SYNC_NONE);
+  history.add(EVENT_OPEN, 1700000000, 50);
+  System::setTimeSyncStatus(TIME_SYNC_OK);
+  history.add(EVENT_OPEN, 0, 50);
+  CHECK(history.flush());
+  CHECK(query(history, 0, INT32_MAX).empty());
+}
+
+TEST(events_are_written_in_batches_and_rotated) {
+  reset();
+  EventHistory history(2);
+  const time_t t0 = 1700000000;
+  const unsigned int N = 1000;
+  std::set<std::shared_ptr<fs::Node>> files;     // All files ever written, including the rotated out ones
+  for (unsigned int i = 0; i < N; i++) {
+    history.add(i % 2 ? EVENT_CLOSE : EVENT_OPEN, t0 + 60 * i, 100 - i / 10, i % 3, i % 300);
+    for (const auto path : {"/events2.dat", "/events2.old"})
+      if (const auto node = LittleFS.node(path))
+        files.insert(node);
+  }
+  CHECK(LittleFS.exists("/events2.dat") && LittleFS.exists("/events2.old"));
+  unsigned long writes = 0;
+  for (const auto& node : files)
+    writes += node->writes;
+  CHECK_EQ(writes, N / EventHistory::PENDING_MAX - 1);        // Last batch is still in RAM
+
+  // History keeps between one and two segments, in time order, including the pending events
+  const auto events = query(history, 0, INT32_MAX);
+  CHECK(events.size() >= EventHistory::SEGMENT_SIZE && events.size() <= 2u * EventHistory::SEGMENT_SIZE);
+  CHECK_EQ(events.back().t, (uint32_t)(t0 + 60 * (N - 1)));
+  for (size_t i = 1; i < events.size(); i++)
+    CHECK_EQ(events[i].t, events[i - 1].t + 60);
+  CHECK_EQ(events.back().duration, (N - 1) % 300 < UINT8_MAX ? (N - 1) % 300 : UINT8_MAX);
+  CHECK(history.flush());
+  CHECK_EQ(query(history, 0, INT32_MAX).size(), events.size());
+}
+
+TEST(event_range_query_reads_little) {
+  reset();
+  EventHistory history(3);
+  const time_t t0 = 1700000000;
+  for (unsigned int i = 0; i < 500; i++)
+    history.add(EVENT_OPEN, t0 + 60 * i, 50);
+  CHECK(history.flush());
+  reads("/events3.dat");
+  reads("/events3.old");
+
+  // 11 events in the middle of the current segment
+  const auto events = query(history, t0 + 60 * 400, t0 + 60 * 410);
+  CHECK_EQ(events.size(), 11u);
+  CHECK_EQ(events.front().t, (uint32_t)(t0 + 60 * 400));
+  const auto n_reads = reads("/events3.dat") + reads("/events3.old");
+  CHECK(n_reads < 40);
+  CHECK(n_reads > 11);
+
+  // Empty range before history start
+  CHECK(query(history, 0, t0 - 1).empty());
+}
+
+TEST(events_stay_ordered_when_clock_goes_back) {
+  reset();
+  EventHistory history(4);
+  const time_t t0 = 1700000000;
+  history.add(EVENT_OPEN, t0, 50);
+  history.add(EVENT_CLOSE, t0 - 100, 50);
+  CHECK(history.flush());
+  history.add(EVENT_OPEN, t0 - 200, 50);
+  CHECK(history.flush());
+  const auto events = query(history, 0, INT32_MAX);
+  CHECK_EQ(events.size(), 3u);
+  for (const auto& event : events)
+    CHECK_EQ(event.t, (uint32_t)t0);
+}
+
+TEST(incomplete_event_record_is_dropped) {
+  reset();
+  EventHistory history(5);
+  history.add(EVENT_OPEN, 1700000000, 50);
+  CHECK(history.flush());
+  LittleFS.node("/events5.dat")->data.push_back(0xff);     // Power lost in the middle of a write
+  history.add(EVENT_CLOSE, 1700000060, 50);
+  CHECK(history.flush());
+  const auto events = query(history, 0, INT32_MAX);
+  CHECK_EQ(events.size(), 2u);
+  CHECK_EQ(events.back().type, EVENT_CLOSE);
+  EventHistory::forget(5);
+  CHECK(!LittleFS.exists("/events5.dat"));
+}
+
+// Make a mailbox record
+static mailbox_record_t record(const uint8_t id, const char *label) {
+  mailbox_record_t rec;
+  memset(&rec, 0, sizeof(rec));
+  rec.id = id;
+  rec.battery = id % 100;
+  strncpy(rec.label, label, sizeof(rec.label) - 1);
+  rec.last_seen = 1700000000 + id;
+  rec.last_boot = 1600000000 + id;
+  return rec;
+}
+
+// Load all records from database
+static std::map<uint8_t, mailbox_record_t> load(MailBoxDB& db, bool& existed) {
+  std::map<uint8_t, mailbox_record_t> records;
+  existed = db.begin();
+  mailbox_record_t rec;
+  while (db.next(rec))
+    records[rec.id] = rec;
+  return records;
+}
+
+TEST(mailbox_db_round_trip) {
+  reset();
+  bool existed;
+  {
+    MailBoxDB db;
+    CHECK(load(db, existed).empty());
+    CHECK(!existed);
+    for (unsigned int id = MAILBOX_ID_MIN; id <= MAILBOX_ID_MAX_BASIC; id++) {
+      auto rec = record(id, "box");
+      CHECK(db.save(rec));
+    }
+    auto rec = record(7, "renamed");
+    CHECK(db.save(rec));
+  }
+  const auto size = LittleFS.node(MailBoxDB::FILE_NAME)->data.size();
+  MailBoxDB db;
+  auto records = load(db, existed);
+  CHECK(existed);
+  CHECK_EQ(records.size(), (size_t)MAILBOX_ID_MAX_BASIC);
+  CHECK_EQ(std::string(records[7].label), std::string("renamed"));
+  CHECK_EQ(records[12].last_seen, 1700000012u);
+  CHECK_EQ(records[15].battery, 15);
+
+  // Erased slot is reused, so the file does not grow
+  CHECK(db.erase(9));
+  CHECK(!db.erase(9));
+  auto rec = record(9, "new");
+  CHECK(db.save(rec));
+  CHECK_EQ(LittleFS.node(MailBoxDB::FILE_NAME)->data.size(), size);
+}
+
+TEST(mailbox_db_load_is_one_sequential_pass) {
+  reset();
+  {
+    MailBoxDB db;
+    bool existed;
+    load(db, existed);
+    for (unsigned int id = MAILBOX_ID_MIN; id <= MAILBOX_ID_MAX_BASIC; id++) {
+      auto rec = record(id, "box");
+      CHECK(db.save(rec));
+    }
+  }
+  const auto opens = LittleFS.opens;
+  const auto node = LittleFS.node(MailBoxDB::FILE_NAME);
+  const auto bytes_read = node->bytes_read;
+  MailBoxDB db;
+  bool existed;
+  CHECK_EQ(load(db, existed).size(), (size_t)MAILBOX_ID_MAX_BASIC);
+  CHECK_EQ(LittleFS.opens - opens, 1ul);
+  CHECK_EQ(node->bytes_read - bytes_read, (unsigned long)node->data.size());
+}
+
+TEST(mailbox_db_save_rewrites_one_record) {
+  reset();
+  MailBoxDB db;
+  bool existed;
+  load(db, existed);
+  for (const uint8_t id : {1, 2, 3}) {
+    auto rec = record(id, "box");
+    CHECK(db.save(rec));
+  }
+  const auto node = LittleFS.node(MailBoxDB::FILE_NAME);
+  const auto data = node->data;
+  const auto bytes_written = node->bytes_written;
+  auto rec = record(2, "renamed");
+  CHECK(db.save(rec));
+  CHECK_EQ(node->bytes_written - bytes_written, (unsigned long)sizeof(mailbox_record_t));
+  CHECK_EQ(node->data.size(), data.size());
+  CHECK(std::equal(data.begin(), data.end() - 2 * sizeof(mailbox_record_t), node->data.begin()));       // Header and mailbox 1
+  CHECK(std::equal(data.end() - sizeof(mailbox_record_t), data.end(), node->data.end() - sizeof(mailbox_record_t))); // Mailbox 3
+}
+
+TEST(mailbox_db_beyond_64k) {
+
+  // Free records beyond the tracked ones are not reused, so the file may grow past 64 KiB
+  reset();
+  {
+    MailBoxDB db;
+    bool existed;
+    load(db, existed);
+  }
+  auto& data = LittleFS.node(MailBoxDB::FILE_NAME)->data;
+  data.resize(data.size() + 600 * sizeof(mailbox_record_t));
+  {
+    MailBoxDB db;
+    bool existed;
+    CHECK(load(db, existed).empty());
+    for (unsigned int id = MAILBOX_ID_MIN; id <= 20; id++) {
+      auto rec = record(id, "box");
+      CHECK(db.save(rec));
+    }
+  }
+  CHECK(data.size() > 65536);
+  MailBoxDB db;
+  bool existed;
+  auto records = load(db, existed);
+  CHECK(existed);
+  CHECK_EQ(records.size(), 20u);
+  CHECK_EQ(records[20].last_seen, 1700000020u);
+}
+
+TEST(mailbox_db_skips_corrupted_records) {
+  reset();
+  {
+    MailBoxDB db;
+    bool existed;
+    load(db, existed);
+    for (const uint8_t id : {1, 2, 3}) {
+      auto rec = record(id, "box");
+      CHECK(db.save(rec));
+    }
+  }
+  auto& data = LittleFS.node(MailBoxDB::FILE_NAME)->data;
+  data[data.size() - sizeof(mailbox_record_t) * 2 + 5] ^= 0x20;    // Damage mailbox 2
+  MailBoxDB db;
+  bool existed;
+  auto records = load(db, existed);
+  CHECK(existed);
+  CHECK_EQ(records.size(), 2u);
+  CHECK(!records.count(2));
+  CHECK(Serial.tx.find("Invalid record for mailbox=2") != std::string::npos);
+
+  // Damaged slot is reused for the next new mailbox
+  const auto size = data.size();
+  auto rec = record(4, "box");
+  CHECK(db.save(rec));
+  CHECK_EQ(LittleFS.node(MailBoxDB::FILE_NAME)->data.size(), size);
+}
+
+TEST(mailbox_db_starts_over_on_bad_header) {
+  reset();
+  auto f = LittleFS.open(MailBoxDB::FILE_NAME, "w");
+  f.write("garbage");
+  f.close();
+  MailBoxDB db;
+  bool existed;
+  CHECK(load(db, existed).empty());
+  CHECK(!existed);
+  CHECK_EQ(LittleFS.contents("/mailboxes.db.bak"), std::string("garbage"));
+  auto rec = record(1, "box");
+  CHECK(db.save(rec));
+}
+
+TEST_MAIN()
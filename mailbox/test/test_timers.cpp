@@ -0,0 +1,258 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Timer queue: firing order and equivalence with per-second scan
+ * (c) DNS 2020-2023
+ */
+
+#include "test.h"
+#include "fake/fake.h"
+#include <TZ.h>
+#include <memory>
+#include <vector>
+
+using namespace ds;
+
+// Access to the timer queue
+struct HostSystem : System {
+  using System::fireTimers;
+  using System::timer_queue;
+};
+
+// Output discarding the data
+class Null : public Print {
+  public:
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t*, size_t size) override { return size; }
+};
+static Null null;
+
+// Firing counter passed to timer callbacks
+struct Counter {
+  unsigned int fired = 0;
+  time_t last = 0;
+};
+
+static void count(const Timer*, void *context) {
+  auto counter = static_cast<Counter *>(context);
+  counter->fired++;
+  counter->last = System::time;
+}
+
+// Set current time
+static void tick(const time_t t) {
+  System::time = t;
+  localtime_r(&t, &System::tm_time);
+}
+
+// Serve timers the way the system did before the queue: check every timer every second
+static void scan(std::forward_list<TimerAbsolute *>& timers, const time_t t) {
+  tick(t);
+  for (auto it = timers.begin(), prev = timers.before_begin(); it != timers.end(); ) {
+    auto timer = *it;
+    if (timer->isArmed() && *timer == System::tm_time) {
+      timer->fire();
+      if (timer->isTransient()) {
+        it = timers.erase_after(prev);
+        continue;
+      }
+      if (!timer->isRecurrent())
+        timer->disarm();
+    }
+    if (timer->getType() == TIMER_COUNTDOWN_ABS)
+      static_cast<TimerCountdownAbs *>(timer)->update(t);
+    prev = it++;
+  }
+}
+
+// Deterministic pseudo-random numbers
+static uint32_t rnd(const uint32_t max) {
+  static uint32_t state = 12345;
+  state = state * 1103515245 + 12345;
+  return (state >> 8) % max;
+}
+
+// Random timer mix: absolute timers on random days, countdowns, one-shots and transients
+static void makeTimers(std::vector<std::unique_ptr<TimerAbsolute>>& timers, const unsigned int n) {
+  for (unsigned int i = 0; i < n; i++) {
+    const bool armed = rnd(10), recurrent = rnd(8), transient = !recurrent && rnd(2);
+    if (rnd(4))
+      timers.emplace_back(new TimerAbsolute("abs", rnd(24), rnd(60), rnd(60), 1 + rnd(TIMER_DOW_ANY), armed, recurrent, transient, i));
+    else {
+      const float interval = 60 * (1 + rnd(180));
+      timers.emplace_back(new TimerCountdownAbs("countdown", interval, rnd(interval), TIMER_DOW_ANY, armed, recurrent, transient, i));
+    }
+  }
+}
+
+// Clean timer state
+static void reset() {
+  System::log = &null;
+  System::timers.clear();
+  System::rescheduleTimers();
+}
+
+TEST(queue_matches_scan_across_dst_change) {
+  setTZ(TZ_Europe_Paris);
+  reset();
+  const unsigned int N = 200;
+  std::vector<std::unique_ptr<TimerAbsolute>> timers_queue, timers_scan;
+  makeTimers(timers_queue, N);
+  std::vector<Counter> counters_queue(N), counters_scan(N);
+  std::forward_list<TimerAbsolute *> scan_list;
+
+  // Same mix again for the scanning loop
+  for (unsigned int i = 0; i < N; i++) {
+    auto timer = timers_queue[i].get();
+    timer->setCallback(count, &counters_queue[i]);
+    System::addTimer(timer);
+    TimerAbsolute *copy;
+    if (timer->getType() == TIMER_COUNTDOWN_ABS) {
+      const auto countdown = static_cast<TimerCountdownAbs *>(timer);
+      copy = new TimerCountdownAbs("countdown", countdown->getInterval(), countdown->getOffset(), TIMER_DOW_ANY,
+        timer->isArmed(), timer->isRecurrent(), timer->isTransient(), i);
+    } else
+      copy = new TimerAbsolute("abs", timer->getHour(), timer->getMinute(), timer->getSecond(), timer->getDayOfWeek(),
+        timer->isArmed(), timer->isRecurrent(), timer->isTransient(), i);
+    copy->setCallback(count, &counters_scan[i]);
+    timers_scan.emplace_back(copy);
+    scan_list.push_front(copy);
+  }
+
+  // 2023/03/24 00:00:01 CET - 2023/03/28 00:00:00 CEST, over the switch to summer time. Midnight is skipped, as the scanning
+  //// loop compares countdowns before their first update, and fires them at 00:00:00 once
+  const time_t t0 = 1679612400 + 1, t1 = t0 + 4 * 24 * 3600 - 3600;
+  unsigned int fired_queue = 0, fired_scan = 0;
+  for (auto t = t0; t < t1; t++) {
+    tick(t);
+    HostSystem::fireTimers(t);
+    scan(scan_list, t);
+  }
+  for (unsigned int i = 0; i < N; i++) {
+    fired_queue += counters_queue[i].fired;
+    fired_scan += counters_scan[i].fired;
+    if (!CHECK_EQ(counters_queue[i].fired, counters_scan[i].fired))
+      fprintf(stderr, "    timer %u (%s)\n", i, timers_queue[i]->getAction().c_str());
+  }
+  CHECK_EQ(fired_queue, fired_scan);
+  CHECK(fired_queue > N);
+  reset();
+  setTZ(TZ_Etc_UTC);
+}
+
+TEST(firing_time_and_day_of_week) {
+  reset();
+  Counter counter;
+  TimerAbsolute timer("monday", 7, 30, 15, TIMER_DOW_MONDAY);
+  timer.setCallback(count, &counter);
+  System::addTimer(&timer);
+  const time_t t0 = 1673740800;                  // 2023/01/15 00:00:00 UTC, Sunday
+  for (auto t = t0; t < t0 + 8 * 24 * 3600; t++) {
+    tick(t);
+    HostSystem::fireTimers(t);
+  }
+  CHECK_EQ(counter.fired, 1u);
+  CHECK_EQ(counter.last, t0 + 24 * 3600 + 7 * 3600 + 30 * 60 + 15);
+  reset();
+}
+
+TEST(one_shot_and_transient) {
+  reset();
+  Counter once, transient;
+  TimerAbsolute timer_once("once", 0, 0, 10, TIMER_DOW_ANY, true, false);
+  TimerAbsolute timer_transient("transient", 0, 0, 20, TIMER_DOW_ANY, true, false, true);
+  timer_once.setCallback(count, &once);
+  timer_transient.setCallback(count, &transient);
+  System::addTimer(&timer_once);
+  System::addTimer(&timer_transient);
+  const time_t t0 = 1673740800;
+  for (auto t = t0; t < t0 + 2 * 24 * 3600; t++) {
+    tick(t);
+    HostSystem::fireTimers(t);
+  }
+  CHECK_EQ(once.fired, 1u);
+  CHECK(!timer_once.isArmed());
+  CHECK_EQ(transient.fired, 1u);
+  CHECK_EQ(std::distance(System::timers.begin(), System::timers.end()), 1);
+
+  // Disarmed timer stays in the queue and fires once armed again
+  timer_once.arm();
+  for (auto t = t0 + 2 * 24 * 3600; t < t0 + 3 * 24 * 3600; t++) {
+    tick(t);
+    HostSystem::fireTimers(t);
+  }
+  CHECK_EQ(once.fired, 2u);
+  reset();
+}
+
+TEST(idle_second_does_not_touch_timers) {
+  reset();
+  std::vector<std::unique_ptr<TimerAbsolute>> timers;
+  for (uint8_t i = 0; i < 100; i++) {
+    timers.emplace_back(new TimerAbsolute("idle", 12, i % 60, 0));
+    System::addTimer(timers.back().get());
+  }
+  const time_t t0 = 1673740800;
+  tick(t0);
+  HostSystem::fireTimers(t0);
+  CHECK_EQ(HostSystem::timer_queue.size(), 100u);
+  const auto next = HostSystem::timer_queue.front().first;
+  CHECK_EQ(next, t0 + 12 * 3600);
+  for (auto t = t0 + 1; t < t0 + 3600; t++) {
+    tick(t);
+    HostSystem::fireTimers(t);
+  }
+  CHECK_EQ(HostSystem::timer_queue.front().first, next);
+  reset();
+}
+
+// Callback removing a timer (Timer is a virtual base, so the timer is passed separately)
+static TimerAbsolute *timer_to_remove = nullptr;
+static void removing(const Timer* timer, void *context) {
+  count(timer, context);
+  System::removeTimer(timer_to_remove);
+}
+
+TEST(timer_removed_while_firing) {
+  reset();
+  Counter counter;
+  TimerAbsolute timer("self-removing", 0, 1, 0);
+  timer.setCallback(removing, &counter);
+  timer_to_remove = &timer;
+  System::addTimer(&timer);
+  const time_t t0 = 1673740800;
+  for (auto t = t0; t < t0 + 2 * 24 * 3600; t++) {
+    tick(t);
+    HostSystem::fireTimers(t);
+  }
+  CHECK_EQ(counter.fired, 1u);
+  CHECK(System::timers.empty());
+  CHECK(HostSystem::timer_queue.empty());
+  reset();
+}
+
+TEST(time_jump_rebuilds_queue_without_catching_up) {
+  reset();
+  Counter counter;
+  TimerAbsolute timer("jumped over", 1, 0, 0);
+  timer.setCallback(count, &counter);
+  System::addTimer(&timer);
+  const time_t t0 = 1673740800;
+  tick(t0);
+  HostSystem::fireTimers(t0);
+  tick(t0 + 2 * 3600);                           // Clock sync moves time past the firing
+  HostSystem::fireTimers(t0 + 2 * 3600);
+  CHECK_EQ(counter.fired, 0u);
+  CHECK_EQ(HostSystem::timer_queue.front().first, t0 + 25 * 3600);
+
+  // Timer added while running is picked up on the next second
+  Counter counter2;
+  TimerAbsolute timer2("added", 2, 0, 1);
+  timer2.setCallback(count, &counter2);
+  System::addTimer(&timer2);
+  tick(t0 + 2 * 3600 + 1);
+  HostSystem::fireTimers(t0 + 2 * 3600 + 1);
+  CHECK_EQ(counter2.fired, 1u);
+  reset();
+}
+
+TEST_MAIN()
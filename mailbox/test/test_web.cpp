@@ -0,0 +1,226 @@
+/* DS mailbox automation
+ * * Host tests
+ * * * Web pages
+ * (c) DNS 2020-2023
+ */
+
+#include "test.h"
+#include "fake/fake.h"
+#include <LittleFS.h>
+#include <ESP8266HTTPClient.h>
+#include "../MailBoxManager.h"
+#include "../WebEvents.h"
+
+using namespace ds;
+
+extern MailBoxManager mailbox_manager;
+extern WebEvents web_events;
+
+// Start the system and mailboxes over an empty file system
+static void start() {
+  static bool started = false;
+  if (!started) {
+    LittleFS.clear();
+    fake::now = 1700000000;
+    System::begin();
+    System::setTimeSyncTime(fake::now);
+    System::update();
+    mailbox_manager.begin();
+    started = true;
+  }
+  Serial.tx.clear();
+}
+
+// Message from a mailbox
+static MailBoxMessage message(const uint8_t mb_id, const uint16_t num) {
+  MailBoxMessage msg;
+  msg.init(1);
+  msg.setMailBoxID(mb_id);
+  msg.setMessageNumber(num);
+  msg.setBattery(80);
+  msg.setDoor(num % 2);
+  msg.terminate();
+  return msg;
+}
+
+// Serve a request with a single argument
+static int request(const char *uri, const char *name, const char *value) {
+  return System::web_server.request(uri, {{name, value}});
+}
+
+// Return true if the last response contains the text
+static bool responded(const char *text) {
+  return System::web_server.response.find(text) != std::string::npos;
+}
+
+// Number of event rows in the last history page
+static unsigned int rows() {
+  unsigned int n = 0;
+  const auto& page = System::web_server.response;
+  for (auto pos = page.find("<tr><td>", page.find("<th>Time</th>")); pos != std::string::npos;
+    pos = page.find("<tr><td>", pos + 1))
+    n++;
+  return n;
+}
+
+TEST(history_range) {
+  start();
+  const time_t t0 = fake::now;
+  uint16_t num = 0;
+  for (unsigned int i = 0; i < 10; i++) {
+    num = MailBoxMessage::getNextMessageNumber(num);
+    CHECK(mailbox_manager.process(message(3, num)));
+    fake::advance(60000);
+    System::update();
+  }
+  CHECK_EQ(System::web_server.request("/history", {{"id", "3"}}), HTTP_CODE_OK);
+  CHECK_EQ(rows(), 10u);
+  const auto from = std::to_string(t0 + 120), to = std::to_string(t0 + 300);
+  CHECK_EQ(System::web_server.request("/history", {{"id", "3"}, {"from", from.c_str()}, {"to", to.c_str()}}), HTTP_CODE_OK);
+  CHECK_EQ(rows(), 4u);
+  CHECK_EQ(System::web_server.request("/history", {{"id", "3"}, {"to", std::to_string(t0 - 1).c_str()}}), HTTP_CODE_OK);
+  CHECK(responded("No events"));
+}
+
+TEST(history_rejects_bad_ids) {
+  start();
+  CHECK(mailbox_manager.process(message(12, 1)));
+  for (const auto id : {"", "0", "-1", "256", "268", "abc"}) {
+    CHECK_EQ(request("/history", "id", id), HTTP_CODE_BAD_REQUEST);
+    CHECK(responded("Invalid Parameters"));
+  }
+  CHECK_EQ(System::web_server.request("/history"), HTTP_CODE_BAD_REQUEST);
+  CHECK_EQ(request("/history", "id", "9"), HTTP_CODE_NOT_FOUND);
+  CHECK(responded("Mailbox Not Found"));
+  CHECK_EQ(request("/history", "id", "12"), HTTP_CODE_OK);
+}
+
+TEST(other_pages_reject_bad_ids) {
+  start();
+  CHECK_EQ(request("/mailbox", "id", "268"), HTTP_CODE_BAD_REQUEST);     // Would be 12 if truncated to 8 bits
+  CHECK_EQ(request("/mailbox", "id", "9"), HTTP_CODE_NOT_FOUND);
+  CHECK_EQ(request("/mailbox", "id", "12"), HTTP_CODE_OK);
+  CHECK(responded("/history?id=12"));
+  CHECK_EQ(System::web_server.request("/save", {{"id", "268"}, {"label", "x"}, {"action", "save"}}), HTTP_CODE_BAD_REQUEST);
+  CHECK_EQ(System::web_server.request("/save", {{"id", "9"}, {"label", "x"}, {"action", "save"}}), HTTP_CODE_NOT_FOUND);
+  CHECK_EQ(System::web_server.request("/save", {{"id", "12"}, {"label", "x"}, {"action", "save"}}), HTTP_CODE_OK);
+  CHECK(mailbox_manager[12]->getLabel() == "x");
+  CHECK_EQ(request("/ack", "id", "268"), HTTP_CODE_BAD_REQUEST);
+  CHECK_EQ(request("/ack", "id", "12"), HTTP_CODE_OK);
+  CHECK_EQ(System::web_server.request("/ack"), HTTP_CODE_OK);
+}
+
+TEST(api_etag_and_ids) {
+  start();
+  auto& server = System::web_server;
+  CHECK_EQ(server.request("/api/v1/mailboxes"), HTTP_CODE_OK);
+  CHECK(responded("\"id\":12"));
+  CHECK_EQ(server.request("/api/v1/mailboxes/12"), HTTP_CODE_OK);
+  CHECK(server.response.rfind("{\"id\":12", 0) == 0);
+
+  // Unchanged state is not rendered again
+  const auto etag = mailbox_manager.getETag();
+  CHECK_EQ(server.request("/api/v1/mailboxes", {}, {{"If-None-Match", etag}}), HTTP_CODE_NOT_MODIFIED);
+  CHECK(server.response.empty());
+  CHECK_EQ(server.request("/api/v1/mailboxes/12", {}, {{"If-None-Match", etag}}), HTTP_CODE_NOT_MODIFIED);
+
+  // Bad IDs are refused whatever the tag
+  for (const auto& headers : {ESP8266WebServer::args_t{}, ESP8266WebServer::args_t{{"If-None-Match", etag}}}) {
+    CHECK_EQ(server.request("/api/v1/mailboxes/9", {}, headers), HTTP_CODE_NOT_FOUND);
+    CHECK_EQ(server.request("/api/v1/mailboxes/0", {}, headers), HTTP_CODE_BAD_REQUEST);
+    CHECK_EQ(server.request("/api/v1/mailboxes/256", {}, headers), HTTP_CODE_BAD_REQUEST);
+    CHECK_EQ(server.request("/api/v1/mailboxes/abc", {}, headers), HTTP_CODE_BAD_REQUEST);
+  }
+
+  // Any mailbox update changes the tag
+  CHECK(mailbox_manager.process(message(12, 5)));
+  CHECK(mailbox_manager.getETag() != etag);
+  CHECK_EQ(server.request("/api/v1/mailboxes/12", {}, {{"If-None-Match", etag}}), HTTP_CODE_OK);
+}
+
+// Subscribe to events. Returns the connection of the subscriber
+static std::shared_ptr<WiFiClient::Connection> subscribe() {
+  CHECK_EQ(System::web_server.request("/events"), 0);          // Response goes straight to the client
+  return System::web_server.client().connection;
+}
+
+// Number of occurrences of a text in a string
+static unsigned int occurrences(const std::string& str, const char *text) {
+  unsigned int n = 0;
+  for (auto pos = str.find(text); pos != std::string::npos; pos = str.find(text, pos + 1))
+    n++;
+  return n;
+}
+
+TEST(events_push_state_changes_at_once) {
+  start();
+  const auto sub = subscribe();
+  CHECK(sub->sent.rfind("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n", 0) == 0);
+  CHECK(sub->sent.find("event: alarm\n") != std::string::npos);
+  CHECK(sub->sent.find("event: mailbox\ndata: {\"id\":12,\"html\":\"<tr id=\\\"mb12\\\"") != std::string::npos);
+
+  // Message, timeout and acknowledgement are on the wire when the call returns
+  sub->sent.clear();
+  CHECK(mailbox_manager.process(message(12, 7)));
+  CHECK(sub->sent.find("event: mailbox\ndata: {\"id\":12,") != std::string::npos);
+  sub->sent.clear();
+  mailbox_manager[12]->timeout();
+  CHECK(sub->sent.find("event: mailbox\ndata: {\"id\":12,") != std::string::npos);
+  sub->sent.clear();
+  mailbox_manager.acknowledgeAlarm(F("test"), 12);
+  CHECK(sub->sent.find("event: alarm\n") != std::string::npos);
+  CHECK(sub->sent.find("event: mailbox\ndata: {\"id\":12,") != std::string::npos);
+
+  // Forgotten mailbox is sent without a row
+  sub->sent.clear();
+  CHECK(mailbox_manager.process(message(14, 1)));
+  mailbox_manager.deleteMailBox(14);
+  web_events.update();
+  CHECK(sub->sent.find("event: mailbox\ndata: {\"id\":14,\"html\":\"\"}\n\n") != std::string::npos);
+  sub->connected = false;
+}
+
+TEST(events_never_wait_for_a_slow_subscriber) {
+  start();
+  const auto slow = subscribe(), fast = subscribe();
+  slow->sent.clear();
+  fast->sent.clear();
+
+  // Full socket: changes pile up as one pending event per mailbox, and the other subscriber is served
+  slow->window = 0;
+  uint16_t num = 10;
+  for (unsigned int i = 0; i < 5; i++) {
+    num = MailBoxMessage::getNextMessageNumber(num);
+    CHECK(mailbox_manager.process(message(12, num)));
+  }
+  CHECK(slow->sent.empty());
+  CHECK_EQ(occurrences(fast->sent, "event: mailbox\n"), 5u);
+  slow->window = SIZE_MAX;
+  web_events.update();
+  CHECK_EQ(occurrences(slow->sent, "event: mailbox\n"), 1u);
+
+  // Subscriber taking nothing for STALL_TIMEOUT is dropped
+  slow->window = 0;
+  CHECK(mailbox_manager.process(message(12, MailBoxMessage::getNextMessageNumber(num))));
+  fake::advance(WebEvents::STALL_TIMEOUT);
+  web_events.update();
+  CHECK(!slow->connected);
+  CHECK(fast->connected);
+  CHECK(Serial.tx.find("is stalled; dropping") != std::string::npos);
+  fast->connected = false;
+}
+
+TEST(events_subscribers_are_bounded) {
+  start();
+  std::vector<std::shared_ptr<WiFiClient::Connection>> subs;
+  for (uint8_t n = 0; n < WebEvents::SUBSCRIBERS_MAX; n++)
+    subs.push_back(subscribe());
+  CHECK_EQ(System::web_server.request("/events"), HTTP_CODE_SERVICE_UNAVAILABLE);
+  subs.front()->connected = false;
+  subs.front() = subscribe();
+  CHECK(subs.front()->connected);
+  for (const auto& sub : subs)
+    sub->connected = false;
+}
+
+TEST_MAIN()
@@ -10,6 +10,10 @@
 
 #include "MailBoxManager.h"         // Mailbox manager
 #include "GoogleAssistant.h"        // Google interface
+#include "WebEvents.h"              // Web events
+#include <limits>                   // std::numeric_limits
+#include <uri/UriBraces.h>          // URI with parameters
+#include <ESP8266HTTPClient.h>      // HTTP_CODE_*
 #ifdef DS_SUPPORT_TELEGRAM
 #include "Telegram.h"               // Telegram interface
 #endif // DS_SUPPORT_TELEGRAM
@@ -19,13 +23,14 @@ using namespace ds;
 // Server data providers
 extern MailBoxManager mailbox_manager;     // Mailbox manager instance
 extern GoogleAssistant google_assistant;   // Google interface
+extern WebEvents web_events;               // Web events
 #ifdef DS_SUPPORT_TELEGRAM
 extern Telegram telegram;                  // Telegram interface
 #endif // DS_SUPPORT_TELEGRAM
 
 // Initialize page buffer with page header
 static void pushHeader(const String& title, bool redirect = false) {
-  String &page = System::web_page;
+  auto &page = System::web_page;
   String uri = System::web_server.uri();
 
   // UTF-8 'OPEN MAILBOX WITH RAISED FLAG'
@@ -45,7 +50,28 @@ static void pushHeader(const String& title, bool redirect = false) {
     "  .alarm5 { font-weight: bold; color: red; }\n"
     "  .alarm6 { font-weight: bold; color: red; animation: blinker 0.6s linear infinite; }\n"
     "  @keyframes blinker { 50% { opacity: 0; } }\n"
-    "</style>\n") : F("");
+    "</style>\n"
+
+    // Live update of mailbox table. Server sends the whole state on (re)connection, and then every change as it happens.
+    // Mailbox events carry the table row as printed by VirtualMailBox::printHTML(). Unknown mailbox means a new one has
+    // registered; reload the page then. Empty row means the mailbox has been forgotten
+    "<script>\n"
+    "if (window.EventSource) {\n"
+    "  const es = new EventSource('/events');\n"
+    "  es.addEventListener('alarm', e => {\n"
+    "    const s = JSON.parse(e.data);\n"
+    "    document.getElementById('g_icon').textContent = s.alarm_icon;\n"
+    "    document.getElementById('g_status').innerHTML = '<span class=\"alarm' + s.alarm + '\">' + s.alarm_str + '</span>';\n"
+    "    document.getElementById('g_ack').disabled = !s.alarm;\n"
+    "  });\n"
+    "  es.addEventListener('mailbox', e => {\n"
+    "    const m = JSON.parse(e.data), row = document.getElementById('mb' + m.id);\n"
+    "    if (row && m.html) row.outerHTML = m.html;\n"
+    "    else if (row) row.remove();\n"
+    "    else if (m.html) location.reload();\n"
+    "  });\n"
+    "}\n"
+    "</script>\n") : F("");
 
   System::pushHTMLHeader(title, head_user, redirect);
   page += F("<h3>");
@@ -74,6 +100,12 @@ static void pushFooter() {
   System::pushHTMLFooter();
 }
 
+// Parse mailbox ID argument. Returns 0 if it is not a valid ID
+static uint8_t parseID(const String& arg) {
+  const auto id = arg.toInt();
+  return id >= MAILBOX_ID_MIN && id <= MAILBOX_ID_MAX ? id : 0;
+}
+
 // Serve the root page
 static void serveRoot() {
   pushHeader(F("Mailbox Manager"));
@@ -87,12 +119,12 @@ static void serveRoot() {
 // Serve the mailbox page
 static void serveMailBox() {
   if (System::web_server.args() == 1) {
-    const uint8_t id = System::web_server.arg(0).toInt();
+    const auto id = parseID(System::web_server.arg(0));
     if (id) {
       const auto mailbox = mailbox_manager[id];
       if (mailbox) {
         pushHeader((String)"Mailbox " + mailbox->getName());
-        String &page = System::web_page;
+        auto &page = System::web_page;
         page += F("<form action=\"/save\">\n"
                   "<input type=\"hidden\" name=\"id\" value=\"");
         page += id;
@@ -103,17 +135,132 @@ static void serveMailBox() {
         page += F("\"/></p>\n"
                   "<p><button type=\"submit\" name=\"action\" value=\"save\">Save</button> "
                   "<button type=\"submit\" name=\"action\" value=\"del\"/>Forget Mailbox</button></p>\n"
-                  "</form>\n");
-      } else
+                  "</form>\n"
+                  "<p><a href=\"/history?id=");
+        page += id;
+        page += F("\">Event history</a></p>\n");
+      } else {
         pushHeader(F("Mailbox Not Found"));
-    } else
+        System::web_page.setCode(HTTP_CODE_NOT_FOUND);
+      }
+    } else {
       pushHeader(F("Invalid Parameters"));
+      System::web_page.setCode(HTTP_CODE_BAD_REQUEST);
+    }
+  } else {
+    pushHeader(F("Invalid Parameters"));
+    System::web_page.setCode(HTTP_CODE_BAD_REQUEST);
+  }
+  pushFooter();
+  System::sendWebPage();
+}
+
+// Serve the mailbox event history page
+//// Time range is given in seconds since epoch; either end may be omitted
+static void serveHistory() {
+  uint8_t id = 0;
+  time_t from = 0, to = std::numeric_limits<time_t>::max();
+  for (unsigned int i = 0; i < (unsigned int)System::web_server.args(); i++) {
+    String arg_name = System::web_server.argName(i);
+    if (arg_name == "id")
+      id = parseID(System::web_server.arg(i));
+    else
+    if (arg_name == "from")
+      from = System::web_server.arg(i).toInt();
+    else
+    if (arg_name == "to")
+      to = System::web_server.arg(i).toInt();
+  }
+
+  const auto mailbox = id ? mailbox_manager[id] : nullptr;
+  if (mailbox) {
+    pushHeader((String)"Mailbox " + mailbox->getName() + " History");
+    auto &page = System::web_page;
+    page += F("<center>\n"
+      "<table border=\"1\" cellpadding=\"3\" cellspacing=\"0\" style=\"font-family: monospace; border-collapse: collapse;\">\n"
+      "<tr><th>Time</th><th>Event</th><th>Open (s)</th><th>Battery</th><th>Lost</th></tr>\n");
+    const auto n = mailbox->getEventHistory().query(from, to, [&page](const EventHistory::event_t& event) {
+      char time_str[20];
+      const time_t t = event.t;
+      strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", localtime(&t));
+      page += F("<tr><td>");
+      page += time_str;
+      page += F("</td><td>");
+      page += EventHistory::getTypeStr(event.type);
+      page += F("</td><td>");
+      if (event.type == EVENT_CLOSE)
+        page += event.duration;
+      page += F("</td><td>");
+      if (event.battery != BATTERY_LEVEL_UNKNOWN) {
+        page += event.battery;
+        page += F("%");
+      }
+      page += F("</td><td>");
+      if (event.lost)
+        page += event.lost;
+      page += F("</td></tr>\n");
+    });
+    if (!n)
+      page += F("<tr><td colspan=\"5\" style=\"text-align: center\">- No events -</tr>\n");
+    page += F("</table>\n</center>\n");
   } else
+  if (id) {
+    pushHeader(F("Mailbox Not Found"));
+    System::web_page.setCode(HTTP_CODE_NOT_FOUND);
+  } else {
     pushHeader(F("Invalid Parameters"));
+    System::web_page.setCode(HTTP_CODE_BAD_REQUEST);
+  }
   pushFooter();
   System::sendWebPage();
 }
 
+// Serve mailbox state in JSON (all mailboxes if ID is 0)
+//// Responses are tagged with the state version, so polling clients get "304 Not Modified" without rendering until something changes
+static void serveAPI(const uint8_t id) {
+  auto &server = System::web_server;
+  const auto mailbox = id ? mailbox_manager[id] : nullptr;
+  if (id && !mailbox) {
+    server.send(HTTP_CODE_NOT_FOUND, "application/json", F("{\"error\":\"Mailbox not found\"}"));
+    return;
+  }
+
+  const auto etag = mailbox_manager.getETag();
+  server.sendHeader(F("ETag"), etag);
+  server.sendHeader(F("Cache-Control"), F("no-cache"));
+  if (server.header(F("If-None-Match")).indexOf(etag) >= 0) {
+    server.send(HTTP_CODE_NOT_MODIFIED);
+    return;
+  }
+
+  auto &page = System::web_page;
+  page.begin("application/json");
+  if (mailbox)
+    mailbox->printJSON(page);
+  else
+    mailbox_manager.printJSON(page);
+  System::sendWebPage();
+}
+
+// Serve the state of all mailboxes in JSON
+static void serveAPIMailBoxes() {
+  serveAPI(0);
+}
+
+// Serve the state of one mailbox in JSON
+static void serveAPIMailBox() {
+  const auto id = System::web_server.pathArg(0).toInt();
+  if (id > 0 && id <= MAILBOX_ID_MAX)
+    serveAPI(id);
+  else
+    System::web_server.send(HTTP_CODE_BAD_REQUEST, "application/json", F("{\"error\":\"Invalid mailbox ID\"}"));
+}
+
+// Serve the live events subscription
+static void serveEvents() {
+  web_events.subscribe();
+}
+
 // Serve the mailbox configuration saving page
 static void serveSave() {
   if (System::web_server.args() == 3) {
@@ -123,8 +270,8 @@ static void serveSave() {
     for (unsigned int i = 0; i < (unsigned int)System::web_server.args(); i++) {
       String arg_name = System::web_server.argName(i);
       if (arg_name == "id") {
-        id = System::web_server.arg(i).toInt();
-        id_ok = true;
+        id = parseID(System::web_server.arg(i));
+        id_ok = id;
       } else
       if (arg_name == "action") {
         action = System::web_server.arg(i);
@@ -153,8 +300,10 @@ static void serveSave() {
           lmsg += F("\" from ");
           lmsg += System::web_server.client().remoteIP().toString();
           System::appLogWriteLn(lmsg);
-        } else
+        } else {
           pushHeader(F("Mailbox Not Found"), true);
+          System::web_page.setCode(HTTP_CODE_NOT_FOUND);
+        }
       } else
         if (action == "del") {
           pushHeader(mailbox_manager.deleteMailBox(id) ? F("Mailbox Forgotten") : F("Mailbox Not Found"), true);
@@ -166,28 +315,40 @@ static void serveSave() {
           System::appLogWriteLn(lmsg);
         } else
           pushHeader(F("Unknown action"), true);
-    } else
+    } else {
       pushHeader(F("Invalid Parameters"), true);
-  } else
+      System::web_page.setCode(HTTP_CODE_BAD_REQUEST);
+    }
+  } else {
     pushHeader(F("Invalid Parameters"), true);
+    System::web_page.setCode(HTTP_CODE_BAD_REQUEST);
+  }
   pushFooter();
   System::sendWebPage();
 }
 
 // Acknowledge global alarm
 static void serveAcknowledge() {
-  uint8_t id = 0;
+  uint8_t id = 0;                               // 0 means all mailboxes
+  auto id_ok = true;
   String via = F("web from ");
   via += System::web_server.client().remoteIP().toString();
 
   for (unsigned int i = 0; i < (unsigned int)System::web_server.args(); i++) {
     String arg_name = System::web_server.argName(i);
-    if (arg_name == "id")
-      id = System::web_server.arg(i).toInt();
+    if (arg_name == "id") {
+      id = parseID(System::web_server.arg(i));
+      id_ok = id;
+    }
   }
 
-  mailbox_manager.acknowledgeAlarm(via, id);
-  pushHeader(F("Alarm Acknowledged"), true);
+  if (id_ok) {
+    mailbox_manager.acknowledgeAlarm(via, id);
+    pushHeader(F("Alarm Acknowledged"), true);
+  } else {
+    pushHeader(F("Invalid Parameters"), true);
+    System::web_page.setCode(HTTP_CODE_BAD_REQUEST);
+  }
   pushFooter();
   System::sendWebPage();
 }
@@ -195,7 +356,7 @@ static void serveAcknowledge() {
 // Serve the global configuration page
 static void serveConf() {
   pushHeader(F("Global Configuration"));
-  String &page = System::web_page;
+  auto &page = System::web_page;
   page += F("<form action=\"/confSave\">\n");
 
   page += F(
@@ -387,10 +548,18 @@ static void serveConfSave() {
 static void registerPages() {
   System::web_server.on("/",        serveRoot);
   System::web_server.on("/mailbox", serveMailBox);
+  System::web_server.on("/history", serveHistory);
   System::web_server.on("/save",    serveSave);
   System::web_server.on("/conf",    serveConf);
   System::web_server.on("/confSave",serveConfSave);
   System::web_server.on("/ack",     serveAcknowledge);
+  System::web_server.on("/api/v1/mailboxes", serveAPIMailBoxes);
+  System::web_server.on(UriBraces("/api/v1/mailboxes/{}"), serveAPIMailBox);
+  System::web_server.on("/events",  serveEvents);
+
+  // Needed for conditional API requests
+  static const char *headers[] = {"If-None-Match"};
+  System::web_server.collectHeaders(headers, sizeof(headers) / sizeof(headers[0]));
 }
 
 // Hook up the registration to the system class